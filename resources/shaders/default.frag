@@ -7,6 +7,11 @@ in vec3 wsNormal;
 // NEW: object-space position for blocky effect
 in vec3 localPos;
 
+// Per-vertex color from instanced merged meshes / chunk meshes
+in vec3 vColor;
+in float vAO;   // baked ambient occlusion, 1 = open
+in vec2  vBakedLight;   // chunk meshes: (sun visibility, sky visibility)
+
 // Output
 out vec4 fragColor;
 
@@ -41,6 +46,11 @@ uniform Light lights[8];
 // NEW: 0 = normal shading, 1 = apply blocky “margin” effect
 uniform int useBlocky;
 
+// 1 = instanced merged mesh, diffuse comes from vColor
+uniform int useInstancing;
+uniform int useVertexColor;   // 1 = voxel chunk mesh, same but not instanced,
+                              //     lit from the baked sun/sky terms
+
 // === NEW: normal-mapped brick path uniforms ===
 uniform int   usePathMaterial;    // 1 = this fragment is a path brick
 uniform int   useNormalMap;       // 1 = actually use normal map
@@ -57,6 +67,31 @@ uniform float grassUVScale;        // tiling
 uniform float grassBumpScale;      // bump strength
 
 
+// === Sun shadows: cached static map + per-frame snake/food map ===
+uniform int             useShadows;
+uniform sampler2DShadow staticShadowMap;
+uniform sampler2DShadow dynamicShadowMap;
+uniform mat4            staticLightVP;
+uniform mat4            dynamicLightVP;
+
+
+// 3x3 PCF (each tap is a hardware 2x2 compare). 1 = lit.
+float shadowPCF(sampler2DShadow map, mat4 lightVP, vec3 P, vec3 Ngeom) {
+    // normal offset keeps flat faces from shadowing themselves
+    vec4 lp = lightVP * vec4(P + Ngeom * 0.04, 1.0);
+    vec3 c  = lp.xyz / lp.w * 0.5 + 0.5;
+    if (c.z > 1.0) return 1.0;
+
+    vec2 texel = 1.0 / vec2(textureSize(map, 0));
+    float sum = 0.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            sum += texture(map, vec3(c.xy + vec2(x, y) * texel, c.z - 0.001));
+        }
+    }
+    return sum / 9.0;
+}
+
 // 1 / (a + b d + c d^2), clamped to [0,1]
 float distanceFalloff(vec3 coeffs, float d) {
     float a = coeffs.x;
@@ -171,7 +206,7 @@ void main() {
     vec3 V = normalize(camPos - wsPosition);
 
     // Default material (non-path cubes, terrain, snake, etc.)
-    vec3 matDiffuse  = cDiffuse;
+    vec3 matDiffuse  = (useInstancing == 1 || useVertexColor == 1) ? vColor : cDiffuse;
     vec3 matSpecular = cSpecular;
 
     // ====== GRASS BUMP-MAPPED TERRAIN ======
@@ -229,16 +264,39 @@ void main() {
         }
     }
 
-    // Ambient term uses (possibly overridden) diffuse color
-    vec3 color = k_a * matDiffuse;
+    // Sun (lights[0]) shadowing. Chunk bakes only trace voxels, so chunks
+    // still need the static map for tree and prop shadows.
+    float sunShadow = 1.0;
+    if (useShadows == 1) {
+        vec3 Ngeom = normalize(wsNormal);
+        sunShadow = min(shadowPCF(dynamicShadowMap, dynamicLightVP, wsPosition, Ngeom),
+                        shadowPCF(staticShadowMap, staticLightVP, wsPosition, Ngeom));
+    }
 
-    // lights
-    int count = min(numLights, 8);
-    for (int i = 0; i < count; ++i) {
-        color += shadeOneLight(lights[i], N, wsPosition, V,
-                               matDiffuse, matSpecular);
+    vec3 color;
+    if (useVertexColor == 1) {
+        // Static blocks: sky-scaled ambient + diffuse sun (lights[0]) masked
+        // by the baked voxel shadow or the shadow maps, whichever is darker
+        // (voxels land in both); no per-light loop, no specular
+        float NdotL = max(dot(N, -normalize(lights[0].dir)), 0.0);
+        color = matDiffuse * (k_a * vBakedLight.y +
+                              k_d * NdotL * min(vBakedLight.x, sunShadow) * lights[0].color);
+    } else {
+        // Ambient term uses (possibly overridden) diffuse color
+        color = k_a * matDiffuse;
+
+        // lights
+        int count = min(numLights, 8);
+        for (int i = 0; i < count; ++i) {
+            vec3 c = shadeOneLight(lights[i], N, wsPosition, V,
+                                   matDiffuse, matSpecular);
+            color += (i == 0) ? c * sunShadow : c;
+        }
     }
 
+    // Darken corners / crevices (1.0 everywhere but chunk meshes)
+    color *= vAO;
+
     // Apply blocky face margins only when enabled
     if (useBlocky == 1) {
         color = applyBlockyMargin(color);
@@ -3,6 +3,20 @@
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 
+// Instanced merged meshes (L-system trees)
+layout(location = 2) in vec3 blockPos;      // position inside the source unit cube
+layout(location = 3) in vec3 vertexColor;
+layout(location = 4) in mat4 instanceModel; // per-instance (locations 4..7)
+layout(location = 8) in vec3 instanceTint;  // per-instance
+
+// Voxel chunk meshes (also use blockPos + vertexColor)
+layout(location = 9)  in float vertexAO;    // baked ambient occlusion
+layout(location = 10) in vec2 vertexLight;  // baked (sun visibility, sky visibility)
+
+uniform int useInstancing;  // 1 = use the per-instance attributes above,
+                            // 2 = instanceModel * model (scenefile template instances)
+uniform int useVertexColor; // 1 = chunk mesh: per-vertex color + AO, no instancing
+
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 proj;
@@ -14,16 +28,29 @@ out vec3 wsNormal;
 // NEW: local (object-space) position for blocky borders
 out vec3 localPos;
 
+// Per-vertex color (only meaningful when useInstancing or useVertexColor == 1)
+out vec3 vColor;
+out float vAO;
+out vec2  vBakedLight;
+
 void main() {
+    mat4 M = (useInstancing == 1) ? instanceModel
+           : (useInstancing == 2) ? instanceModel * model
+                                  : model;
+
     // World-space position
-    vec4 worldPosition = model * vec4(position, 1.0);
+    vec4 worldPosition = M * vec4(position, 1.0);
     wsPosition = worldPosition.xyz;
 
     // World-space normal
-    wsNormal = mat3(model) * normal;
+    wsNormal = mat3(M) * normal;
 
     // Pass along the object-space position (cube in [-0.5,0.5]^3)
-    localPos = position;
+    bool merged = (useInstancing == 1 || useVertexColor == 1);
+    localPos = merged ? blockPos : position;
+    vColor   = (useInstancing == 1) ? vertexColor * instanceTint : vertexColor;
+    vAO      = (useVertexColor == 1) ? vertexAO : 1.0;
+    vBakedLight = vertexLight;
 
     // Clip-space position
     gl_Position = proj * view * worldPosition;
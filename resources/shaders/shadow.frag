@@ -0,0 +1,5 @@
+#version 330 core
+
+// Depth is all we need
+void main() {
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+// Depth-only pass into the sun's shadow maps
+
+layout(location = 0) in vec3 position;
+layout(location = 4) in mat4 instanceModel; // per-instance (L-system trees)
+
+uniform int  useInstancing;
+uniform mat4 model;
+uniform mat4 lightViewProj;
+
+void main() {
+    mat4 M = (useInstancing == 1) ? instanceModel : model;
+    gl_Position = lightViewProj * M * vec4(position, 1.0);
+}
@@ -0,0 +1,287 @@
+#include "chunkmesher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace {
+
+constexpr int kSize   = VoxelChunk::kSize;
+constexpr int kHeight = VoxelChunk::kHeight;
+
+// Chunk plus a one-voxel ring (and a level above / below) copied out of the
+// world once, so culling and AO lookups are plain array reads.
+struct PaddedBlocks {
+    static constexpr int kW = kSize + 2;
+    static constexpr int kH = kHeight + 2;
+
+    BlockId ids[kW * kW * kH];
+    int x0, z0;   // world x/z of padded index 0
+
+    BlockId &at(int px, int py, int pz) { return ids[(py * kW + pz) * kW + px]; }
+
+    // world voxel -> block (air outside the copied region)
+    BlockId get(int x, int y, int z) const {
+        int px = x - x0, pz = z - z0, py = y - VoxelWorld::kMinY + 1;
+        if (px < 0 || px >= kW || pz < 0 || pz >= kW || py < 0 || py >= kH) return kAirBlock;
+        return ids[(py * kW + pz) * kW + px];
+    }
+};
+
+// Cosine-weighted directions around +Y (Fibonacci spiral)
+std::vector<glm::vec3> hemisphereDirections(int count) {
+    std::vector<glm::vec3> dirs;
+    const float golden = 2.39996323f;
+    for (int i = 0; i < count; ++i) {
+        float r   = std::sqrt((i + 0.5f) / count);
+        float phi = i * golden;
+        dirs.push_back(glm::vec3(r * std::cos(phi), std::sqrt(1.f - r * r), r * std::sin(phi)));
+    }
+    return dirs;
+}
+
+} // namespace
+
+bool ChunkMesher::occluded(const VoxelWorld &world, const glm::vec3 &origin,
+                           const glm::vec3 &dir, float maxDistance) {
+    // 2D DDA over the columns the ray crosses; in each column, test the
+    // ray's height range against the slabs there.
+    const float inf    = std::numeric_limits<float>::infinity();
+    const float worldLo = float(VoxelWorld::kMinY);
+    const float worldHi = float(VoxelWorld::kMinY + VoxelChunk::kHeight);
+
+    int ix = int(std::floor(origin.x + 0.5f));
+    int iz = int(std::floor(origin.z + 0.5f));
+
+    const int   stepX  = (dir.x > 0.f) ? 1 : -1;
+    const int   stepZ  = (dir.z > 0.f) ? 1 : -1;
+    const float deltaX = (dir.x != 0.f) ? std::abs(1.f / dir.x) : inf;
+    const float deltaZ = (dir.z != 0.f) ? std::abs(1.f / dir.z) : inf;
+    float tMaxX = (dir.x != 0.f) ? ((ix + 0.5f * stepX) - origin.x) / dir.x : inf;
+    float tMaxZ = (dir.z != 0.f) ? ((iz + 0.5f * stepZ) - origin.z) / dir.z : inf;
+
+    float tEnter = 0.f;
+    while (tEnter < maxDistance) {
+        float tExit = std::min({tMaxX, tMaxZ, maxDistance});
+
+        float y0 = origin.y + dir.y * tEnter;
+        float y1 = origin.y + dir.y * tExit;
+        float ylo = std::max(std::min(y0, y1), worldLo);
+        float yhi = std::min(std::max(y0, y1), worldHi);
+
+        for (int level = int(std::floor(ylo)); level <= int(std::floor(yhi)) && ylo <= yhi; ++level) {
+            BlockId id = world.getBlock(ix, level, iz);
+            if (id == kAirBlock) continue;
+
+            const BlockType &t = world.blockType(id);
+            float lo = level + t.bottom / 100.f;
+            float hi = level + t.top    / 100.f;
+            if (lo < yhi && hi > ylo) return true;
+        }
+
+        // left the block layers for good
+        if ((dir.y > 0.f && y1 >= worldHi) || (dir.y < 0.f && y1 <= worldLo)) return false;
+
+        tEnter = tExit;
+        if (tMaxX < tMaxZ) {
+            ix += stepX;
+            tMaxX += deltaX;
+        } else {
+            iz += stepZ;
+            tMaxZ += deltaZ;
+        }
+    }
+    return false;
+}
+
+void ChunkMesher::buildAll(const VoxelWorld &world, const std::vector<int64_t> &keys,
+                           const LightBakeSettings &light, std::vector<ChunkMesh> &out) {
+    out.resize(keys.size());
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < keys.size(); i = next++) {
+            build(world, keys[i], light, out[i]);
+        }
+    };
+
+    size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), keys.size());
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &t : pool) {
+        t.join();
+    }
+}
+
+void ChunkMesher::build(const VoxelWorld &world, int64_t chunkKey,
+                        const LightBakeSettings &light, ChunkMesh &out) {
+    out.vertices.clear();
+    out.defaultVertexCount = 0;
+    out.pathVertexCount    = 0;
+
+    const VoxelChunk *chunk = world.chunk(chunkKey);
+    if (!chunk || chunk->empty()) return;
+
+    const glm::ivec2 cc = VoxelWorld::chunkCoords(chunkKey);
+    const int baseX = cc.x * kSize;
+    const int baseZ = cc.y * kSize;
+
+    PaddedBlocks blocks;
+    blocks.x0 = baseX - 1;
+    blocks.z0 = baseZ - 1;
+    for (int py = 0; py < PaddedBlocks::kH; ++py) {
+        for (int pz = 0; pz < PaddedBlocks::kW; ++pz) {
+            for (int px = 0; px < PaddedBlocks::kW; ++px) {
+                int ly = py - 1;
+                bool inside = px >= 1 && px <= kSize && pz >= 1 && pz <= kSize &&
+                              ly >= 0 && ly < kHeight;
+                blocks.at(px, py, pz) = inside
+                    ? chunk->get(px - 1, ly, pz - 1)
+                    : world.getBlock(blocks.x0 + px, VoxelWorld::kMinY + ly, blocks.z0 + pz);
+            }
+        }
+    }
+
+    // is the point inside some block?
+    auto solidAt = [&](const glm::vec3 &p) {
+        int x = int(std::floor(p.x + 0.5f));
+        int z = int(std::floor(p.z + 0.5f));
+        int y = int(std::floor(p.y));
+        BlockId id = blocks.get(x, y, z);
+        if (id == kAirBlock) return false;
+
+        const BlockType &t = world.blockType(id);
+        float f = (p.y - y) * 100.f;
+        return f >= t.bottom && f < t.top;
+    };
+
+    std::vector<float> pathVerts;
+    const float eps = 0.005f;
+
+    const std::vector<glm::vec3> skyDirs = hemisphereDirections(light.skySamples);
+    const float sunMaxDistance = 4.f * ChunkMesher::kLightReach;   // exits the top first
+
+    auto emitFace = [&](const BlockType &t, const glm::vec3 &lo, const glm::vec3 &hi,
+                        int axis, int dir) {
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+
+        glm::vec3 n(0.f);
+        n[axis] = float(dir);
+
+        // corners CCW seen from outside
+        glm::vec3 corner[4];
+        const float uv[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+        for (int k = 0; k < 4; ++k) {
+            int src = (dir > 0) ? k : 3 - k;
+            glm::vec3 p;
+            p[axis] = (dir > 0) ? hi[axis] : lo[axis];
+            p[u]    = uv[src][0] ? hi[u] : lo[u];
+            p[v]    = uv[src][1] ? hi[v] : lo[v];
+            corner[k] = p;
+        }
+
+        const glm::vec3 center = 0.5f * (lo + hi);
+        const glm::vec3 size   = hi - lo;
+
+        float ao[4];
+        for (int k = 0; k < 4; ++k) {
+            glm::vec3 du(0.f), dv(0.f);
+            du[u] = (corner[k][u] > center[u]) ? 0.5f : -0.5f;
+            dv[v] = (corner[k][v] > center[v]) ? 0.5f : -0.5f;
+
+            glm::vec3 front = corner[k] + eps * n;
+            bool side1 = solidAt(front + du);
+            bool side2 = solidAt(front + dv);
+            bool cnr   = solidAt(front + du + dv);
+
+            int occluders = (side1 && side2) ? 3 : int(side1) + int(side2) + int(cnr);
+            ao[k] = kAOLevels[occluders];
+        }
+
+        // rays start just off the face, nudged toward its center so they
+        // don't slip along the edge of a touching block
+        float sun[4], sky[4];
+        glm::vec3 tangent(0.f), bitangent(0.f);
+        tangent[u]   = 1.f;
+        bitangent[v] = 1.f;
+        for (int k = 0; k < 4; ++k) {
+            glm::vec3 origin = corner[k] + 2.f * eps * n + 0.02f * (center - corner[k]);
+
+            sun[k] = (glm::dot(n, light.toSun) > 0.f &&
+                      !occluded(world, origin, light.toSun, sunMaxDistance)) ? 1.f : 0.f;
+
+            int open = 0;
+            for (const glm::vec3 &h : skyDirs) {
+                glm::vec3 d = h.x * tangent + h.y * n + h.z * bitangent;
+                if (d.y <= 0.f) continue;   // ground
+                if (!occluded(world, origin, d, light.skyMaxDistance)) open++;
+            }
+            sky[k] = skyDirs.empty() ? 1.f : float(open) / skyDirs.size();
+        }
+
+        // split along the brighter diagonal so the gradient doesn't crease
+        static const int kTris[2][6] = {{0, 1, 2, 0, 2, 3}, {1, 2, 3, 1, 3, 0}};
+        const int *tri = (ao[0] + ao[2] < ao[1] + ao[3]) ? kTris[1] : kTris[0];
+
+        std::vector<float> &dst = (t.material == MAT_PATH) ? pathVerts : out.vertices;
+        for (int i = 0; i < 6; ++i) {
+            const glm::vec3 &p = corner[tri[i]];
+            glm::vec3 local = (p - center) / size;
+            dst.insert(dst.end(), {
+                p.x, p.y, p.z,
+                n.x, n.y, n.z,
+                local.x, local.y, local.z,
+                t.color.r, t.color.g, t.color.b,
+                ao[tri[i]], sun[tri[i]], sky[tri[i]]
+            });
+        }
+    };
+
+    for (int ly = 0; ly < kHeight; ++ly) {
+        const int y = VoxelWorld::kMinY + ly;
+        for (int lz = 0; lz < kSize; ++lz) {
+            for (int lx = 0; lx < kSize; ++lx) {
+                BlockId id = blocks.at(lx + 1, ly + 1, lz + 1);
+                if (id == kAirBlock) continue;
+
+                const BlockType &t = world.blockType(id);
+                const int x = baseX + lx;
+                const int z = baseZ + lz;
+
+                glm::vec3 lo(x - 0.5f, y + t.bottom / 100.f, z - 0.5f);
+                glm::vec3 hi(x + 0.5f, y + t.top    / 100.f, z + 0.5f);
+
+                // sides: hidden when the neighbour covers the same height range
+                const int side[4][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 0, 1}, {0, 0, -1}};
+                for (const auto &d : side) {
+                    BlockId nb = blocks.get(x + d[0], y, z + d[2]);
+                    if (nb != kAirBlock) {
+                        const BlockType &o = world.blockType(nb);
+                        if (o.bottom <= t.bottom && o.top >= t.top) continue;
+                    }
+                    emitFace(t, lo, hi, d[0] != 0 ? 0 : 2, d[0] + d[2]);
+                }
+
+                // top / bottom: hidden only against a flush neighbour
+                BlockId above = blocks.get(x, y + 1, z);
+                if (!(t.top == 100 && above != kAirBlock && world.blockType(above).bottom == 0)) {
+                    emitFace(t, lo, hi, 1, 1);
+                }
+                BlockId below = blocks.get(x, y - 1, z);
+                if (!(t.bottom == 0 && below != kAirBlock && world.blockType(below).top == 100)) {
+                    emitFace(t, lo, hi, 1, -1);
+                }
+            }
+        }
+    }
+
+    out.defaultVertexCount = int(out.vertices.size() / ChunkMesh::kFloatsPerVertex);
+    out.pathVertexCount    = int(pathVerts.size() / ChunkMesh::kFloatsPerVertex);
+    out.vertices.insert(out.vertices.end(), pathVerts.begin(), pathVerts.end());
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "voxelworld.h"
+
+// Mesh of one voxel chunk, ready for upload.
+// Layout per vertex: [p.xyz, n.xyz, blockPos.xyz, color.rgb, ao, sun, sky]
+//   blockPos = position inside the block's own [-0.5, 0.5]^3 box (for the
+//              blocky margin), ao = baked ambient occlusion in [0, 1]
+//   sun      = baked sun visibility (0 = in shadow), sky = visible sky fraction
+// Vertices are grouped by material: the first defaultVertexCount use the
+// plain block shading, the next pathVertexCount the path brick material.
+struct ChunkMesh {
+    static constexpr int kFloatsPerVertex = 15;
+
+    std::vector<float> vertices;
+    int defaultVertexCount = 0;
+    int pathVertexCount    = 0;
+
+    int vertexCount() const { return defaultVertexCount + pathVertexCount; }
+};
+
+// Static lighting baked into the meshes
+struct LightBakeSettings {
+    glm::vec3 toSun          = glm::normalize(glm::vec3(1.f));
+    int       skySamples     = 12;    // hemisphere rays per vertex
+    float     skyMaxDistance = 8.f;   // farther blockers don't darken the sky
+};
+
+// Builds chunk meshes from a VoxelWorld. Faces covered by a neighbouring
+// block are skipped, and every vertex gets
+//   - Minecraft-style AO from the three blocks touching it in front of the
+//     face (two sides + corner)
+//   - sun visibility: one ray through the block grid toward the sun
+//   - sky visibility: cosine-weighted hemisphere rays (below the horizon
+//     counts as blocked)
+// so static blocks get shadows and cheap shading without per-frame cost.
+class ChunkMesher {
+public:
+    static void build(const VoxelWorld &world, int64_t chunkKey,
+                      const LightBakeSettings &light, ChunkMesh &out);
+
+    // Meshes several chunks in parallel (the world is only read).
+    static void buildAll(const VoxelWorld &world, const std::vector<int64_t> &keys,
+                         const LightBakeSettings &light, std::vector<ChunkMesh> &out);
+
+    // Does a ray from origin hit a block within maxDistance?
+    static bool occluded(const VoxelWorld &world, const glm::vec3 &origin,
+                         const glm::vec3 &dir, float maxDistance);
+
+    // Brightness for 0..3 occluders
+    static constexpr float kAOLevels[4] = {1.0f, 0.82f, 0.66f, 0.5f};
+
+    // How far (in voxels) an edit can change other meshes' baked light.
+    // Sun rays leave the block layers within this horizontal distance.
+    static constexpr int kLightReach = 10;
+};
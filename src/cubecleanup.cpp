@@ -0,0 +1,158 @@
+#include "cubecleanup.h"
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+constexpr float kQuantum       = 100.f; // 1/100 world units
+constexpr int   kCellSize      = 100;   // spatial hash cell = 1 world unit
+constexpr int   kMaxCellsPerBox = 64;   // bigger boxes go on a shared list
+
+// Box as quantized integer bounds
+struct QBox {
+    int lo[3];
+    int hi[3];
+
+    bool operator==(const QBox &o) const {
+        for (int a = 0; a < 3; ++a) {
+            if (lo[a] != o.lo[a] || hi[a] != o.hi[a]) return false;
+        }
+        return true;
+    }
+
+    bool contains(const QBox &o) const {
+        for (int a = 0; a < 3; ++a) {
+            if (o.lo[a] < lo[a] || o.hi[a] > hi[a]) return false;
+        }
+        return true;
+    }
+};
+
+struct QBoxHash {
+    size_t operator()(const QBox &b) const {
+        uint64_t h = 1469598103934665603ull;
+        for (int a = 0; a < 3; ++a) {
+            h = (h ^ uint32_t(b.lo[a])) * 1099511628211ull;
+            h = (h ^ uint32_t(b.hi[a])) * 1099511628211ull;
+        }
+        return size_t(h);
+    }
+};
+
+QBox quantize(const CubeInstance &c) {
+    QBox q;
+    for (int a = 0; a < 3; ++a) {
+        float half = 0.5f * std::abs(c.scale[a]);
+        q.lo[a] = int(std::lround((c.pos[a] - half) * kQuantum));
+        q.hi[a] = int(std::lround((c.pos[a] + half) * kQuantum));
+    }
+    return q;
+}
+
+inline int cellOf(int q) {
+    // floor division for negative coordinates too
+    return (q >= 0) ? q / kCellSize : -((-q + kCellSize - 1) / kCellSize);
+}
+
+inline uint64_t cellKey(int x, int y, int z) {
+    return (uint64_t(uint32_t(x) & 0x1fffff) << 42) |
+           (uint64_t(uint32_t(y) & 0x1fffff) << 21) |
+            uint64_t(uint32_t(z) & 0x1fffff);
+}
+
+} // namespace
+
+CubeCleanupStats removeRedundantCubes(std::vector<CubeInstance> &cubes) {
+    CubeCleanupStats stats;
+    stats.before = cubes.size();
+
+    const size_t n = cubes.size();
+    std::vector<QBox> boxes(n);
+    std::vector<char> keep(n, 1);
+
+    // ---------- 1) exact duplicates: first one wins ----------
+    std::unordered_set<QBox, QBoxHash> seen;
+    seen.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        boxes[i] = quantize(cubes[i]);
+        if (!seen.insert(boxes[i]).second) {
+            keep[i] = 0;
+            stats.duplicates++;
+        }
+    }
+
+    // ---------- 2) spatial hash of the survivors ----------
+    std::unordered_map<uint64_t, std::vector<uint32_t>> grid;
+    std::vector<uint32_t> large;
+    grid.reserve(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        if (!keep[i]) continue;
+        const QBox &b = boxes[i];
+
+        int c0[3], c1[3];
+        long cells = 1;
+        for (int a = 0; a < 3; ++a) {
+            c0[a] = cellOf(b.lo[a]);
+            c1[a] = cellOf(b.hi[a]);
+            cells *= (c1[a] - c0[a] + 1);
+        }
+        if (cells > kMaxCellsPerBox) {
+            large.push_back(uint32_t(i));
+            continue;
+        }
+        for (int x = c0[0]; x <= c1[0]; ++x)
+            for (int y = c0[1]; y <= c1[1]; ++y)
+                for (int z = c0[2]; z <= c1[2]; ++z)
+                    grid[cellKey(x, y, z)].push_back(uint32_t(i));
+    }
+
+    // ---------- 3) drop cubes enclosed by another cube ----------
+    // A container holds the enclosed cube's center, so it is registered in
+    // that cell (or on the large list).
+    auto enclosedBy = [&](size_t i, uint32_t j) {
+        return j != i && boxes[j].contains(boxes[i]);
+    };
+
+    for (size_t i = 0; i < n; ++i) {
+        if (!keep[i]) continue;
+        const QBox &b = boxes[i];
+
+        int cx = cellOf((b.lo[0] + b.hi[0]) / 2);
+        int cy = cellOf((b.lo[1] + b.hi[1]) / 2);
+        int cz = cellOf((b.lo[2] + b.hi[2]) / 2);
+
+        bool enclosed = false;
+        auto it = grid.find(cellKey(cx, cy, cz));
+        if (it != grid.end()) {
+            for (uint32_t j : it->second) {
+                if (enclosedBy(i, j)) { enclosed = true; break; }
+            }
+        }
+        if (!enclosed) {
+            for (uint32_t j : large) {
+                if (enclosedBy(i, j)) { enclosed = true; break; }
+            }
+        }
+
+        if (enclosed) {
+            keep[i] = 0;
+            stats.enclosed++;
+        }
+    }
+
+    // ---------- 4) compact, keeping order ----------
+    size_t out = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (keep[i]) {
+            if (out != i) cubes[out] = cubes[i];
+            ++out;
+        }
+    }
+    cubes.resize(out);
+
+    return stats;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "cubeinstance.h"
+
+// What a cleanup pass removed
+struct CubeCleanupStats {
+    size_t before     = 0;
+    size_t duplicates = 0;   // same quantized position + scale as an earlier cube
+    size_t enclosed   = 0;   // box lies entirely inside another cube
+
+    size_t removed() const { return duplicates + enclosed; }
+};
+
+// Pass over an axis-aligned cube list, run on the world cubes before anything
+// is uploaded or collision-tested and on Bush tree template blocks before their
+// mesh is baked (parametric templates are oriented segments; treetemplates.cpp
+// only drops their exact repeats).
+// Positions/scales are quantized to 1/100 units; the first of a set of
+// duplicates wins, and a cube fully inside another one is dropped (it can
+// neither be seen nor change cellBlocked, since its container is at least as
+// tall and covers its footprint). Survivors keep their relative order.
+CubeCleanupStats removeRedundantCubes(std::vector<CubeInstance> &cubes);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Material ids understood by the blocky cube shader path
+enum MaterialType {
+    MAT_DEFAULT = 0,
+    MAT_PATH    = 1,
+    MAT_WALL    = 2
+};
+
+// One axis-aligned box in the blocky world (walls, hills, path, tree blocks)
+struct CubeInstance {
+    glm::vec3 pos;    // center
+    glm::vec3 scale;
+    glm::vec3 color;
+    int material = MAT_DEFAULT;
+};
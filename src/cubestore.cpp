@@ -0,0 +1,233 @@
+#include "cubestore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include <glm/gtc/packing.hpp>
+
+int16_t CubeStore::quantizeCoord(float v) {
+    long q = std::lround(v * kQuantum);
+    return static_cast<int16_t>(std::clamp(q, -32768L, 32767L));
+}
+
+uint16_t CubeStore::toHalf(float v) {
+    return static_cast<uint16_t>(glm::packHalf1x16(v));
+}
+
+float CubeStore::fromHalf(uint16_t h) {
+    return glm::unpackHalf1x16(h);
+}
+
+uint16_t CubeStore::styleIndex(const glm::vec3 &color, int material) {
+    auto channel = [](float c) {
+        return static_cast<uint32_t>(std::lround(std::clamp(c, 0.f, 1.f) * 255.f));
+    };
+    uint32_t key = channel(color.r) | (channel(color.g) << 8) | (channel(color.b) << 16) |
+                   (static_cast<uint32_t>(material & 0xff) << 24);
+
+    auto it = m_paletteLookup.find(key);
+    if (it != m_paletteLookup.end()) {
+        return it->second;
+    }
+
+    if (m_palette.size() > UINT16_MAX) {
+        std::cerr << "[CubeStore] palette full, reusing style 0" << std::endl;
+        return 0;
+    }
+
+    uint16_t index = static_cast<uint16_t>(m_palette.size());
+    m_palette.push_back({glm::vec3(channel(color.r), channel(color.g), channel(color.b)) / 255.f,
+                         material});
+    m_paletteLookup.emplace(key, index);
+    return index;
+}
+
+bool CubeStore::representable(const CubeInstance &cube) {
+    const float maxCoord = 32767.f / kQuantum;
+    const float maxSize  = 65535.f / kQuantum;
+    const float maxHalf  = 65504.f;
+    return std::abs(cube.pos.x) <= maxCoord && std::abs(cube.pos.z) <= maxCoord &&
+           std::abs(cube.scale.x) <= maxSize &&
+           std::abs(std::abs(cube.scale.x) - std::abs(cube.scale.z)) < 0.5f / kQuantum &&
+           std::abs(cube.pos.y) <= maxHalf && std::abs(cube.scale.y) <= maxHalf;
+}
+
+CubeHandle CubeStore::insert(const CubeInstance &cube) {
+    if (!representable(cube)) {
+        std::cerr << "[CubeStore] cube at (" << cube.pos.x << ", " << cube.pos.y << ", " << cube.pos.z
+                  << ") scale (" << cube.scale.x << ", " << cube.scale.y << ", " << cube.scale.z
+                  << ") doesn't fit the quantized layout, not inserted" << std::endl;
+        return {};
+    }
+
+    uint32_t slot;
+    if (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(m_slots.size());
+        m_slots.push_back({0, m_firstGeneration, false});
+    }
+
+    Slot &s = m_slots[slot];
+    s.dense = static_cast<uint32_t>(m_x.size());
+    s.live  = true;
+
+    m_x.push_back(quantizeCoord(cube.pos.x));
+    m_z.push_back(quantizeCoord(cube.pos.z));
+    m_y.push_back(toHalf(cube.pos.y));
+    m_h.push_back(toHalf(cube.scale.y));
+    m_size.push_back(static_cast<uint16_t>(std::clamp(std::lround(std::abs(cube.scale.x) * kQuantum),
+                                                      0L, 65535L)));
+    m_style.push_back(styleIndex(cube.color, cube.material));
+    m_denseToSlot.push_back(slot);
+
+    return {slot, s.generation};
+}
+
+bool CubeStore::contains(CubeHandle h) const {
+    return h.slot < m_slots.size() &&
+           m_slots[h.slot].live &&
+           m_slots[h.slot].generation == h.generation;
+}
+
+CubeHandle CubeStore::handleAt(size_t i) const {
+    uint32_t slot = m_denseToSlot[i];
+    return {slot, m_slots[slot].generation};
+}
+
+CubeInstance CubeStore::at(size_t i) const {
+    float size = m_size[i] / kQuantum;
+    const Style &st = m_palette[m_style[i]];
+
+    CubeInstance c;
+    c.pos      = glm::vec3(m_x[i] / kQuantum, fromHalf(m_y[i]), m_z[i] / kQuantum);
+    c.scale    = glm::vec3(size, fromHalf(m_h[i]), size);
+    c.color    = st.color;
+    c.material = st.material;
+    return c;
+}
+
+std::vector<CubeInstance> CubeStore::toInstances() const {
+    std::vector<CubeInstance> out;
+    out.reserve(size());
+    for (size_t i = 0; i < size(); ++i) {
+        out.push_back(at(i));
+    }
+    return out;
+}
+
+void CubeStore::moveDense(uint32_t from, uint32_t to) {
+    m_x[to]           = m_x[from];
+    m_z[to]           = m_z[from];
+    m_y[to]           = m_y[from];
+    m_h[to]           = m_h[from];
+    m_size[to]        = m_size[from];
+    m_style[to]       = m_style[from];
+    m_denseToSlot[to] = m_denseToSlot[from];
+    m_slots[m_denseToSlot[to]].dense = to;
+}
+
+bool CubeStore::remove(CubeHandle h) {
+    if (!contains(h)) return false;
+
+    Slot &s = m_slots[h.slot];
+    uint32_t hole = s.dense;
+    uint32_t last = static_cast<uint32_t>(m_x.size() - 1);
+
+    // move the last cube into the hole
+    if (hole != last) {
+        moveDense(last, hole);
+    }
+    m_x.pop_back();
+    m_z.pop_back();
+    m_y.pop_back();
+    m_h.pop_back();
+    m_size.pop_back();
+    m_style.pop_back();
+    m_denseToSlot.pop_back();
+
+    s.live = false;
+    s.generation++;
+    m_freeSlots.push_back(h.slot);
+
+    // lots of churn: tidy up so slot/dense arrays don't keep growing
+    if (++m_removedSinceCompact > 64 && m_removedSinceCompact > size() / 4) {
+        compact();
+    }
+    return true;
+}
+
+void CubeStore::clear() {
+    for (Slot &s : m_slots) {
+        if (s.live) {
+            s.live = false;
+            s.generation++;
+        }
+    }
+    m_x.clear();
+    m_z.clear();
+    m_y.clear();
+    m_h.clear();
+    m_size.clear();
+    m_style.clear();
+    m_denseToSlot.clear();
+
+    m_palette.clear();
+    m_paletteLookup.clear();
+
+    // every slot is free again; keep generations so old handles stay stale
+    m_freeSlots.resize(m_slots.size());
+    std::iota(m_freeSlots.rbegin(), m_freeSlots.rend(), 0u);
+    m_removedSinceCompact = 0;
+}
+
+template <typename T>
+static void permute(std::vector<T> &v, const std::vector<uint32_t> &order) {
+    std::vector<T> out;
+    out.reserve(order.size());
+    for (uint32_t src : order) {
+        out.push_back(v[src]);
+    }
+    v.swap(out);
+}
+
+void CubeStore::compact() {
+    m_removedSinceCompact = 0;
+
+    // ---------- 1) spatially sort the dense arrays ----------
+    std::vector<uint32_t> order(size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        if (m_z[a] != m_z[b]) return m_z[a] < m_z[b];
+        return m_x[a] < m_x[b];
+    });
+
+    permute(m_x, order);
+    permute(m_z, order);
+    permute(m_y, order);
+    permute(m_h, order);
+    permute(m_size, order);
+    permute(m_style, order);
+    permute(m_denseToSlot, order);
+    for (uint32_t i = 0; i < m_denseToSlot.size(); ++i) {
+        m_slots[m_denseToSlot[i]].dense = i;
+    }
+
+    // ---------- 2) trim free slots at the end of the slot table ----------
+    // Live slots can't move without breaking handles. A trimmed slot index may
+    // be handed out again later, so new slots start above every generation
+    // that was trimmed and old handles to it stay stale.
+    while (!m_slots.empty() && !m_slots.back().live && m_slots.size() > size() * 2) {
+        m_firstGeneration = std::max(m_firstGeneration, m_slots.back().generation);
+        m_slots.pop_back();
+    }
+    m_freeSlots.clear();
+    for (uint32_t i = static_cast<uint32_t>(m_slots.size()); i-- > 0;) {
+        if (!m_slots[i].live) m_freeSlots.push_back(i);
+    }
+
+    m_slots.shrink_to_fit();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "cubeinstance.h"
+
+// Stable reference to a cube in a CubeStore. Goes stale (and is then ignored)
+// once that cube is removed, even if its slot gets reused.
+struct CubeHandle {
+    uint32_t slot       = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool isNull() const { return slot == UINT32_MAX; }
+};
+
+// Generational slot map of world cubes.
+//   - live cubes are always packed in dense arrays (no tombstones), so
+//     drawing / collision loops never branch over deleted entries
+//   - insert and remove are O(1) (remove swaps the last cube into the hole)
+//   - handles stay valid until their cube is removed or the store is cleared
+//
+// The dense part is a structure of arrays, 12 bytes per cube:
+//   x, z    int16   centi-units (1/100), so +-327 world units
+//   y, h    half    center height and vertical size
+//   size    uint16  footprint edge in centi-units (footprints are square,
+//                   scale.z is taken to equal scale.x)
+//   style   uint16  palette index of (RGB8 color, material)
+// Loops that need only a few fields (cellBlocked) read only those arrays.
+//
+// So a cube must have |x|, |z| <= 327.67, a square footprint (|scale.x| ==
+// |scale.z| to 1/100) no wider than 655.35, and y / height within half
+// range. insert() rejects anything else with a null handle.
+class CubeStore {
+public:
+    static constexpr float kQuantum = 100.f;
+
+    struct Style {
+        glm::vec3 color;
+        int       material;
+    };
+
+    // Null handle (and a message) if the cube isn't representable().
+    CubeHandle insert(const CubeInstance &cube);
+    static bool representable(const CubeInstance &cube);
+
+    // Returns false if the handle is stale.
+    bool remove(CubeHandle h);
+
+    bool contains(CubeHandle h) const;
+
+    // Handle of the cube currently at dense position i
+    CubeHandle handleAt(size_t i) const;
+
+    // Decoded cube at dense position i
+    CubeInstance at(size_t i) const;
+
+    // All cubes decoded, in dense order
+    std::vector<CubeInstance> toInstances() const;
+
+    // Invalidates every outstanding handle.
+    void clear();
+
+    // Re-sorts the dense arrays along z then x (collision scans touch nearby
+    // cubes together), trims unused trailing slots and returns spare memory.
+    // Handles survive. Also triggered automatically after many removals.
+    void compact();
+
+    size_t size()  const { return m_x.size(); }
+    bool   empty() const { return m_x.empty(); }
+
+    // Raw dense arrays
+    const int16_t  *xs()     const { return m_x.data(); }
+    const int16_t  *zs()     const { return m_z.data(); }
+    const uint16_t *ys()     const { return m_y.data(); }
+    const uint16_t *heights() const { return m_h.data(); }
+    const uint16_t *sizes()  const { return m_size.data(); }
+    const uint16_t *styles() const { return m_style.data(); }
+
+    const Style &style(uint16_t index) const { return m_palette[index]; }
+
+    static int16_t  quantizeCoord(float v);
+    static uint16_t toHalf(float v);
+    static float    fromHalf(uint16_t h);
+
+private:
+    struct Slot {
+        uint32_t dense;       // index into the dense arrays while live
+        uint32_t generation;  // bumped on every removal
+        bool     live;
+    };
+
+    uint16_t styleIndex(const glm::vec3 &color, int material);
+    void     moveDense(uint32_t from, uint32_t to);
+
+    // dense SoA
+    std::vector<int16_t>  m_x;
+    std::vector<int16_t>  m_z;
+    std::vector<uint16_t> m_y;
+    std::vector<uint16_t> m_h;
+    std::vector<uint16_t> m_size;
+    std::vector<uint16_t> m_style;
+    std::vector<uint32_t> m_denseToSlot;
+
+    std::vector<Slot>     m_slots;
+    std::vector<uint32_t> m_freeSlots;
+
+    std::vector<Style>                     m_palette;
+    std::unordered_map<uint32_t, uint16_t> m_paletteLookup;
+
+    uint32_t m_firstGeneration     = 0;  // generation given to newly created slots
+    size_t   m_removedSinceCompact = 0;
+};
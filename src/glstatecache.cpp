@@ -0,0 +1,143 @@
+#include "glstatecache.h"
+
+#include <cstring>
+
+int GLStateCache::Stats::totalIssued() const {
+    int n = 0;
+    for (int v : issued) n += v;
+    return n;
+}
+
+int GLStateCache::Stats::totalElided() const {
+    int n = 0;
+    for (int v : elided) n += v;
+    return n;
+}
+
+const char *GLStateCache::categoryName(Category c) {
+    switch (c) {
+    case kProgram:     return "program";
+    case kVertexArray: return "vao";
+    case kTexture:     return "texture";
+    case kBuffer:      return "buffer";
+    case kUniform:     return "uniform";
+    default:           return "?";
+    }
+}
+
+void GLStateCache::count(Category c, bool issued) {
+    if (issued) m_frame.issued[c]++;
+    else        m_frame.elided[c]++;
+}
+
+void GLStateCache::beginFrame() {
+    m_lastFrame = m_frame;
+    m_frame     = Stats();
+}
+
+void GLStateCache::invalidateBindings() {
+    m_program       = kUnknown;
+    m_vao           = kUnknown;
+    m_arrayBuffer   = kUnknown;
+    m_elementBuffer = kUnknown;
+    m_activeUnit    = -1;
+    m_textures.fill(kUnknown);
+}
+
+void GLStateCache::forgetProgram(GLuint program) {
+    m_locations.erase(program);
+    for (auto it = m_uniforms.begin(); it != m_uniforms.end();) {
+        if (GLuint(it->first >> 32) == program) it = m_uniforms.erase(it);
+        else ++it;
+    }
+    if (m_program == program) m_program = kUnknown;
+}
+
+void GLStateCache::useProgram(GLuint program) {
+    bool issue = (program != m_program);
+    count(kProgram, issue);
+    if (!issue) return;
+
+    glUseProgram(program);
+    m_program = program;
+}
+
+void GLStateCache::bindVertexArray(GLuint vao) {
+    bool issue = (vao != m_vao);
+    count(kVertexArray, issue);
+    if (!issue) return;
+
+    glBindVertexArray(vao);
+    m_vao           = vao;
+    m_elementBuffer = kUnknown;
+}
+
+void GLStateCache::bindTexture(int unit, GLenum target, GLuint texture) {
+    bool tracked = unit >= 0 && unit < kMaxTextureUnits;
+    bool issue   = !tracked || m_textures[unit] != texture;
+    count(kTexture, issue);
+    if (!issue) return;
+
+    if (m_activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeUnit = unit;
+    }
+    glBindTexture(target, texture);
+    if (tracked) m_textures[unit] = texture;
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer) {
+    GLuint *slot = (target == GL_ARRAY_BUFFER)         ? &m_arrayBuffer
+                 : (target == GL_ELEMENT_ARRAY_BUFFER) ? &m_elementBuffer
+                                                       : nullptr;
+    bool issue = !slot || *slot != buffer;
+    count(kBuffer, issue);
+    if (!issue) return;
+
+    glBindBuffer(target, buffer);
+    if (slot) *slot = buffer;
+}
+
+GLint GLStateCache::uniformLocation(const char *name) {
+    auto &locs = m_locations[m_program];
+    auto it = locs.find(name);
+    if (it != locs.end()) return it->second;
+
+    GLint loc = glGetUniformLocation(m_program, name);
+    locs.emplace(name, loc);
+    return loc;
+}
+
+bool GLStateCache::uniformChanged(GLint loc, const void *data, int words) {
+    if (loc < 0) return false;   // not in this program
+
+    UniformValue &v = m_uniforms[(uint64_t(m_program) << 32) | uint32_t(loc)];
+    if (v.words == words && std::memcmp(v.bits.data(), data, words * sizeof(uint32_t)) == 0) {
+        count(kUniform, false);
+        return false;
+    }
+    std::memcpy(v.bits.data(), data, words * sizeof(uint32_t));
+    v.words = words;
+    count(kUniform, true);
+    return true;
+}
+
+void GLStateCache::uniform(const char *name, int v) {
+    GLint loc = uniformLocation(name);
+    if (uniformChanged(loc, &v, 1)) glUniform1i(loc, v);
+}
+
+void GLStateCache::uniform(const char *name, float v) {
+    GLint loc = uniformLocation(name);
+    if (uniformChanged(loc, &v, 1)) glUniform1f(loc, v);
+}
+
+void GLStateCache::uniform(const char *name, const glm::vec3 &v) {
+    GLint loc = uniformLocation(name);
+    if (uniformChanged(loc, &v[0], 3)) glUniform3fv(loc, 1, &v[0]);
+}
+
+void GLStateCache::uniform(const char *name, const glm::mat4 &m) {
+    GLint loc = uniformLocation(name);
+    if (uniformChanged(loc, &m[0][0], 16)) glUniformMatrix4fv(loc, 1, GL_FALSE, &m[0][0]);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Thin shadow of the GL state the renderer touches every frame. Binds and
+// uniform uploads that wouldn't change anything are skipped, and every call
+// is counted as issued or elided so the savings can be checked per frame.
+//
+// Bindings are forgotten by invalidateBindings() (Qt and raw GL code in
+// between may have changed them). Uniform values are program state, so
+// their shadows live until forgetProgram(); a program driven through the
+// cache must get all of its uniforms through it.
+class GLStateCache {
+public:
+    enum Category { kProgram, kVertexArray, kTexture, kBuffer, kUniform, kCategoryCount };
+
+    struct Stats {
+        std::array<int, kCategoryCount> issued{};
+        std::array<int, kCategoryCount> elided{};
+
+        int totalIssued() const;
+        int totalElided() const;
+    };
+
+    static constexpr int kMaxTextureUnits = 16;
+
+    // Starts a new counting frame; lastFrame() then holds the previous one.
+    void beginFrame();
+    const Stats &lastFrame() const { return m_lastFrame; }
+    const Stats &thisFrame() const { return m_frame; }
+
+    void invalidateBindings();
+    void forgetProgram(GLuint program);
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindTexture(int unit, GLenum target, GLuint texture);
+    void bindBuffer(GLenum target, GLuint buffer);   // GL_ARRAY_BUFFER / GL_ELEMENT_ARRAY_BUFFER
+
+    // Uniforms of the current program; locations are looked up once per name.
+    GLint uniformLocation(const char *name);
+    void  uniform(const char *name, int v);
+    void  uniform(const char *name, float v);
+    void  uniform(const char *name, const glm::vec3 &v);
+    void  uniform(const char *name, const glm::mat4 &m);
+
+    static const char *categoryName(Category c);
+
+private:
+    struct UniformValue {
+        std::array<uint32_t, 16> bits{};
+        int                      words = 0;
+    };
+
+    // true when the value differs from the shadow (and records it)
+    bool uniformChanged(GLint loc, const void *data, int words);
+    void count(Category c, bool issued);
+
+    // GL never hands out name ~0u, so it stands for "whatever is bound"
+    static constexpr GLuint kUnknown = ~GLuint(0);
+
+    GLuint m_program       = kUnknown;
+    GLuint m_vao           = kUnknown;
+    GLuint m_arrayBuffer   = kUnknown;
+    GLuint m_elementBuffer = kUnknown;   // part of the VAO, unknown after a VAO change
+    int    m_activeUnit    = -1;
+    std::array<GLuint, kMaxTextureUnits> m_textures = filledUnknown();
+
+    static std::array<GLuint, kMaxTextureUnits> filledUnknown() {
+        std::array<GLuint, kMaxTextureUnits> a;
+        a.fill(kUnknown);
+        return a;
+    }
+
+    std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> m_locations;
+    std::unordered_map<uint64_t, UniformValue>                         m_uniforms;   // (program, location)
+
+    Stats m_frame;
+    Stats m_lastFrame;
+};
@@ -0,0 +1,65 @@
+#include "lsystem.h"
+
+#include <algorithm>
+#include <limits>
+
+static inline uint64_t saturatingAdd(uint64_t a, uint64_t b) {
+    uint64_t maxV = std::numeric_limits<uint64_t>::max();
+    return (a > maxV - b) ? maxV : a + b;
+}
+
+void LSystem::setRule(char symbol, const std::string &successor) {
+    unsigned char s = static_cast<unsigned char>(symbol);
+    m_rules[s]   = successor;
+    m_hasRule[s] = true;
+}
+
+void LSystem::clearRules() {
+    for (std::string &r : m_rules) r.clear();
+    m_hasRule.fill(false);
+}
+
+std::vector<std::array<uint64_t, 256>> LSystem::lengthTable(int iterations) const {
+    int n = std::max(0, iterations);
+    std::vector<std::array<uint64_t, 256>> len(n + 1);
+
+    // 0 rewrites: every symbol is itself
+    len[0].fill(1);
+
+    // k rewrites: a symbol with a rule is the sum of its successor's symbols
+    // after k-1 rewrites; symbols without a rule stay length 1
+    for (int k = 1; k <= n; ++k) {
+        for (int c = 0; c < 256; ++c) {
+            if (!m_hasRule[c]) {
+                len[k][c] = 1;
+                continue;
+            }
+            uint64_t total = 0;
+            for (char s : m_rules[c]) {
+                total = saturatingAdd(total, len[k - 1][static_cast<unsigned char>(s)]);
+            }
+            len[k][c] = total;
+        }
+    }
+    return len;
+}
+
+uint64_t LSystem::expandedLength(const std::string &axiom, int iterations) const {
+    int n = std::max(0, iterations);
+    std::vector<std::array<uint64_t, 256>> len = lengthTable(n);
+
+    uint64_t total = 0;
+    for (char c : axiom) {
+        total = saturatingAdd(total, len[n][static_cast<unsigned char>(c)]);
+    }
+    return total;
+}
+
+std::string LSystem::expand(const std::string &axiom, int iterations) const {
+    uint64_t n = expandedLength(axiom, iterations);
+
+    std::string out;
+    out.reserve(static_cast<size_t>(n));
+    generate(axiom, iterations, [&](char c) { out.push_back(c); });
+    return out;
+}
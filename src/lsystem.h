@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Deterministic, context-free L-system over single-character symbols.
+//
+// Instead of rebuilding the whole string every iteration, the expansion is
+// driven from the axiom down: expandedLength() predicts the exact size with a
+// small DP table (length of every symbol after k rewrites), expand() allocates
+// the result once, and generate() streams the symbols to a callback without
+// ever materializing the string (memory = recursion depth = iterations).
+class LSystem {
+public:
+    // Symbol -> successor. Symbols without a rule are copied as-is.
+    void setRule(char symbol, const std::string &successor);
+    void clearRules();
+
+    // Exact length of the axiom after `iterations` rewrites.
+    // Saturates at UINT64_MAX instead of overflowing.
+    uint64_t expandedLength(const std::string &axiom, int iterations) const;
+
+    // Fully expanded string, sized up front (single allocation).
+    std::string expand(const std::string &axiom, int iterations) const;
+
+    // Calls fn(char) for every symbol of the expanded string, in order.
+    template <typename Fn>
+    void generate(const std::string &axiom, int iterations, Fn &&fn) const {
+        for (char c : axiom) {
+            emit(c, iterations, fn);
+        }
+    }
+
+private:
+    template <typename Fn>
+    void emit(char c, int depth, Fn &fn) const {
+        const std::string &succ = m_rules[static_cast<unsigned char>(c)];
+        if (depth <= 0 || !m_hasRule[static_cast<unsigned char>(c)]) {
+            fn(c);
+            return;
+        }
+        for (char s : succ) {
+            emit(s, depth - 1, fn);
+        }
+    }
+
+    // Per-symbol lengths after 0..iterations rewrites; row k has 256 entries.
+    std::vector<std::array<uint64_t, 256>> lengthTable(int iterations) const;
+
+    std::array<std::string, 256> m_rules;
+    std::array<bool, 256>        m_hasRule{};
+};
@@ -0,0 +1,66 @@
+#include "mappedfile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string &path) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *p = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            m_data   = static_cast<const char*>(p);
+            m_size   = size_t(st.st_size);
+            m_mapped = true;
+            ::madvise(p, m_size, MADV_SEQUENTIAL);
+        }
+    }
+    ::close(fd);
+    if (m_mapped) return true;
+#endif
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    m_copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    m_data = m_copy.data();
+    m_size = m_copy.size();
+    return true;
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+    constexpr uint64_t kMul = 0x9e3779b97f4a7c15ull;
+    const char *bytes = static_cast<const char*>(data);
+    uint64_t h = seed ^ (size * kMul);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, bytes + i, 8);
+        h = (h ^ (w * kMul)) * kMul;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    if (size > i) std::memcpy(&tail, bytes + i, size - i);
+    h = (h ^ (tail * kMul)) * kMul;
+    h ^= h >> 32;
+    return h;
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+    if (m_mapped) ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_data   = nullptr;
+    m_size   = 0;
+    m_mapped = false;
+    m_copy.clear();
+}
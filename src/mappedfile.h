@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only view of a whole file: mmap where available, otherwise one read
+// into memory. The view stays valid for the object's lifetime.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    bool        valid() const { return m_data != nullptr; }
+    const char *data()  const { return m_data; }
+    size_t      size()  const { return m_size; }
+
+private:
+    const char *m_data   = nullptr;
+    size_t      m_size   = 0;
+    bool        m_mapped = false;
+    std::string m_copy;
+};
+
+// 64-bit multiply-xorshift over 8-byte words; fast enough to key whole
+// files at close to memory bandwidth. Not for anything adversarial.
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
@@ -0,0 +1,266 @@
+#include "meshcache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr char kMagic[4] = {'M', 'E', 'S', 'H'};
+
+struct FileHeader {
+    char     magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t lodCount;
+    uint32_t attribCount;
+    int32_t  stride;
+    float    boundsMin[3];
+    float    boundsMax[3];
+    uint32_t pad;
+    uint64_t formatOffset;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t lodOffset;
+    uint64_t fileSize;
+};
+
+struct FileAttrib {
+    uint32_t location;
+    int32_t  components;
+    uint32_t type;
+    uint32_t normalized;
+    int32_t  offset;
+};
+
+static_assert(sizeof(MeshLod) == 12, "MeshLod is stored as-is");
+
+uint64_t align16(uint64_t v) {
+    return (v + 15) & ~uint64_t(15);
+}
+
+uint64_t mix(uint64_t h, uint64_t v) {
+    return hashBytes(&v, sizeof(v), h);
+}
+
+std::vector<FileAttrib> describe(const VertexFormat &format) {
+    std::vector<FileAttrib> out;
+    for (const VertexAttrib &a : format.attribs) {
+        out.push_back({a.location, a.components, a.type, a.normalized, a.offset});
+    }
+    return out;
+}
+
+} // namespace
+
+void MeshCache::setDirectory(const std::string &dir) {
+    m_dir.clear();
+    if (dir.empty()) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "[MeshCache] can't create " << dir << ": " << ec.message() << std::endl;
+        return;
+    }
+    m_dir = dir;
+    evictStale();
+}
+
+// Keys change whenever a source file, a tessellation or kVersion does, so
+// old entries are never overwritten, only orphaned. Drop the least recently
+// used ones (and leftover .tmp files) until the directory fits kMaxBytes.
+void MeshCache::evictStale() const {
+    struct Entry {
+        std::filesystem::path           path;
+        std::filesystem::file_time_type used;
+        uintmax_t                       bytes;
+    };
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+
+    std::error_code ec;
+    for (const auto &e : std::filesystem::directory_iterator(m_dir, ec)) {
+        if (!e.is_regular_file(ec)) continue;
+        const std::filesystem::path &path = e.path();
+        if (path.extension() == ".tmp") {
+            std::filesystem::remove(path, ec);
+            continue;
+        }
+        if (path.extension() != ".mesh") continue;
+
+        Entry entry{path, e.last_write_time(ec), e.file_size(ec)};
+        if (ec) continue;
+        total += entry.bytes;
+        entries.push_back(std::move(entry));
+    }
+    if (total <= kMaxBytes) return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.used < b.used; });
+    size_t removed = 0;
+    for (const Entry &e : entries) {
+        if (total <= kMaxBytes) break;
+        if (std::filesystem::remove(e.path, ec)) {
+            total -= e.bytes;
+            ++removed;
+        }
+    }
+    std::cout << "[MeshCache] evicted " << removed << " stale meshes from " << m_dir << std::endl;
+}
+
+std::string MeshCache::pathFor(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long)key);
+    return (std::filesystem::path(m_dir) / name).string();
+}
+
+uint64_t MeshCache::primitiveKey(PrimitiveType type, int param1, int param2) {
+    uint64_t h = mix(kVersion, 'P');
+    h = mix(h, uint64_t(type));
+    h = mix(h, uint64_t(uint32_t(param1)));
+    return mix(h, uint64_t(uint32_t(param2)));
+}
+
+uint64_t MeshCache::fileKey(const std::string &path) {
+    MappedFile file(path);
+    if (!file.valid()) return 0;
+    return mix(hashBytes(file.data(), file.size(), mix(kVersion, 'F')), file.size());
+}
+
+std::unique_ptr<CachedMesh> MeshCache::load(uint64_t key, const VertexFormat &format) const {
+    if (!enabled()) return nullptr;
+
+    auto mesh = std::make_unique<CachedMesh>();
+    if (!mesh->m_file.open(pathFor(key))) return nullptr;
+
+    const char  *data = mesh->m_file.data();
+    const size_t size = mesh->m_file.size();
+    if (size < sizeof(FileHeader)) return nullptr;
+
+    FileHeader h;
+    std::memcpy(&h, data, sizeof(h));
+    if (std::memcmp(h.magic, kMagic, 4) != 0 || h.version != kVersion || h.key != key ||
+        h.fileSize != size || h.stride != format.stride ||
+        h.attribCount != format.attribs.size()) {
+        return nullptr;
+    }
+
+    // every blob inside the file and aligned
+    auto fits = [&](uint64_t offset, uint64_t bytes) {
+        return offset % 16 == 0 && offset <= size && bytes <= size - offset;
+    };
+    const uint64_t vertexBytes = uint64_t(h.vertexCount) * uint64_t(h.stride);
+    if (!fits(h.formatOffset, h.attribCount * sizeof(FileAttrib)) ||
+        !fits(h.vertexOffset, vertexBytes) ||
+        !fits(h.indexOffset, uint64_t(h.indexCount) * sizeof(uint32_t)) ||
+        !fits(h.lodOffset, uint64_t(h.lodCount) * sizeof(MeshLod))) {
+        return nullptr;
+    }
+
+    const std::vector<FileAttrib> expected = describe(format);
+    if (std::memcmp(data + h.formatOffset, expected.data(), expected.size() * sizeof(FileAttrib)) != 0) {
+        return nullptr;
+    }
+
+    // a corrupt index would read past the vertex range on the GPU
+    const uint32_t *indices = reinterpret_cast<const uint32_t*>(data + h.indexOffset);
+    uint32_t maxIndex = 0;
+    for (uint32_t i = 0; i < h.indexCount; ++i) maxIndex = std::max(maxIndex, indices[i]);
+    if (h.indexCount > 0 && maxIndex >= h.vertexCount) return nullptr;
+
+    // every LOD a whole-triangle range of the index blob; addShapeMesh draws
+    // them without further checks
+    if (h.lodCount == 0) return nullptr;
+    const MeshLod *lods = reinterpret_cast<const MeshLod*>(data + h.lodOffset);
+    for (uint32_t i = 0; i < h.lodCount; ++i) {
+        const MeshLod &lod = lods[i];
+        if (lod.indexCount % 3 != 0 || lod.firstIndex > h.indexCount ||
+            lod.indexCount > h.indexCount - lod.firstIndex) {
+            return nullptr;
+        }
+    }
+
+    mesh->m_vertices    = data + h.vertexOffset;
+    mesh->m_vertexCount = h.vertexCount;
+    mesh->m_indices     = indices;
+    mesh->m_indexCount  = h.indexCount;
+    mesh->m_lods        = lods;
+    mesh->m_lodCount    = h.lodCount;
+    mesh->m_boundsMin   = glm::vec3(h.boundsMin[0], h.boundsMin[1], h.boundsMin[2]);
+    mesh->m_boundsMax   = glm::vec3(h.boundsMax[0], h.boundsMax[1], h.boundsMax[2]);
+
+    // the write time doubles as last use for evictStale()
+    std::error_code ec;
+    std::filesystem::last_write_time(pathFor(key), std::filesystem::file_time_type::clock::now(), ec);
+    return mesh;
+}
+
+bool MeshCache::store(uint64_t key, const VertexFormat &format, const MeshBlob &blob) const {
+    if (!enabled()) return false;
+
+    std::vector<MeshLod> lods = blob.lods;
+    if (lods.empty()) lods.push_back({0, blob.indexCount, 0.f});
+
+    const std::vector<FileAttrib> attribs = describe(format);
+    const uint64_t vertexBytes = uint64_t(blob.vertexCount) * uint64_t(format.stride);
+
+    FileHeader h = {};
+    std::memcpy(h.magic, kMagic, 4);
+    h.version      = kVersion;
+    h.key          = key;
+    h.vertexCount  = blob.vertexCount;
+    h.indexCount   = blob.indexCount;
+    h.lodCount     = uint32_t(lods.size());
+    h.attribCount  = uint32_t(attribs.size());
+    h.stride       = format.stride;
+    for (int i = 0; i < 3; ++i) {
+        h.boundsMin[i] = blob.boundsMin[i];
+        h.boundsMax[i] = blob.boundsMax[i];
+    }
+    h.formatOffset = align16(sizeof(FileHeader));
+    h.vertexOffset = align16(h.formatOffset + attribs.size() * sizeof(FileAttrib));
+    h.indexOffset  = align16(h.vertexOffset + vertexBytes);
+    h.lodOffset    = align16(h.indexOffset + uint64_t(blob.indexCount) * sizeof(uint32_t));
+    h.fileSize     = h.lodOffset + lods.size() * sizeof(MeshLod);
+
+    // write next to the target and rename, so a crash never leaves a
+    // half-written file under a valid name
+    const std::string path = pathFor(key);
+    const std::string tmp  = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[MeshCache] can't write " << tmp << std::endl;
+            return false;
+        }
+        auto writeAt = [&](uint64_t offset, const void *bytes, uint64_t count) {
+            static const char zeros[16] = {};
+            const uint64_t pos = uint64_t(out.tellp());
+            out.write(zeros, std::streamsize(offset - pos));
+            out.write(static_cast<const char*>(bytes), std::streamsize(count));
+        };
+        writeAt(0, &h, sizeof(h));
+        writeAt(h.formatOffset, attribs.data(), attribs.size() * sizeof(FileAttrib));
+        writeAt(h.vertexOffset, blob.vertices, vertexBytes);
+        writeAt(h.indexOffset,  blob.indices, uint64_t(blob.indexCount) * sizeof(uint32_t));
+        writeAt(h.lodOffset,    lods.data(), lods.size() * sizeof(MeshLod));
+        if (!out) {
+            std::cerr << "[MeshCache] write to " << tmp << " failed" << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
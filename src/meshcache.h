@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mappedfile.h"
+#include "meshpool.h"
+#include "scenedata.h"
+
+// One level of detail: a range of the mesh's index blob.
+struct MeshLod {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    float    error      = 0.f;   // object-space deviation from LOD 0
+};
+
+// GPU-ready mesh to write to the cache; vertices are already in the
+// layout of `format`.
+struct MeshBlob {
+    const void           *vertices    = nullptr;
+    uint32_t              vertexCount = 0;
+    const uint32_t       *indices     = nullptr;
+    uint32_t              indexCount  = 0;
+    glm::vec3             boundsMin   = glm::vec3(0.f);
+    glm::vec3             boundsMax   = glm::vec3(0.f);
+    std::vector<MeshLod>  lods;        // empty = one LOD with every index
+};
+
+// A cache file mapped into memory. The pointers point into the mapping, so
+// they can go straight to glBufferSubData without a copy.
+class CachedMesh {
+public:
+    const void     *vertices()    const { return m_vertices; }
+    uint32_t        vertexCount() const { return m_vertexCount; }
+    const uint32_t *indices()     const { return m_indices; }
+    uint32_t        indexCount()  const { return m_indexCount; }
+    glm::vec3       boundsMin()   const { return m_boundsMin; }
+    glm::vec3       boundsMax()   const { return m_boundsMax; }
+    const MeshLod  *lods()        const { return m_lods; }
+    uint32_t        lodCount()    const { return m_lodCount; }
+
+private:
+    friend class MeshCache;
+
+    MappedFile      m_file;
+    const void     *m_vertices    = nullptr;
+    uint32_t        m_vertexCount = 0;
+    const uint32_t *m_indices     = nullptr;
+    uint32_t        m_indexCount  = 0;
+    glm::vec3       m_boundsMin   = glm::vec3(0.f);
+    glm::vec3       m_boundsMax   = glm::vec3(0.f);
+    const MeshLod  *m_lods        = nullptr;
+    uint32_t        m_lodCount    = 0;
+};
+
+// On-disk cache of built meshes, one file per key:
+//
+//   header      magic, version, key, counts, bounds, blob offsets
+//   format      stride + attribute list the vertex blob is laid out in
+//   vertices    vertexCount * stride bytes
+//   indices     uint32 triangle list
+//   lods        MeshLod table
+//
+// Blobs are 16-byte aligned and stored in native byte order. Keys hash the
+// mesh's source (the OBJ file's bytes, or primitive type + tessellation)
+// together with kVersion, so changing a generator or the optimizer only
+// needs a version bump to invalidate old files. A file whose header, format,
+// sizes, indices or LOD ranges don't match is treated as a miss and
+// overwritten.
+//
+// Orphaned keys are never reused, so setDirectory() evicts the least recently
+// loaded files once the directory grows past kMaxBytes.
+class MeshCache {
+public:
+    static constexpr uint32_t  kVersion  = 2;
+    static constexpr uintmax_t kMaxBytes = uintmax_t(256) << 20;
+
+    // Creates the directory if needed; an empty path disables the cache.
+    void setDirectory(const std::string &dir);
+    bool enabled() const { return !m_dir.empty(); }
+
+    // nullptr on a miss
+    std::unique_ptr<CachedMesh> load(uint64_t key, const VertexFormat &format) const;
+    bool store(uint64_t key, const VertexFormat &format, const MeshBlob &blob) const;
+
+    static uint64_t primitiveKey(PrimitiveType type, int param1, int param2);
+    // 0 if the file can't be read
+    static uint64_t fileKey(const std::string &path);
+
+private:
+    std::string pathFor(uint64_t key) const;
+    void        evictStale() const;
+
+    std::string m_dir;
+};
@@ -0,0 +1,363 @@
+#include "meshoptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+namespace {
+
+// ---------- Forsyth scoring ----------
+
+constexpr float kCacheDecayPower   = 1.5f;
+constexpr float kLastTriScore      = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+float vertexScore(int cachePos, int remainingValence) {
+    if (remainingValence == 0) return -1.f;   // no triangles left
+
+    float score = 0.f;
+    if (cachePos >= 0) {
+        if (cachePos < 3) {
+            // just used by the last triangle: slightly penalized so the
+            // strip doesn't double back on itself
+            score = kLastTriScore;
+        } else {
+            const float scale = 1.f / (MeshOptimizer::kForsythCacheSize - 3);
+            score = std::pow(1.f - (cachePos - 3) * scale, kCacheDecayPower);
+        }
+    }
+    // favour vertices with few triangles left, to finish them off
+    score += kValenceBoostScale * std::pow(float(remainingValence), -kValenceBoostPower);
+    return score;
+}
+
+// FIFO cache simulation; calls onMiss for every vertex that had to be
+// transformed.
+template <typename OnMiss>
+int simulateFifo(const uint32_t *indices, size_t count, int cacheSize,
+                 std::vector<uint32_t> &stamp, uint32_t &time, OnMiss onMiss) {
+    int misses = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t v = indices[i];
+        // stamp = time the vertex entered the cache; older than cacheSize
+        // insertions ago means it was pushed out
+        if (stamp[v] == 0 || time - stamp[v] >= uint32_t(cacheSize)) {
+            stamp[v] = ++time;
+            misses++;
+            onMiss(i);
+        }
+    }
+    return misses;
+}
+
+} // namespace
+
+IndexedMesh MeshOptimizer::indexTriangles(const std::vector<float> &soup, int floatsPerVertex) {
+    IndexedMesh mesh;
+    mesh.floatsPerVertex = floatsPerVertex;
+
+    const size_t n = soup.size() / floatsPerVertex;
+    const size_t bytes = floatsPerVertex * sizeof(float);
+
+    // hash of the raw bits -> first vertex with them
+    auto hashVertex = [&](const float *v) {
+        uint64_t h = 1469598103934665603ull;
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(v);
+        for (size_t i = 0; i < bytes; ++i) {
+            h = (h ^ p[i]) * 1099511628211ull;
+        }
+        return h;
+    };
+
+    std::unordered_multimap<uint64_t, uint32_t> lookup;
+    lookup.reserve(n);
+    mesh.indices.reserve(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        const float *v = &soup[i * floatsPerVertex];
+        uint64_t h = hashVertex(v);
+
+        uint32_t index = UINT32_MAX;
+        auto range = lookup.equal_range(h);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (std::memcmp(&mesh.vertices[size_t(it->second) * floatsPerVertex], v, bytes) == 0) {
+                index = it->second;
+                break;
+            }
+        }
+        if (index == UINT32_MAX) {
+            index = mesh.vertexCount();
+            mesh.vertices.insert(mesh.vertices.end(), v, v + floatsPerVertex);
+            lookup.emplace(h, index);
+        }
+        mesh.indices.push_back(index);
+    }
+    return mesh;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount) {
+    const size_t triCount = indices.size() / 3;
+    if (triCount == 0) return;
+
+    // ---------- adjacency: vertex -> triangles ----------
+    std::vector<uint32_t> valence(vertexCount, 0);
+    for (uint32_t v : indices) valence[v]++;
+
+    std::vector<uint32_t> adjOffset(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; ++v) adjOffset[v + 1] = adjOffset[v] + valence[v];
+
+    std::vector<uint32_t> adj(indices.size());
+    {
+        std::vector<uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+        for (size_t t = 0; t < triCount; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = indices[t * 3 + k];
+                adj[fill[v]++] = uint32_t(t);
+            }
+        }
+    }
+
+    // ---------- initial scores ----------
+    std::vector<float> vScore(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v) vScore[v] = vertexScore(-1, int(valence[v]));
+
+    std::vector<char> emitted(triCount, 0);
+
+    // removes triangle t from v's remaining list
+    std::vector<uint32_t> remaining = valence;
+    auto detach = [&](uint32_t v, uint32_t t) {
+        uint32_t *begin = &adj[adjOffset[v]];
+        uint32_t *end   = begin + remaining[v];
+        uint32_t *it    = std::find(begin, end, t);
+        std::swap(*it, *(end - 1));
+        remaining[v]--;
+    };
+
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(kForsythCacheSize + 3);
+    nextCache.reserve(kForsythCacheSize + 3);
+
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+
+    size_t scanCursor = 0;   // fallback search when no cached vertex has triangles left
+    int64_t best = -1;
+    {
+        float bestScore = -1.f;
+        for (size_t t = 0; t < triCount; ++t) {
+            float s = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+            if (s > bestScore) { bestScore = s; best = int64_t(t); }
+        }
+    }
+
+    while (best >= 0) {
+        const uint32_t t = uint32_t(best);
+        emitted[t] = 1;
+        const uint32_t tri[3] = {indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]};
+        out.insert(out.end(), tri, tri + 3);
+
+        for (uint32_t v : tri) detach(v, t);
+
+        // new LRU order: this triangle's vertices first, then the old cache
+        nextCache.assign(tri, tri + 3);
+        for (uint32_t v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) nextCache.push_back(v);
+        }
+
+        // vertices pushed out of the modelled cache lose their cache score
+        for (size_t i = kForsythCacheSize; i < nextCache.size(); ++i) {
+            uint32_t v = nextCache[i];
+            vScore[v] = vertexScore(-1, int(remaining[v]));
+        }
+        if (nextCache.size() > size_t(kForsythCacheSize)) nextCache.resize(kForsythCacheSize);
+        cache.swap(nextCache);
+
+        for (size_t i = 0; i < cache.size(); ++i) {
+            uint32_t v = cache[i];
+            vScore[v] = vertexScore(int(i), int(remaining[v]));
+        }
+
+        // rescore the triangles around the cache, pick the best of them
+        best = -1;
+        float bestScore = -1.f;
+        for (uint32_t v : cache) {
+            for (uint32_t i = 0; i < remaining[v]; ++i) {
+                uint32_t at = adj[adjOffset[v] + i];
+                float s = vScore[indices[at * 3]] + vScore[indices[at * 3 + 1]] + vScore[indices[at * 3 + 2]];
+                if (s > bestScore) { bestScore = s; best = at; }
+            }
+        }
+
+        // nothing adjacent left: continue with the next unemitted triangle
+        if (best < 0) {
+            while (scanCursor < triCount && emitted[scanCursor]) scanCursor++;
+            if (scanCursor < triCount) best = int64_t(scanCursor);
+        }
+    }
+
+    indices.swap(out);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t> &indices, const IndexedMesh &mesh,
+                                     float threshold) {
+    const size_t triCount = indices.size() / 3;
+    if (triCount < 2) return;
+
+    const uint32_t vertexCount = mesh.vertexCount();
+    std::vector<uint32_t> stamp(vertexCount, 0);
+    uint32_t time = 0;
+
+    // ---------- 1) hard boundaries: triangles whose vertices all missed ----------
+    std::vector<size_t> hard;   // first triangle of each hard cluster
+    {
+        std::vector<int> missesPerTri(triCount, 0);
+        simulateFifo(indices.data(), indices.size(), kCacheSize, stamp, time,
+                     [&](size_t i) { missesPerTri[i / 3]++; });
+        for (size_t t = 0; t < triCount; ++t) {
+            if (t == 0 || missesPerTri[t] == 3) hard.push_back(t);
+        }
+    }
+    hard.push_back(triCount);
+
+    // ---------- 2) soft boundaries inside each hard cluster ----------
+    // A cluster may end wherever its running ACMR is within threshold of the
+    // whole hard cluster's, since restarting the cache there costs little.
+    std::vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); ++h) {
+        const size_t begin = hard[h], end = hard[h + 1];
+
+        std::fill(stamp.begin(), stamp.end(), 0);
+        time = 0;
+        int total = simulateFifo(&indices[begin * 3], (end - begin) * 3, kCacheSize, stamp, time, [](size_t) {});
+        const float clusterAcmr = float(total) / float(end - begin);
+
+        std::fill(stamp.begin(), stamp.end(), 0);
+        time = 0;
+        size_t start = begin;
+        int misses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            misses += simulateFifo(&indices[t * 3], 3, kCacheSize, stamp, time,
+                                   [](size_t) {});
+            float acmr = float(misses) / float(t + 1 - start);
+            if (t + 1 < end && t + 1 - start >= 8 && acmr <= clusterAcmr * threshold) {
+                clusters.push_back(start);
+                start = t + 1;
+                misses = 0;
+                std::fill(stamp.begin(), stamp.end(), 0);
+                time = 0;
+            }
+        }
+        clusters.push_back(start);
+    }
+    clusters.push_back(triCount);
+
+    // ---------- 3) order clusters by how much they face outward ----------
+    auto pos = [&](uint32_t v) {
+        const float *p = &mesh.vertices[size_t(v) * mesh.floatsPerVertex];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    glm::vec3 meshCenter(0.f);
+    float     meshArea = 0.f;
+    struct Cluster { size_t begin, end; glm::vec3 center, normal; float area; float key; };
+    std::vector<Cluster> cs;
+
+    for (size_t c = 0; c + 1 < clusters.size(); ++c) {
+        Cluster cl{clusters[c], clusters[c + 1], glm::vec3(0.f), glm::vec3(0.f), 0.f, 0.f};
+        for (size_t t = cl.begin; t < cl.end; ++t) {
+            glm::vec3 a = pos(indices[t * 3]), b = pos(indices[t * 3 + 1]), d = pos(indices[t * 3 + 2]);
+            glm::vec3 n = glm::cross(b - a, d - a);   // length = 2 * area
+            float area = 0.5f * glm::length(n);
+            cl.center += area * (a + b + d) / 3.f;
+            cl.normal += n;
+            cl.area   += area;
+        }
+        meshCenter += cl.center;
+        meshArea   += cl.area;
+        if (cl.area > 0.f) cl.center /= cl.area;
+        float len = glm::length(cl.normal);
+        if (len > 0.f) cl.normal /= len;
+        cs.push_back(cl);
+    }
+    if (meshArea > 0.f) meshCenter /= meshArea;
+
+    for (Cluster &cl : cs) {
+        cl.key = glm::dot(cl.center - meshCenter, cl.normal);
+    }
+    std::stable_sort(cs.begin(), cs.end(), [](const Cluster &a, const Cluster &b) {
+        return a.key > b.key;
+    });
+
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    for (const Cluster &cl : cs) {
+        out.insert(out.end(), indices.begin() + cl.begin * 3, indices.begin() + cl.end * 3);
+    }
+    indices.swap(out);
+}
+
+void MeshOptimizer::optimizeVertexFetch(IndexedMesh &mesh) {
+    const uint32_t vertexCount = mesh.vertexCount();
+    const int fpv = mesh.floatsPerVertex;
+
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    uint32_t next = 0;
+    for (uint32_t &i : mesh.indices) {
+        if (remap[i] == UINT32_MAX) {
+            remap[i] = next++;
+            const float *v = &mesh.vertices[size_t(i) * fpv];
+            vertices.insert(vertices.end(), v, v + fpv);
+        }
+        i = remap[i];
+    }
+    mesh.vertices.swap(vertices);   // unreferenced vertices are dropped
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t> &indices,
+                                                   uint32_t vertexCount, int cacheSize) {
+    VertexCacheStats s;
+    if (indices.empty() || vertexCount == 0) return s;
+
+    std::vector<uint32_t> stamp(vertexCount, 0);
+    uint32_t time = 0;
+    int misses = simulateFifo(indices.data(), indices.size(), cacheSize, stamp, time,
+                              [](size_t) {});
+
+    s.acmr = float(misses) / float(indices.size() / 3);
+    s.atvr = float(misses) / float(vertexCount);
+    return s;
+}
+
+IndexedMesh MeshOptimizer::optimize(const std::vector<float> &soup, int floatsPerVertex,
+                                    MeshOptimizeReport *report) {
+    IndexedMesh mesh = indexTriangles(soup, floatsPerVertex);
+    optimize(mesh, report);
+    if (report) {
+        report->soupVertices = uint32_t(soup.size() / floatsPerVertex);
+    }
+    return mesh;
+}
+
+void MeshOptimizer::optimize(IndexedMesh &mesh, MeshOptimizeReport *report) {
+    if (report) {
+        report->soupVertices = uint32_t(mesh.indices.size());
+        report->vertices     = mesh.vertexCount();
+        report->triangles    = mesh.triangleCount();
+        report->generated    = analyzeVertexCache(mesh.indices, mesh.vertexCount());
+    }
+
+    optimizeVertexCache(mesh.indices, mesh.vertexCount());
+    optimizeOverdraw(mesh.indices, mesh);
+    optimizeVertexFetch(mesh);
+
+    if (report) {
+        report->optimized = analyzeVertexCache(mesh.indices, mesh.vertexCount());
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Indexed triangle mesh with interleaved float vertices. The first three
+// floats of a vertex are its position, the next three its normal.
+struct IndexedMesh {
+    int                   floatsPerVertex = 6;
+    std::vector<float>    vertices;
+    std::vector<uint32_t> indices;
+
+    uint32_t vertexCount()   const { return uint32_t(vertices.size() / floatsPerVertex); }
+    uint32_t triangleCount() const { return uint32_t(indices.size() / 3); }
+};
+
+// Post-transform cache behaviour of an index order, simulated with a FIFO
+// cache like the ones in most GPUs.
+//   ACMR = cache misses per triangle (0.5 is ideal for big grids, 3 is a soup)
+//   ATVR = cache misses per unique vertex (1.0 is ideal)
+struct VertexCacheStats {
+    float acmr = 0.f;
+    float atvr = 0.f;
+};
+
+struct MeshOptimizeReport {
+    uint32_t         soupVertices = 0;   // before indexing
+    uint32_t         vertices     = 0;   // unique, after indexing
+    uint32_t         triangles    = 0;
+    VertexCacheStats generated;          // indexed, generation order
+    VertexCacheStats optimized;
+};
+
+// Reports summed over many meshes; ACMR / ATVR are weighted by triangle /
+// vertex count, i.e. total misses over total triangles / vertices.
+struct MeshOptimizeTotals {
+    uint32_t meshes    = 0;
+    uint64_t triangles = 0;
+    uint64_t vertices  = 0;
+    double   generatedMisses = 0.0;
+    double   optimizedMisses = 0.0;
+
+    void add(const MeshOptimizeReport &r) {
+        if (r.triangles == 0) return;
+        meshes++;
+        triangles += r.triangles;
+        vertices  += r.vertices;
+        generatedMisses += double(r.generated.acmr) * r.triangles;
+        optimizedMisses += double(r.optimized.acmr) * r.triangles;
+    }
+    VertexCacheStats generated() const { return stats(generatedMisses); }
+    VertexCacheStats optimized() const { return stats(optimizedMisses); }
+
+private:
+    VertexCacheStats stats(double misses) const {
+        VertexCacheStats s;
+        if (triangles) s.acmr = float(misses / double(triangles));
+        if (vertices)  s.atvr = float(misses / double(vertices));
+        return s;
+    }
+};
+
+// Mesh optimization run once when a mesh is built:
+//   1. indexTriangles      - merges bit-identical vertices of a triangle soup
+//   2. optimizeVertexCache - Forsyth's greedy reordering for an LRU cache
+//   3. optimizeOverdraw    - splits the result into clusters at cache-miss
+//                            boundaries and puts outward-facing clusters first,
+//                            so the far side of a shape fails the depth test
+//   4. optimizeVertexFetch - renumbers vertices in first-use order
+class MeshOptimizer {
+public:
+    static constexpr int   kCacheSize         = 16;     // simulated FIFO for the stats
+    static constexpr int   kForsythCacheSize  = 32;     // LRU model used for scoring
+    static constexpr float kOverdrawThreshold = 1.05f;  // allowed ACMR loss for clustering
+
+    static IndexedMesh indexTriangles(const std::vector<float> &soup, int floatsPerVertex);
+
+    static void optimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount);
+    static void optimizeOverdraw(std::vector<uint32_t> &indices, const IndexedMesh &mesh,
+                                 float threshold = kOverdrawThreshold);
+    static void optimizeVertexFetch(IndexedMesh &mesh);
+
+    static VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices,
+                                               uint32_t vertexCount,
+                                               int cacheSize = kCacheSize);
+
+    // indexTriangles + all optimizations
+    static IndexedMesh optimize(const std::vector<float> &soup, int floatsPerVertex,
+                                MeshOptimizeReport *report = nullptr);
+
+    // all optimizations on an already indexed mesh, in place
+    static void optimize(IndexedMesh &mesh, MeshOptimizeReport *report = nullptr);
+};
@@ -0,0 +1,288 @@
+#include "meshpool.h"
+
+#include <algorithm>
+#include <iostream>
+
+// ================= RangeAllocator =================
+
+void RangeAllocator::reset(uint32_t capacity, uint32_t used) {
+    m_free.clear();
+    m_capacity  = capacity;
+    m_freeTotal = capacity - std::min(used, capacity);
+    if (m_freeTotal > 0) {
+        m_free.emplace(capacity - m_freeTotal, m_freeTotal);
+    }
+}
+
+uint32_t RangeAllocator::allocate(uint32_t size) {
+    if (size == 0) return kNoSpace;
+
+    auto best = m_free.end();
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        if (it->second >= size && (best == m_free.end() || it->second < best->second)) {
+            best = it;
+            if (it->second == size) break;
+        }
+    }
+    if (best == m_free.end()) return kNoSpace;
+
+    uint32_t offset = best->first;
+    uint32_t rest   = best->second - size;
+    m_free.erase(best);
+    if (rest > 0) {
+        m_free.emplace(offset + size, rest);
+    }
+    m_freeTotal -= size;
+    return offset;
+}
+
+void RangeAllocator::release(uint32_t offset, uint32_t size) {
+    if (size == 0) return;
+    m_freeTotal += size;
+
+    auto next = m_free.lower_bound(offset);
+
+    // merge with the range before
+    if (next != m_free.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size  += prev->second;
+            m_free.erase(prev);
+        }
+    }
+    // ... and the one after
+    if (next != m_free.end() && offset + size == next->first) {
+        size += next->second;
+        m_free.erase(next);
+    }
+    m_free.emplace(offset, size);
+}
+
+bool RangeAllocator::packed() const {
+    if (m_free.empty()) return true;
+    auto last = m_free.begin();
+    return m_free.size() == 1 && last->first + last->second == m_capacity;
+}
+
+uint32_t RangeAllocator::largestFree() const {
+    uint32_t best = 0;
+    for (const auto &[offset, size] : m_free) {
+        best = std::max(best, size);
+    }
+    return best;
+}
+
+// ================= MeshPool =================
+
+namespace {
+
+// Fresh buffer of newBytes with the given (src, dst, bytes) ranges copied
+// over from oldBuffer; uses the copy targets so no VAO state is touched.
+struct CopyRange {
+    GLintptr   src, dst;
+    GLsizeiptr bytes;
+};
+
+GLuint copyIntoNewBuffer(GLuint oldBuffer, GLsizeiptr newBytes, const std::vector<CopyRange> &ranges) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+    for (const CopyRange &r : ranges) {
+        if (r.bytes > 0) glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, r.src, r.dst, r.bytes);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (oldBuffer) glDeleteBuffers(1, &oldBuffer);
+    return buffer;
+}
+
+void upload(GLuint buffer, GLintptr offset, GLsizeiptr bytes, const void *data) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+} // namespace
+
+bool MeshPool::create(const VertexFormat &format, uint32_t initialVertices, uint32_t initialIndices) {
+    destroy();
+    m_format = format;
+    if (m_format.stride <= 0) {
+        std::cerr << "[MeshPool] vertex format has no size" << std::endl;
+        return false;
+    }
+
+    glGenVertexArrays(1, &m_vao);
+    m_vbo = copyIntoNewBuffer(0, GLsizeiptr(initialVertices) * m_format.stride, {});
+    m_ibo = copyIntoNewBuffer(0, GLsizeiptr(initialIndices) * sizeof(uint32_t), {});
+
+    bindAttributes();
+    m_ranges.reset(initialVertices);
+    m_indexRanges.reset(initialIndices);
+    return true;
+}
+
+void MeshPool::destroy() {
+    if (m_vbo) glDeleteBuffers(1, &m_vbo);
+    if (m_ibo) glDeleteBuffers(1, &m_ibo);
+    if (m_vao) glDeleteVertexArrays(1, &m_vao);
+    m_vbo = 0;
+    m_ibo = 0;
+    m_vao = 0;
+
+    // keep generations so old handles stay stale
+    m_freeEntries.clear();
+    for (uint32_t i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].live) {
+            m_entries[i].live = false;
+            m_entries[i].generation++;
+        }
+        m_freeEntries.push_back(i);
+    }
+    m_ranges.reset(0);
+    m_indexRanges.reset(0);
+}
+
+void MeshPool::bindAttributes() {
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    for (const VertexAttrib &a : m_format.attribs) {
+        glEnableVertexAttribArray(a.location);
+        glVertexAttribPointer(a.location, a.components, a.type, a.normalized, m_format.stride,
+                              (void*)(intptr_t(a.offset)));
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);   // recorded in the VAO
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool MeshPool::contains(MeshHandle h) const {
+    return h.index < m_entries.size() &&
+           m_entries[h.index].live &&
+           m_entries[h.index].generation == h.generation;
+}
+
+MeshHandle MeshPool::add(const void *vertices, uint32_t vertexCount,
+                         const uint32_t *indices, uint32_t indexCount) {
+    if (!m_vao || vertexCount == 0) return {};
+    if (!indices) indexCount = 0;
+
+    uint32_t offset      = m_ranges.allocate(vertexCount);
+    uint32_t indexOffset = indexCount ? m_indexRanges.allocate(indexCount) : 0;
+
+    if (offset == RangeAllocator::kNoSpace ||
+        (indexCount && indexOffset == RangeAllocator::kNoSpace)) {
+        // undo the half that worked, then pack (enough room in total) or grow
+        if (offset != RangeAllocator::kNoSpace) m_ranges.release(offset, vertexCount);
+        if (indexCount && indexOffset != RangeAllocator::kNoSpace) m_indexRanges.release(indexOffset, indexCount);
+
+        auto newCapacity = [](const RangeAllocator &r, uint32_t used, uint32_t extra) {
+            return (r.freeTotal() >= extra) ? r.capacity() : std::max(used + extra, r.capacity() * 2);
+        };
+        reallocate(newCapacity(m_ranges, usedVertices(), vertexCount),
+                   newCapacity(m_indexRanges, usedIndices(), indexCount));
+
+        offset      = m_ranges.allocate(vertexCount);
+        indexOffset = indexCount ? m_indexRanges.allocate(indexCount) : 0;
+    }
+
+    uint32_t index;
+    if (!m_freeEntries.empty()) {
+        index = m_freeEntries.back();
+        m_freeEntries.pop_back();
+    } else {
+        index = uint32_t(m_entries.size());
+        m_entries.push_back(Entry());
+    }
+
+    Entry &e = m_entries[index];
+    e.offset      = offset;
+    e.count       = vertexCount;
+    e.indexOffset = indexOffset;
+    e.indexCount  = indexCount;
+    e.live        = true;
+
+    const GLsizeiptr stride = m_format.stride;
+    upload(m_vbo, offset * stride, vertexCount * stride, vertices);
+    if (indexCount) {
+        upload(m_ibo, GLintptr(indexOffset) * sizeof(uint32_t),
+               GLsizeiptr(indexCount) * sizeof(uint32_t), indices);
+    }
+
+    return {index, e.generation};
+}
+
+void MeshPool::remove(MeshHandle h) {
+    if (!contains(h)) return;
+
+    Entry &e = m_entries[h.index];
+    m_ranges.release(e.offset, e.count);
+    m_indexRanges.release(e.indexOffset, e.indexCount);
+    e.live = false;
+    e.generation++;
+    m_freeEntries.push_back(h.index);
+}
+
+void MeshPool::draw(MeshHandle h) const {
+    const Entry &e = m_entries[h.index];
+    if (e.indexCount > 0) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(e.indexCount), GL_UNSIGNED_INT,
+                                 (void*)(intptr_t(e.indexOffset) * sizeof(uint32_t)), GLint(e.offset));
+    } else {
+        glDrawArrays(GL_TRIANGLES, GLint(e.offset), GLsizei(e.count));
+    }
+}
+
+void MeshPool::defragment() {
+    if (!m_vao || (m_ranges.packed() && m_indexRanges.packed())) return;
+    reallocate(m_ranges.capacity(), m_indexRanges.capacity());
+}
+
+void MeshPool::reallocate(uint32_t vertexCapacity, uint32_t indexCapacity) {
+    const GLsizeiptr stride = m_format.stride;
+    const GLsizeiptr isize  = sizeof(uint32_t);
+
+    // live meshes in buffer order, copied down to the front. Indices are
+    // relative to the base vertex, so moving vertices doesn't touch them.
+    std::vector<uint32_t> live;
+    for (uint32_t i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].live) live.push_back(i);
+    }
+
+    std::vector<CopyRange> vertexCopies, indexCopies;
+    uint32_t cursor = 0, indexCursor = 0;
+
+    std::sort(live.begin(), live.end(), [&](uint32_t a, uint32_t b) {
+        return m_entries[a].offset < m_entries[b].offset;
+    });
+    for (uint32_t i : live) {
+        Entry &e = m_entries[i];
+        vertexCopies.push_back({e.offset * stride, cursor * stride, e.count * stride});
+        e.offset = cursor;
+        cursor  += e.count;
+    }
+
+    std::sort(live.begin(), live.end(), [&](uint32_t a, uint32_t b) {
+        return m_entries[a].indexOffset < m_entries[b].indexOffset;
+    });
+    for (uint32_t i : live) {
+        Entry &e = m_entries[i];
+        if (e.indexCount == 0) continue;
+        indexCopies.push_back({e.indexOffset * isize, indexCursor * isize, e.indexCount * isize});
+        e.indexOffset = indexCursor;
+        indexCursor  += e.indexCount;
+    }
+
+    m_vbo = copyIntoNewBuffer(m_vbo, GLsizeiptr(vertexCapacity) * stride, vertexCopies);
+    m_ibo = copyIntoNewBuffer(m_ibo, GLsizeiptr(indexCapacity) * isize, indexCopies);
+
+    // the VAO still points at the old buffers
+    bindAttributes();
+    m_ranges.reset(vertexCapacity, cursor);
+    m_indexRanges.reset(indexCapacity, indexCursor);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Free list over [0, capacity) in vertex units. Free ranges are kept sorted
+// and coalesced with their neighbours; allocation is best fit.
+class RangeAllocator {
+public:
+    static constexpr uint32_t kNoSpace = UINT32_MAX;
+
+    // Everything from `used` up to `capacity` becomes one free range.
+    void reset(uint32_t capacity, uint32_t used = 0);
+
+    uint32_t allocate(uint32_t size);          // offset or kNoSpace
+    void     release(uint32_t offset, uint32_t size);
+
+    uint32_t capacity()    const { return m_capacity; }
+    uint32_t freeTotal()   const { return m_freeTotal; }
+    uint32_t largestFree() const;
+    size_t   freeRanges()  const { return m_free.size(); }
+    bool     packed()      const;   // all free space is one range at the end
+
+private:
+    std::map<uint32_t, uint32_t> m_free;   // offset -> size
+    uint32_t m_capacity  = 0;
+    uint32_t m_freeTotal = 0;
+};
+
+// One vertex attribute as fed to glVertexAttribPointer. Integer types with
+// normalized = GL_TRUE (and GL_HALF_FLOAT) are decoded to floats by the
+// vertex fetch, so packed layouts need no shader changes.
+struct VertexAttrib {
+    GLuint    location;
+    int       components;
+    GLenum    type;
+    GLboolean normalized;
+    int       offset;       // bytes
+};
+
+struct VertexFormat {
+    int                       stride = 0;   // bytes per vertex
+    std::vector<VertexAttrib> attribs;
+};
+
+// Stable reference to a mesh in a MeshPool; goes stale once it is removed.
+struct MeshHandle {
+    uint32_t index      = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool isNull() const { return index == UINT32_MAX; }
+};
+
+// All meshes of one vertex format in a single VBO (+ one index buffer)
+// behind a single VAO. Each mesh is a sub-range of the buffers; indexed
+// meshes keep indices relative to their own first vertex and are drawn with
+// glDrawElementsBaseVertex, the rest with glDrawArrays, so switching meshes
+// never switches the VAO. When no free range fits, the buffer is packed (if
+// enough space is free in total) or grown; both copy on the GPU and keep
+// handles valid.
+class MeshPool {
+public:
+    bool create(const VertexFormat &format, uint32_t initialVertices, uint32_t initialIndices = 0);
+    void destroy();
+
+    // vertices: vertexCount * stride bytes in the pool's format;
+    // indices (optional): triangle list, 0 = the mesh's first vertex
+    MeshHandle add(const void *vertices, uint32_t vertexCount,
+                   const uint32_t *indices = nullptr, uint32_t indexCount = 0);
+    void       remove(MeshHandle h);
+    bool       contains(MeshHandle h) const;
+
+    // Base vertex and vertex count
+    GLint   first(MeshHandle h) const { return GLint(m_entries[h.index].offset); }
+    GLsizei count(MeshHandle h) const { return GLsizei(m_entries[h.index].count); }
+
+    bool    indexed(MeshHandle h)    const { return m_entries[h.index].indexCount > 0; }
+    GLint   firstIndex(MeshHandle h) const { return GLint(m_entries[h.index].indexOffset); }
+    GLsizei indexCount(MeshHandle h) const { return GLsizei(m_entries[h.index].indexCount); }
+
+    // Draws the whole mesh; the pool's VAO must be bound.
+    void draw(MeshHandle h) const;
+
+    GLuint vao() const { return m_vao; }
+
+    // Moves every mesh to the front of a fresh buffer (one free range left).
+    void defragment();
+
+    const VertexFormat &format() const { return m_format; }
+
+    uint32_t capacityVertices() const { return m_ranges.capacity(); }
+    uint32_t usedVertices()     const { return m_ranges.capacity() - m_ranges.freeTotal(); }
+    uint32_t usedIndices()      const { return m_indexRanges.capacity() - m_indexRanges.freeTotal(); }
+    size_t   freeRanges()       const { return m_ranges.freeRanges(); }
+
+private:
+    struct Entry {
+        uint32_t offset      = 0;
+        uint32_t count       = 0;
+        uint32_t indexOffset = 0;
+        uint32_t indexCount  = 0;
+        uint32_t generation  = 0;
+        bool     live        = false;
+    };
+
+    // Copies live meshes, packed, into new buffers of the given sizes
+    void reallocate(uint32_t vertexCapacity, uint32_t indexCapacity);
+    void bindAttributes();
+
+    VertexFormat   m_format;
+    GLuint         m_vao = 0;
+    GLuint         m_vbo = 0;
+    GLuint         m_ibo = 0;
+    RangeAllocator m_ranges;        // vertices
+    RangeAllocator m_indexRanges;   // uint32 indices
+
+    std::vector<Entry>    m_entries;
+    std::vector<uint32_t> m_freeEntries;
+};
@@ -0,0 +1,293 @@
+#include "meshsimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+namespace {
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix
+// of Garland & Heckbert (upper triangle only).
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+
+    static Quadric plane(const glm::dvec3 &n, double d) {
+        Quadric q;
+        q.a2 = n.x * n.x; q.ab = n.x * n.y; q.ac = n.x * n.z; q.ad = n.x * d;
+        q.b2 = n.y * n.y; q.bc = n.y * n.z; q.bd = n.y * d;
+        q.c2 = n.z * n.z; q.cd = n.z * d;
+        q.d2 = d * d;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &o) {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+        b2 += o.b2; bc += o.bc; bd += o.bd;
+        c2 += o.c2; cd += o.cd;
+        d2 += o.d2;
+        return *this;
+    }
+
+    double eval(const glm::dvec3 &p) const {
+        const double x = p.x, y = p.y, z = p.z;
+        const double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                       + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                       + c2 * z * z + 2 * cd * z
+                       + d2;
+        return std::max(e, 0.0);
+    }
+};
+
+class Simplifier {
+public:
+    explicit Simplifier(const IndexedMesh &mesh)
+        : m_indices(mesh.indices) {
+        const uint32_t n = mesh.vertexCount();
+        m_pos.resize(n);
+        for (uint32_t i = 0; i < n; ++i) {
+            const float *v = &mesh.vertices[size_t(i) * mesh.floatsPerVertex];
+            m_pos[i] = glm::dvec3(v[0], v[1], v[2]);
+        }
+        m_remap.resize(n);
+        for (uint32_t i = 0; i < n; ++i) m_remap[i] = i;
+
+        lockSeamsAndBorders(mesh);
+        buildQuadrics();
+    }
+
+    uint32_t triangleCount() const { return uint32_t(m_indices.size() / 3); }
+    const std::vector<uint32_t> &indices() const { return m_indices; }
+    float error() const { return float(std::sqrt(m_maxCost)); }
+
+    // Collapses edges until at most `target` triangles are left or nothing
+    // more can be collapsed.
+    void reduceTo(uint32_t target) {
+        while (triangleCount() > target) {
+            if (runPass(target) == 0) break;
+        }
+    }
+
+private:
+    struct Collapse {
+        double   cost;
+        uint32_t from, to;
+    };
+
+    void lockSeamsAndBorders(const IndexedMesh &mesh) {
+        const uint32_t n = uint32_t(m_pos.size());
+
+        // vertices sharing a position (different normals) form one group
+        std::vector<uint32_t> group(n);
+        std::vector<uint32_t> groupSize;
+        {
+            std::unordered_map<uint64_t, std::vector<uint32_t>> byHash;
+            byHash.reserve(n);
+            for (uint32_t i = 0; i < n; ++i) {
+                const float *v = &mesh.vertices[size_t(i) * mesh.floatsPerVertex];
+                uint64_t h = 1469598103934665603ull;
+                const unsigned char *p = reinterpret_cast<const unsigned char*>(v);
+                for (size_t b = 0; b < 3 * sizeof(float); ++b) h = (h ^ p[b]) * 1099511628211ull;
+
+                std::vector<uint32_t> &bucket = byHash[h];
+                uint32_t g = UINT32_MAX;
+                for (uint32_t other : bucket) {
+                    if (std::memcmp(&mesh.vertices[size_t(other) * mesh.floatsPerVertex], v, 3 * sizeof(float)) == 0) {
+                        g = group[other];
+                        break;
+                    }
+                }
+                if (g == UINT32_MAX) {
+                    g = uint32_t(groupSize.size());
+                    groupSize.push_back(0);
+                }
+                bucket.push_back(i);
+                group[i] = g;
+                groupSize[g]++;
+            }
+        }
+
+        // edges used by one triangle only are open borders
+        std::unordered_map<uint64_t, uint32_t> edgeUse;
+        edgeUse.reserve(m_indices.size());
+        auto edgeKey = [&](uint32_t a, uint32_t b) {
+            uint32_t ga = group[a], gb = group[b];
+            if (ga > gb) std::swap(ga, gb);
+            return (uint64_t(ga) << 32) | gb;
+        };
+        for (size_t t = 0; t + 2 < m_indices.size(); t += 3) {
+            for (int e = 0; e < 3; ++e) {
+                edgeUse[edgeKey(m_indices[t + e], m_indices[t + (e + 1) % 3])]++;
+            }
+        }
+
+        std::vector<char> borderGroup(groupSize.size(), 0);
+        for (const auto &[key, uses] : edgeUse) {
+            if (uses == 1) {
+                borderGroup[key >> 32]         = 1;
+                borderGroup[key & 0xffffffffu] = 1;
+            }
+        }
+
+        m_locked.resize(n);
+        for (uint32_t i = 0; i < n; ++i) {
+            m_locked[i] = groupSize[group[i]] > 1 || borderGroup[group[i]];
+        }
+    }
+
+    void buildQuadrics() {
+        m_quadrics.assign(m_pos.size(), Quadric());
+        for (size_t t = 0; t + 2 < m_indices.size(); t += 3) {
+            const uint32_t a = m_indices[t], b = m_indices[t + 1], c = m_indices[t + 2];
+            glm::dvec3 n = glm::cross(m_pos[b] - m_pos[a], m_pos[c] - m_pos[a]);
+            const double len = glm::length(n);
+            if (len == 0.0) continue;
+            n /= len;
+            const Quadric q = Quadric::plane(n, -glm::dot(n, m_pos[a]));
+            m_quadrics[a] += q;
+            m_quadrics[b] += q;
+            m_quadrics[c] += q;
+        }
+    }
+
+    // vertex -> triangles, CSR
+    void buildAdjacency() {
+        const size_t n = m_pos.size();
+        m_adjStart.assign(n + 1, 0);
+        for (uint32_t v : m_indices) m_adjStart[v + 1]++;
+        for (size_t i = 0; i < n; ++i) m_adjStart[i + 1] += m_adjStart[i];
+
+        m_adj.resize(m_indices.size());
+        std::vector<uint32_t> fill(m_adjStart.begin(), m_adjStart.end() - 1);
+        for (size_t i = 0; i < m_indices.size(); ++i) {
+            m_adj[fill[m_indices[i]]++] = uint32_t(i / 3);
+        }
+    }
+
+    // No triangle around `from` may turn over (or collapse to nothing)
+    // when `from` moves to `to`.
+    bool keepsOrientation(uint32_t from, uint32_t to) const {
+        const glm::dvec3 &target = m_pos[to];
+        for (uint32_t k = m_adjStart[from]; k < m_adjStart[from + 1]; ++k) {
+            const uint32_t *tri = &m_indices[size_t(m_adj[k]) * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) continue;   // removed
+
+            glm::dvec3 p[3] = {m_pos[tri[0]], m_pos[tri[1]], m_pos[tri[2]]};
+            const glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            p[tri[0] == from ? 0 : tri[1] == from ? 1 : 2] = target;
+            const glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+            if (glm::dot(before, after) <= 0.0) return false;
+        }
+        return true;
+    }
+
+    // One round of independent collapses; returns how many were made.
+    uint32_t runPass(uint32_t target) {
+        buildAdjacency();
+
+        std::vector<Collapse> candidates;
+        candidates.reserve(m_indices.size());
+        for (size_t t = 0; t + 2 < m_indices.size(); t += 3) {
+            for (int e = 0; e < 3; ++e) {
+                const uint32_t a = m_indices[t + e], b = m_indices[t + (e + 1) % 3];
+                Quadric q = m_quadrics[a];
+                q += m_quadrics[b];
+                if (!m_locked[a]) candidates.push_back({q.eval(m_pos[b]), a, b});
+                if (!m_locked[b]) candidates.push_back({q.eval(m_pos[a]), b, a});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse &x, const Collapse &y) {
+            return x.cost < y.cost;
+        });
+
+        // each collapse removes about two triangles
+        const uint32_t wanted = (triangleCount() - target) / 2 + 1;
+        std::vector<char> touched(m_pos.size(), 0);
+        std::vector<uint32_t> moved;
+        for (const Collapse &c : candidates) {
+            if (moved.size() >= wanted) break;
+            if (touched[c.from] || touched[c.to]) continue;
+            if (!keepsOrientation(c.from, c.to)) continue;
+
+            // the whole one-ring of `from` is frozen for this pass so the
+            // orientation test above stays valid
+            for (uint32_t k = m_adjStart[c.from]; k < m_adjStart[c.from + 1]; ++k) {
+                const uint32_t *tri = &m_indices[size_t(m_adj[k]) * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+            }
+            m_remap[c.from] = c.to;
+            m_quadrics[c.to] += m_quadrics[c.from];
+            m_maxCost = std::max(m_maxCost, c.cost);
+            moved.push_back(c.from);
+        }
+        if (moved.empty()) return 0;
+
+        // apply and drop the triangles that became degenerate
+        size_t out = 0;
+        for (size_t t = 0; t + 2 < m_indices.size(); t += 3) {
+            const uint32_t a = m_remap[m_indices[t]];
+            const uint32_t b = m_remap[m_indices[t + 1]];
+            const uint32_t c = m_remap[m_indices[t + 2]];
+            if (a == b || b == c || a == c) continue;
+            m_indices[out++] = a;
+            m_indices[out++] = b;
+            m_indices[out++] = c;
+        }
+        m_indices.resize(out);
+        for (uint32_t v : moved) m_remap[v] = v;
+
+        return uint32_t(moved.size());
+    }
+
+    std::vector<glm::dvec3> m_pos;
+    std::vector<uint32_t>   m_indices;
+    std::vector<Quadric>    m_quadrics;
+    std::vector<char>       m_locked;
+    std::vector<uint32_t>   m_remap;
+    std::vector<uint32_t>   m_adjStart, m_adj;
+    double                  m_maxCost = 0.0;
+};
+
+} // namespace
+
+std::vector<MeshSimplifier::LodLevel> MeshSimplifier::buildLodChain(const IndexedMesh &mesh,
+                                                                    const std::vector<float> &ratios) {
+    std::vector<LodLevel> chain;
+    if (mesh.indices.empty()) return chain;
+
+    Simplifier simplifier(mesh);
+    const uint32_t triangles = mesh.triangleCount();
+
+    for (float ratio : ratios) {
+        const uint32_t target = uint32_t(std::lround(double(triangles) * ratio));
+        simplifier.reduceTo(target);
+
+        // not worth a level if it's barely smaller than the previous one
+        const size_t count = simplifier.indices().size();
+        if (!chain.empty() && count * 10 > chain.back().indices.size() * 9) break;
+
+        LodLevel level;
+        level.indices = simplifier.indices();
+        level.error   = simplifier.error();
+        if (!chain.empty()) {
+            MeshOptimizer::optimizeVertexCache(level.indices, mesh.vertexCount());
+        }
+        chain.push_back(std::move(level));
+    }
+    return chain;
+}
+
+MeshSimplifier::LodLevel MeshSimplifier::simplify(const IndexedMesh &mesh, float ratio) {
+    Simplifier simplifier(mesh);
+    simplifier.reduceTo(uint32_t(std::lround(double(mesh.triangleCount()) * ratio)));
+
+    LodLevel level;
+    level.indices = simplifier.indices();
+    level.error   = simplifier.error();
+    return level;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "meshoptimizer.h"
+
+// Quadric error metric (Garland-Heckbert) simplification by edge collapse.
+//
+// Collapses move a vertex onto one of its neighbours instead of to the
+// quadric's optimum, so every level of detail indexes the same vertex
+// buffer and a LOD chain is just a set of index ranges. Vertices on open
+// borders and on normal seams (same position, different normal - cube
+// edges, cylinder caps) are locked, which keeps silhouettes and hard edges
+// in place; everything else is collapsed cheapest-first in passes of
+// independent edges, rejecting collapses that would flip a triangle.
+class MeshSimplifier {
+public:
+    struct LodLevel {
+        std::vector<uint32_t> indices;
+        float                 error = 0.f;   // object-space distance, approx.
+    };
+
+    // ratios: triangle fractions in decreasing order, e.g. {1, .5, .25, .125}.
+    // Stops early once a level would barely be smaller than the one before;
+    // every level after the first is re-ordered for the vertex cache.
+    static std::vector<LodLevel> buildLodChain(const IndexedMesh &mesh, const std::vector<float> &ratios);
+
+    static LodLevel simplify(const IndexedMesh &mesh, float ratio);
+};
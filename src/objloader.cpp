@@ -0,0 +1,371 @@
+#include "objloader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "mappedfile.h"
+
+namespace {
+
+// ---------- number parsing ----------
+
+inline const char *skipSpace(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p;
+}
+
+inline const char *skipLine(const char *p, const char *end) {
+    while (p < end && *p != '\n') ++p;
+    return (p < end) ? p + 1 : end;
+}
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// [+-]digits[.digits][(e|E)[+-]digits]; exact for the short decimals OBJ
+// exporters write, within an ulp or so otherwise.
+bool parseFloat(const char *&p, const char *end, float &out) {
+    static const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char *s = skipSpace(p, end);
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) negative = (*s++ == '-');
+
+    uint64_t mantissa = 0;
+    int      exponent = 0;
+    int      digits   = 0;
+    for (; s < end && isDigit(*s); ++s, ++digits) {
+        if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + uint64_t(*s - '0');
+        else                                  exponent++;   // beyond double precision anyway
+    }
+    if (s < end && *s == '.') {
+        for (++s; s < end && isDigit(*s); ++s, ++digits) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + uint64_t(*s - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits == 0) return false;
+
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char *e = s + 1;
+        bool expNegative = false;
+        if (e < end && (*e == '-' || *e == '+')) expNegative = (*e++ == '-');
+        if (e < end && isDigit(*e)) {
+            int value = 0;
+            for (; e < end && isDigit(*e); ++e) value = std::min(value * 10 + (*e - '0'), 1000);
+            exponent += expNegative ? -value : value;
+            s = e;
+        }
+    }
+
+    double v = double(mantissa);
+    if (exponent != 0) {
+        const int a = std::abs(exponent);
+        const double scale = (a <= 22) ? kPow10[a] : std::pow(10.0, a);
+        v = (exponent < 0) ? v / scale : v * scale;
+    }
+    out = float(negative ? -v : v);
+    p = s;
+    return true;
+}
+
+bool parseInt(const char *&p, const char *end, int &out) {
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) negative = (*s++ == '-');
+    if (s >= end || !isDigit(*s)) return false;
+
+    int64_t value = 0;
+    for (; s < end && isDigit(*s); ++s) {
+        value = std::min<int64_t>(value * 10 + (*s - '0'), INT32_MAX);
+    }
+    out = int(negative ? -value : value);
+    p = s;
+    return true;
+}
+
+// ---------- slice parsing ----------
+
+constexpr int32_t kNoNormal = -1;
+
+struct Corner {
+    int32_t v = 0;            // position index
+    int32_t n = kNoNormal;    // normal index
+};
+
+// What one thread found in its part of the file. Absolute OBJ indices are
+// already global; relative ones (negative) are resolved against this slice's
+// counts and listed in relPositions / relNormals so the slice's global base
+// can be added once all slices are counted.
+struct Slice {
+    const char *begin = nullptr;
+    const char *end   = nullptr;
+
+    std::vector<float>    positions;
+    std::vector<float>    normals;
+    std::vector<Corner>   corners;        // 3 per triangle
+    std::vector<uint32_t> relPositions;   // corner indices to rebase
+    std::vector<uint32_t> relNormals;
+
+    const char *errorAt = nullptr;        // first malformed line
+};
+
+void parseSlice(Slice &slice) {
+    struct PolyCorner {
+        Corner c;
+        bool   relV = false;
+        bool   relN = false;
+    };
+    std::vector<PolyCorner> poly;
+
+    const char *p   = slice.begin;
+    const char *end = slice.end;
+
+    auto fail = [&](const char *line) {
+        if (!slice.errorAt) slice.errorAt = line;
+    };
+
+    while (p < end) {
+        const char *line = p;
+        p = skipSpace(p, end);
+        if (p + 1 >= end) break;
+
+        // tokens stop at the line end or an inline '#' comment
+        const char *eol = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+        if (!eol) eol = end;
+        const char *hash = static_cast<const char *>(std::memchr(p, '#', size_t(eol - p)));
+        const char *stop = hash ? hash : eol;
+
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 1;
+            float x, y, z;
+            if (parseFloat(p, stop, x) && parseFloat(p, stop, y) && parseFloat(p, stop, z)) {
+                slice.positions.insert(slice.positions.end(), {x, y, z});
+            } else {
+                fail(line);
+            }
+        } else if (p[0] == 'v' && p[1] == 'n') {
+            p += 2;
+            float x, y, z;
+            if (parseFloat(p, stop, x) && parseFloat(p, stop, y) && parseFloat(p, stop, z)) {
+                slice.normals.insert(slice.normals.end(), {x, y, z});
+            } else {
+                fail(line);
+            }
+        } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 1;
+            poly.clear();
+
+            const int32_t posCount    = int32_t(slice.positions.size() / 3);
+            const int32_t normalCount = int32_t(slice.normals.size() / 3);
+            bool ok = true;
+
+            // v, v/vt, v//vn, v/vt/vn
+            for (p = skipSpace(p, stop); p < stop; p = skipSpace(p, stop)) {
+                PolyCorner pc;
+                int v, n;
+                if (!parseInt(p, stop, v) || v == 0) { ok = false; break; }
+                pc.relV  = v < 0;
+                pc.c.v   = (v > 0) ? v - 1 : posCount + v;
+
+                if (p < stop && *p == '/') {
+                    ++p;
+                    int vt;
+                    parseInt(p, stop, vt);   // texture coordinates aren't used
+                    if (p < stop && *p == '/') {
+                        ++p;
+                        if (!parseInt(p, stop, n) || n == 0) { ok = false; break; }
+                        pc.relN = n < 0;
+                        pc.c.n  = (n > 0) ? n - 1 : normalCount + n;
+                    }
+                }
+                if (p < stop && *p != ' ' && *p != '\t' && *p != '\r') { ok = false; break; }
+                poly.push_back(pc);
+            }
+
+            if (!ok || poly.size() < 3) {
+                fail(line);
+            } else {
+                // fan
+                for (size_t i = 1; i + 1 < poly.size(); ++i) {
+                    for (size_t k : {size_t(0), i, i + 1}) {
+                        if (poly[k].relV) slice.relPositions.push_back(uint32_t(slice.corners.size()));
+                        if (poly[k].relN) slice.relNormals.push_back(uint32_t(slice.corners.size()));
+                        slice.corners.push_back(poly[k].c);
+                    }
+                }
+            }
+        }
+        // comments, vt, o/g/s, usemtl, ... are skipped
+        p = skipLine(p, end);
+    }
+}
+
+// Area-weighted vertex normals over the triangles that reference each
+// position.
+std::vector<glm::vec3> smoothNormals(const std::vector<float> &positions, const std::vector<Slice> &slices) {
+    auto pos = [&](int32_t i) {
+        return glm::vec3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+    };
+
+    std::vector<glm::vec3> normals(positions.size() / 3, glm::vec3(0.f));
+    for (const Slice &s : slices) {
+        for (size_t i = 0; i + 2 < s.corners.size(); i += 3) {
+            const int32_t a = s.corners[i].v, b = s.corners[i + 1].v, c = s.corners[i + 2].v;
+            const glm::vec3 n = glm::cross(pos(b) - pos(a), pos(c) - pos(a));
+            normals[a] += n;
+            normals[b] += n;
+            normals[c] += n;
+        }
+    }
+    for (glm::vec3 &n : normals) {
+        const float len = glm::length(n);
+        n = (len > 0.f) ? n / len : glm::vec3(0.f, 1.f, 0.f);
+    }
+    return normals;
+}
+
+std::shared_ptr<IndexedMesh> parseObj(const std::string &path) {
+    MappedFile file(path);
+    if (!file.valid()) {
+        std::cerr << "[ObjLoader] could not open " << path << std::endl;
+        return nullptr;
+    }
+
+    // one slice per core (and per ~1 MB), cut at line ends
+    const char *data = file.data();
+    const size_t size = file.size();
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(),
+                                                                 size / (1 << 20) + 1));
+    std::vector<Slice> slices(threads);
+    const char *cursor = data;
+    for (size_t t = 0; t < threads; ++t) {
+        const char *cut = (t + 1 == threads) ? data + size : data + size * (t + 1) / threads;
+        if (cut < cursor) cut = cursor;
+        while (cut < data + size && cut[-1] != '\n') ++cut;
+        slices[t].begin = cursor;
+        slices[t].end   = cut;
+        cursor = cut;
+    }
+
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(parseSlice, std::ref(slices[t]));
+    }
+    parseSlice(slices[0]);
+    for (std::thread &t : pool) {
+        t.join();
+    }
+
+    for (const Slice &s : slices) {
+        if (s.errorAt) {
+            const size_t lineNumber = 1 + std::count(data, s.errorAt, '\n');
+            std::cerr << "[ObjLoader] " << path << ":" << lineNumber << ": malformed line" << std::endl;
+            return nullptr;
+        }
+    }
+
+    // global positions / normals, rebasing relative indices
+    std::vector<float> positions, normals;
+    size_t cornerCount = 0;
+    for (const Slice &s : slices) {
+        cornerCount += s.corners.size();
+    }
+    for (Slice &s : slices) {
+        const int32_t posBase    = int32_t(positions.size() / 3);
+        const int32_t normalBase = int32_t(normals.size() / 3);
+        for (uint32_t i : s.relPositions) s.corners[i].v += posBase;
+        for (uint32_t i : s.relNormals)   s.corners[i].n += normalBase;
+        positions.insert(positions.end(), s.positions.begin(), s.positions.end());
+        normals.insert(normals.end(), s.normals.begin(), s.normals.end());
+        std::vector<float>().swap(s.positions);
+        std::vector<float>().swap(s.normals);
+    }
+
+    const int32_t posCount    = int32_t(positions.size() / 3);
+    const int32_t normalCount = int32_t(normals.size() / 3);
+    bool needSmooth = false;
+    for (const Slice &s : slices) {
+        for (const Corner &c : s.corners) {
+            if (c.v < 0 || c.v >= posCount || c.n < kNoNormal || c.n >= normalCount) {
+                std::cerr << "[ObjLoader] " << path << ": face index out of range" << std::endl;
+                return nullptr;
+            }
+            needSmooth |= (c.n == kNoNormal);
+        }
+    }
+    std::vector<glm::vec3> smooth;
+    if (needSmooth) smooth = smoothNormals(positions, slices);
+
+    // merge corners on (position, normal)
+    auto mesh = std::make_shared<IndexedMesh>();
+    mesh->floatsPerVertex = 6;
+    mesh->indices.reserve(cornerCount);
+    mesh->vertices.reserve(std::min(cornerCount, size_t(posCount) * 2) * 6);
+
+    std::unordered_map<uint64_t, uint32_t> vertexOf;
+    vertexOf.reserve(std::min(cornerCount, size_t(posCount) * 2));
+    for (const Slice &s : slices) {
+        for (const Corner &c : s.corners) {
+            const uint64_t key = (uint64_t(uint32_t(c.v)) << 32) | uint32_t(c.n);
+            auto [it, inserted] = vertexOf.try_emplace(key, mesh->vertexCount());
+            if (inserted) {
+                const float *p = &positions[3 * size_t(c.v)];
+                const glm::vec3 n = (c.n == kNoNormal)
+                                        ? smooth[c.v]
+                                        : glm::vec3(normals[3 * c.n], normals[3 * c.n + 1], normals[3 * c.n + 2]);
+                mesh->vertices.insert(mesh->vertices.end(), {p[0], p[1], p[2], n.x, n.y, n.z});
+            }
+            mesh->indices.push_back(it->second);
+        }
+    }
+    return mesh;
+}
+
+std::mutex &cacheMutex() {
+    static std::mutex m;
+    return m;
+}
+
+std::unordered_map<std::string, std::shared_ptr<const IndexedMesh>> &cache() {
+    static std::unordered_map<std::string, std::shared_ptr<const IndexedMesh>> c;
+    return c;
+}
+
+} // namespace
+
+std::shared_ptr<const IndexedMesh> ObjLoader::load(const std::string &path, MeshOptimizeReport *report) {
+    std::error_code ec;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, ec);
+    const std::string key = ec ? path : canonical.string();
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex());
+        auto it = cache().find(key);
+        if (it != cache().end()) return it->second;
+    }
+
+    std::shared_ptr<IndexedMesh> mesh = parseObj(key);
+    if (!mesh) return nullptr;
+
+    MeshOptimizer::optimize(*mesh, report);
+
+    std::lock_guard<std::mutex> lock(cacheMutex());
+    return cache().emplace(key, std::move(mesh)).first->second;
+}
+
+void ObjLoader::clearCache() {
+    std::lock_guard<std::mutex> lock(cacheMutex());
+    cache().clear();
+}
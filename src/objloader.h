@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "meshoptimizer.h"
+
+// Loads Wavefront OBJ files into indexed [pos.xyz, n.xyz] meshes.
+//
+//   - the file is memory-mapped and split at line boundaries into one slice
+//     per core; slices are parsed in parallel with a hand-written number
+//     parser (no streams, no strtod, no per-line allocation)
+//   - only v / vn / f are read; polygons are fan-triangulated, negative
+//     (relative) indices are supported
+//   - corners are merged on their (position, normal) index pair, so shared
+//     vertices are stored once; files without normals get smooth,
+//     area-weighted ones
+//   - the mesh goes through MeshOptimizer once, and the result is cached by
+//     canonical path, so a mesh referenced by many primitives (or reloaded
+//     with the scene) is parsed and optimized once
+class ObjLoader {
+public:
+    // nullptr (and a message on std::cerr) if the file can't be read.
+    // `report` is filled only when this call parsed and optimized the file
+    // (not on a cache hit).
+    static std::shared_ptr<const IndexedMesh> load(const std::string &path,
+                                                   MeshOptimizeReport *report = nullptr);
+
+    static void clearCache();
+};
@@ -0,0 +1,439 @@
+#include "parametriclsystem.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <locale>
+#include <sstream>
+
+#include <glm/gtc/constants.hpp>
+
+namespace {
+
+// Small deterministic generator (splitmix64) for rule selection
+struct SplitMix {
+    uint64_t state;
+
+    explicit SplitMix(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    float nextFloat() { return float(next() >> 40) * (1.f / 16777216.f); } // [0,1)
+};
+
+// Recursive-descent reader over one grammar string
+struct Reader {
+    const std::string &src;
+    size_t pos = 0;
+
+    explicit Reader(const std::string &s) : src(s) {}
+
+    void skipSpace() {
+        while (pos < src.size() && std::isspace(static_cast<unsigned char>(src[pos]))) ++pos;
+    }
+    bool atEnd() {
+        skipSpace();
+        return pos >= src.size();
+    }
+    char peek() {
+        skipSpace();
+        return pos < src.size() ? src[pos] : '\0';
+    }
+    bool accept(char c) {
+        if (peek() == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+    // Independent of LC_NUMERIC: Qt applies the environment's locale, and
+    // strtof would read "1.5" as 1 under a comma-decimal one.
+    bool readNumber(float &out) {
+        skipSpace();
+#if defined(__cpp_lib_to_chars)
+        const char *begin = src.data() + pos;
+        const auto result = std::from_chars(begin, src.data() + src.size(), out);
+        if (result.ec != std::errc()) return false;
+        pos += static_cast<size_t>(result.ptr - begin);
+#else
+        // no floating-point from_chars (older Apple libc++)
+        std::istringstream in(src.substr(pos));
+        in.imbue(std::locale::classic());
+        if (!(in >> out)) return false;
+        in.clear();
+        const std::streamoff used = in.tellg();
+        pos = used < 0 ? src.size() : pos + static_cast<size_t>(used);
+#endif
+        return true;
+    }
+    std::string readIdent() {
+        skipSpace();
+        size_t start = pos;
+        while (pos < src.size() &&
+               (std::isalnum(static_cast<unsigned char>(src[pos])) || src[pos] == '_')) {
+            ++pos;
+        }
+        return src.substr(start, pos - start);
+    }
+};
+
+// Rotates v around a unit axis (Rodrigues)
+inline glm::vec3 rotate(const glm::vec3 &v, const glm::vec3 &axis, float c, float s) {
+    return v * c + glm::cross(axis, v) * s + axis * glm::dot(axis, v) * (1.f - c);
+}
+
+} // namespace
+
+// ---------- compilation ----------
+
+bool ParametricLSystem::compile(const std::string &axiom, const std::vector<std::string> &rules) {
+    m_code.clear();
+    m_rules.clear();
+    m_ruleFirst.fill(0);
+    m_ruleCount.fill(0);
+    m_weightSum.fill(0.f);
+    m_axiom.clear();
+
+    struct Parsed {
+        uint8_t  symbol;
+        Rule     rule;
+    };
+    std::vector<Parsed> parsed;
+
+    for (const std::string &text : rules) {
+        size_t arrow = text.find("->");
+        if (arrow == std::string::npos) {
+            std::cerr << "[ParametricLSystem] rule is missing \"->\": " << text << std::endl;
+            return false;
+        }
+
+        // predecessor: symbol, optional (formals), optional ": weight"
+        std::string head = text.substr(0, arrow);
+        Reader r(head);
+        if (r.atEnd()) {
+            std::cerr << "[ParametricLSystem] rule has no predecessor: " << text << std::endl;
+            return false;
+        }
+        uint8_t symbol = static_cast<uint8_t>(r.src[r.pos++]);
+
+        std::vector<std::string> formals;
+        if (r.accept('(')) {
+            do {
+                std::string name = r.readIdent();
+                if (name.empty()) {
+                    std::cerr << "[ParametricLSystem] bad parameter list: " << text << std::endl;
+                    return false;
+                }
+                formals.push_back(name);
+            } while (r.accept(','));
+            if (!r.accept(')') || formals.size() > kMaxParams) {
+                std::cerr << "[ParametricLSystem] bad parameter list: " << text << std::endl;
+                return false;
+            }
+        }
+
+        float weight = 1.f;
+        if (r.accept(':') && !r.readNumber(weight)) {
+            std::cerr << "[ParametricLSystem] bad rule weight: " << text << std::endl;
+            return false;
+        }
+        if (!r.atEnd() || weight <= 0.f) {
+            std::cerr << "[ParametricLSystem] bad rule predecessor: " << text << std::endl;
+            return false;
+        }
+
+        Rule rule;
+        rule.paramCount = static_cast<uint8_t>(formals.size());
+        rule.weight     = weight;
+        rule.codeBegin  = static_cast<uint32_t>(m_code.size());
+        if (!compileSuccessor(text.substr(arrow + 2), formals)) {
+            std::cerr << "[ParametricLSystem] could not compile rule: " << text << std::endl;
+            return false;
+        }
+        rule.codeEnd = static_cast<uint32_t>(m_code.size());
+        parsed.push_back({symbol, rule});
+    }
+
+    // group rules by predecessor for O(1) lookup in derive()
+    std::stable_sort(parsed.begin(), parsed.end(),
+                     [](const Parsed &a, const Parsed &b) { return a.symbol < b.symbol; });
+    for (const Parsed &p : parsed) {
+        if (m_ruleCount[p.symbol] == 0) {
+            m_ruleFirst[p.symbol] = static_cast<uint32_t>(m_rules.size());
+        }
+        m_ruleCount[p.symbol]++;
+        m_weightSum[p.symbol] += p.rule.weight;
+        m_rules.push_back(p.rule);
+    }
+
+    // the axiom is a successor without formals; run it once
+    uint32_t begin = static_cast<uint32_t>(m_code.size());
+    if (!compileSuccessor(axiom, {})) {
+        std::cerr << "[ParametricLSystem] could not compile axiom: " << axiom << std::endl;
+        return false;
+    }
+    run(begin, static_cast<uint32_t>(m_code.size()), nullptr, m_axiom);
+    m_code.resize(begin);
+
+    return true;
+}
+
+bool ParametricLSystem::compileSuccessor(const std::string &src,
+                                         const std::vector<std::string> &formals) {
+    Reader r(src);
+    int depth = 0; // stack depth while compiling an argument list
+
+    auto emit = [&](Op op, uint8_t a = 0, uint8_t b = 0, float v = 0.f) {
+        m_code.push_back({op, a, b, v});
+    };
+
+    // expr := term {(+|-) term}, term := unary {(*|/) unary},
+    // unary := -unary | primary, primary := number | formal | (expr)
+    std::function<bool()> expr, term, unary, primary;
+
+    primary = [&]() -> bool {
+        if (r.accept('(')) {
+            return expr() && r.accept(')');
+        }
+        char c = r.peek();
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            std::string name = r.readIdent();
+            auto it = std::find(formals.begin(), formals.end(), name);
+            if (it == formals.end()) return false;
+            emit(OP_PARAM, static_cast<uint8_t>(it - formals.begin()));
+        } else {
+            float v;
+            if (!r.readNumber(v)) return false;
+            emit(OP_CONST, 0, 0, v);
+        }
+        return ++depth <= kMaxStack;
+    };
+    unary = [&]() -> bool {
+        if (r.accept('-')) {
+            if (!unary()) return false;
+            emit(OP_NEG);
+            return true;
+        }
+        return primary();
+    };
+    term = [&]() -> bool {
+        if (!unary()) return false;
+        for (;;) {
+            Op op;
+            if (r.accept('*'))      op = OP_MUL;
+            else if (r.accept('/')) op = OP_DIV;
+            else return true;
+            if (!unary()) return false;
+            emit(op);
+            --depth;
+        }
+    };
+    expr = [&]() -> bool {
+        if (!term()) return false;
+        for (;;) {
+            Op op;
+            if (r.accept('+'))      op = OP_ADD;
+            else if (r.accept('-')) op = OP_SUB;
+            else return true;
+            if (!term()) return false;
+            emit(op);
+            --depth;
+        }
+    };
+
+    while (!r.atEnd()) {
+        char c = r.src[r.pos++];
+        if (c == '(' || c == ')' || c == ',') return false;
+
+        int argc = 0;
+        if (r.accept('(')) {
+            do {
+                if (!expr()) return false;
+                ++argc;
+            } while (r.accept(','));
+            if (!r.accept(')') || argc > kMaxParams) return false;
+        }
+        emit(OP_EMIT, static_cast<uint8_t>(c), static_cast<uint8_t>(argc));
+        depth -= argc;
+    }
+    return true;
+}
+
+// ---------- derivation ----------
+
+// Executes bytecode [begin, end) with the given actual parameters
+void ParametricLSystem::run(uint32_t begin, uint32_t end,
+                            const float *args, ModuleString &out) const {
+    float stack[kMaxStack];
+    int   sp = 0;
+
+    for (uint32_t pc = begin; pc < end; ++pc) {
+        const Instr &in = m_code[pc];
+        switch (in.op) {
+        case OP_CONST: stack[sp++] = in.value;     break;
+        case OP_PARAM: stack[sp++] = args[in.a];   break;
+        case OP_ADD:   --sp; stack[sp - 1] += stack[sp]; break;
+        case OP_SUB:   --sp; stack[sp - 1] -= stack[sp]; break;
+        case OP_MUL:   --sp; stack[sp - 1] *= stack[sp]; break;
+        case OP_DIV:   --sp; stack[sp - 1] = (stack[sp] != 0.f) ? stack[sp - 1] / stack[sp] : 0.f; break;
+        case OP_NEG:   stack[sp - 1] = -stack[sp - 1]; break;
+        case OP_EMIT:
+            out.symbols.push_back(in.a);
+            out.paramCounts.push_back(in.b);
+            sp -= in.b;
+            out.params.insert(out.params.end(), stack + sp, stack + sp + in.b);
+            break;
+        }
+    }
+}
+
+void ParametricLSystem::derive(int iterations, uint32_t seed, ModuleString &out) const {
+    SplitMix rng(0x5eedull * 0x100000001b3ull ^ seed);
+
+    ModuleString current = m_axiom;
+    ModuleString next;
+
+    for (int it = 0; it < iterations; ++it) {
+        next.clear();
+        next.symbols.reserve(current.size() * 2);
+        next.paramCounts.reserve(current.size() * 2);
+        next.params.reserve(current.params.size() * 2);
+
+        const float *args = current.params.data();
+        for (size_t i = 0; i < current.size() && next.size() <= kMaxModules; ++i) {
+            uint8_t sym   = current.symbols[i];
+            uint8_t argc  = current.paramCounts[i];
+            uint32_t count = m_ruleCount[sym];
+
+            // pick a rule whose arity matches; no rule -> copy module as-is
+            const Rule *chosen = nullptr;
+            if (count == 1) {
+                chosen = &m_rules[m_ruleFirst[sym]];
+            } else if (count > 1) {
+                float pick = rng.nextFloat() * m_weightSum[sym];
+                for (uint32_t k = 0; k < count; ++k) {
+                    chosen = &m_rules[m_ruleFirst[sym] + k];
+                    pick -= chosen->weight;
+                    if (pick < 0.f) break;
+                }
+            }
+
+            if (chosen && chosen->paramCount == argc) {
+                run(chosen->codeBegin, chosen->codeEnd, args, next);
+            } else {
+                next.symbols.push_back(sym);
+                next.paramCounts.push_back(argc);
+                next.params.insert(next.params.end(), args, args + argc);
+            }
+            args += argc;
+        }
+        if (next.size() > kMaxModules) {
+            std::cerr << "[ParametricLSystem] over " << kMaxModules << " modules, stopped after "
+                      << it << " of " << iterations << " iterations" << std::endl;
+            break;
+        }
+        std::swap(current, next);
+    }
+
+    out = std::move(current);
+}
+
+// ---------- 3D turtle ----------
+
+void ParametricLSystem::interpret(const ModuleString &modules,
+                                  const TurtleSettings &settings,
+                                  std::vector<Segment> &out) const {
+    struct Turtle {
+        glm::vec3 pos;
+        glm::vec3 H; // heading
+        glm::vec3 L; // left
+        glm::vec3 U; // up
+        float     width;
+    };
+
+    Turtle t;
+    t.pos   = glm::vec3(0.f);
+    t.H     = glm::vec3(0.f, 1.f, 0.f);  // grow upward
+    t.L     = glm::vec3(-1.f, 0.f, 0.f);
+    t.U     = glm::vec3(0.f, 0.f, 1.f);  // H x L = U
+    t.width = settings.width;
+
+    std::vector<Turtle> stack;
+    const float degToRad = glm::pi<float>() / 180.f;
+
+    // F(l,0), !(0), F(0) are valid grammar but give a flat segment whose
+    // normals divide by zero; those move the turtle without drawing
+    auto drawable = [](float extent) {
+        return std::isfinite(extent) && std::abs(extent) > 1e-5f;
+    };
+
+    const float *args = modules.params.data();
+    for (size_t i = 0; i < modules.size(); ++i) {
+        uint8_t sym  = modules.symbols[i];
+        uint8_t argc = modules.paramCounts[i];
+        float   a0   = argc > 0 ? args[0] : 0.f;
+
+        auto turn = [&](float sign, glm::vec3 &axis, glm::vec3 &v0, glm::vec3 &v1) {
+            float ang = sign * (argc > 0 ? a0 : settings.angleDeg) * degToRad;
+            float c = std::cos(ang), s = std::sin(ang);
+            v0 = glm::normalize(rotate(v0, axis, c, s));
+            v1 = glm::normalize(rotate(v1, axis, c, s));
+        };
+
+        switch (sym) {
+        case 'F': {
+            float len = argc > 0 ? a0 : settings.stepLength;
+            if (argc > 1) t.width = args[1];
+            if (drawable(len) && drawable(t.width)) {
+                out.push_back({t.pos, t.H, t.L, t.U, len, t.width, false});
+            }
+            t.pos += t.H * len;
+            break;
+        }
+        case 'f':
+            t.pos += t.H * (argc > 0 ? a0 : settings.stepLength);
+            break;
+        case 'L': {
+            float size = argc > 0 ? a0 : settings.leafSize;
+            if (drawable(size)) {
+                out.push_back({t.pos - 0.5f * size * t.H, t.H, t.L, t.U, size, size, true});
+            }
+            break;
+        }
+        case '+':  turn( 1.f, t.U, t.H, t.L); break;
+        case '-':  turn(-1.f, t.U, t.H, t.L); break;
+        case '&':  turn( 1.f, t.L, t.H, t.U); break;
+        case '^':  turn(-1.f, t.L, t.H, t.U); break;
+        case '\\': turn( 1.f, t.H, t.L, t.U); break;
+        case '/':  turn(-1.f, t.H, t.L, t.U); break;
+        case '|':
+            t.H = -t.H;
+            t.L = -t.L;
+            break;
+        case '!':
+            t.width = argc > 0 ? a0 : t.width * settings.widthDecay;
+            break;
+        case '[':
+            stack.push_back(t);
+            break;
+        case ']':
+            if (!stack.empty()) {
+                t = stack.back();
+                stack.pop_back();
+            }
+            break;
+        default:
+            break;
+        }
+        args += argc;
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Stochastic, parametric, context-free L-system with a 3D turtle.
+//
+// Grammar (ABOP notation):
+//   axiom  "A(1.2,0.2)"
+//   rule   "A(l,w) : 0.6 -> F(l,w)[&(30)A(l*0.8,w*0.7)]/(137.5)A(l*0.9,w*0.8)"
+// The ": weight" part is optional (default 1). Rules sharing a predecessor are
+// picked at random, proportionally to their weight, from a seeded generator,
+// so the same seed always derives the same tree. Parameter expressions support
+// numbers, the rule's formal parameters, + - * / and parentheses.
+//
+// compile() turns every successor into a small stack bytecode once; derive()
+// then runs a tight interpreter over flat module arrays, so no strings are
+// built or parsed while deriving.
+//
+// Turtle symbols (angles in degrees, missing arguments use TurtleSettings):
+//   F(l,w) draw forward (w optionally sets width)    f(l) move forward
+//   +(a) -(a) yaw     &(a) ^(a) pitch     \(a) /(a) roll     | turn around
+//   !(w)  set width, or multiply by widthDecay without argument
+//   L(s)  leaf blob of size s                        [ ] push / pop state
+class ParametricLSystem {
+public:
+    // Flat module stream: symbol i owns paramCounts[i] consecutive params
+    struct ModuleString {
+        std::vector<uint8_t> symbols;
+        std::vector<uint8_t> paramCounts;
+        std::vector<float>   params;
+
+        void clear() {
+            symbols.clear();
+            paramCounts.clear();
+            params.clear();
+        }
+        size_t size() const { return symbols.size(); }
+    };
+
+    struct TurtleSettings {
+        float stepLength = 1.f;   // F / f without argument
+        float angleDeg   = 25.f;  // turns without argument
+        float width      = 0.2f;  // initial width
+        float widthDecay = 0.7f;  // '!' without argument
+        float leafSize   = 0.5f;  // L without argument
+    };
+
+    // One drawn element. The local frame is (left, heading, up); the segment
+    // spans `length` along heading starting at `start`, `width` across.
+    struct Segment {
+        glm::vec3 start;
+        glm::vec3 heading;
+        glm::vec3 left;
+        glm::vec3 up;
+        float     length;
+        float     width;
+        bool      leaf;
+    };
+
+    // Returns false (and prints why) if the grammar does not parse.
+    bool compile(const std::string &axiom, const std::vector<std::string> &rules);
+
+    void derive(int iterations, uint32_t seed, ModuleString &out) const;
+
+    void interpret(const ModuleString &modules,
+                   const TurtleSettings &settings,
+                   std::vector<Segment> &out) const;
+
+private:
+    enum Op : uint8_t {
+        OP_CONST,   // push value
+        OP_PARAM,   // push formal parameter a
+        OP_ADD,
+        OP_SUB,
+        OP_MUL,
+        OP_DIV,
+        OP_NEG,
+        OP_EMIT     // append module a with b params popped from the stack
+    };
+
+    struct Instr {
+        Op      op;
+        uint8_t a;
+        uint8_t b;
+        float   value;
+    };
+
+    struct Rule {
+        uint8_t  paramCount;
+        float    weight;
+        uint32_t codeBegin;
+        uint32_t codeEnd;
+    };
+
+    static constexpr int kMaxStack  = 32;
+    static constexpr int kMaxParams = 8;
+
+    // derive() keeps the last string under this many modules and stops there
+    // (F -> FF doubles every iteration)
+    static constexpr size_t kMaxModules = size_t(1) << 22;
+
+    bool compileSuccessor(const std::string &src,
+                          const std::vector<std::string> &formals);
+    void run(uint32_t begin, uint32_t end, const float *args, ModuleString &out) const;
+
+    std::vector<Instr> m_code;
+    std::vector<Rule>  m_rules;       // sorted by predecessor
+
+    // rules for symbol c are m_rules[m_ruleFirst[c] .. + m_ruleCount[c])
+    std::array<uint32_t, 256> m_ruleFirst{};
+    std::array<uint32_t, 256> m_ruleCount{};
+    std::array<float,    256> m_weightSum{};
+
+    ModuleString m_axiom;
+};
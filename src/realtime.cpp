@@ -7,15 +7,50 @@
 #include "settings.h"
 #include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
 #include "cube.h"
+#include "treetemplates.h"
 #include <cmath>
 #include <cstdlib>   // for std::rand, RAND_MAX
+#include <limits>
 
 
 #include <string>
-#include <stack>
 #include <unordered_map>
 
+#include <QStandardPaths>
+
+#include "objloader.h"
+
+namespace {
+
+// Indexes a triangle soup and optimizes it for the vertex cache and
+// overdraw, adding the before/after cache stats to `totals`.
+IndexedMesh optimizedMesh(const std::vector<float> &posNormal, MeshOptimizeTotals &totals) {
+    MeshOptimizeReport report;
+    IndexedMesh mesh = MeshOptimizer::optimize(posNormal, 6, &report);
+    totals.add(report);
+    return mesh;
+}
+
+// (param1, param2) per adaptive level, coarse to fine. The cube is flat, so
+// more triangles would not change how it looks.
+std::vector<glm::ivec2> tessellationLevels(PrimitiveType type) {
+    switch (type) {
+    case PrimitiveType::PRIMITIVE_SPHERE:   return {{4, 6}, {8, 12}, {16, 24}, {32, 48}};
+    case PrimitiveType::PRIMITIVE_CONE:
+    case PrimitiveType::PRIMITIVE_CYLINDER: return {{1, 8}, {1, 16}, {2, 32}, {2, 64}};
+    default:                                return {{1, 1}};
+    }
+}
+
+// projected radius (pixels) a shape needs to move up to the next level
+constexpr float kTessPixelRadius[] = {24.f, 64.f, 160.f};
+constexpr float kTessMoveDistance  = 0.5f;     // world units
+constexpr float kTessTurnCos       = 0.996f;   // ~5 degrees
+
+} // namespace
+
 
 // ================== Rendering the Scene!
 
@@ -55,6 +90,9 @@ Realtime::Realtime(QWidget *parent)
     m_snakeStartY = 0.5f;
     m_snake.vel = glm::vec3(0.f);             // not moving until key press
 
+    // edits must re-bake every mesh whose shadows / sky they could touch
+    m_voxels.setEditReach(ChunkMesher::kLightReach);
+
 
 }
 
@@ -64,10 +102,19 @@ void Realtime::finish() {
 
     // Students: anything requiring OpenGL calls when the program exits should be done here
 
-    cleanupVAOs();
+    cleanupShapeMeshes();
     cleanupTerrain();
     cleanupCubeMesh();
+    cleanupTreeBuffers();
+    cleanupChunkMeshes();
+    cleanupShadowMaps();
+    m_posNormalMeshes.destroy();
+    m_packedMeshes.destroy();
+    m_chunkMeshes.destroy();
     if (m_shader) glDeleteProgram(m_shader);
+    if (m_shadowShader) glDeleteProgram(m_shadowShader);
+    m_gl.forgetProgram(m_shader);
+    m_gl.forgetProgram(m_shadowShader);
 
     this->doneCurrent();
 }
@@ -75,7 +122,7 @@ void Realtime::finish() {
 
 
 void Realtime::loadScene() {
-    cleanupVAOs();
+    cleanupShapeMeshes();
 
     std::string scenePath = settings.sceneFilePath;
     if (scenePath.empty()) {
@@ -113,49 +160,159 @@ void Realtime::loadScene() {
 
 
 
-    generateShapeVAOs();
+    generateShapeMeshes();
 
     std::cout << "[Realtime] Scene loaded: " << m_renderData.shapes.size()
-              << " shapes, " << m_renderData.lights.size() << " lights" << std::endl;
+              << " shapes, " << m_renderData.instances.size() << " template instances, "
+              << m_renderData.lights.size() << " lights" << std::endl;
 }
 
-void Realtime::generateShapeVAOs() {
-    m_shapeVAOs.clear();
+// The mesh a scenefile shape draws with. Adaptive primitives get their
+// type's tessellation levels and a null-pool ShapeMesh.
+Realtime::ShapeMesh Realtime::addPrimitiveMesh(const RenderShapeData &shape) {
+    if (shape.type == PrimitiveType::PRIMITIVE_MESH) {
+        const std::string &path = m_renderData.paths[shape.meshfile];
+        // hashed once per path; an unreadable file is reported once
+        auto known = m_meshFileKeys.find(path);
+        if (known == m_meshFileKeys.end()) {
+            known = m_meshFileKeys.emplace(path, MeshCache::fileKey(path)).first;
+            if (!known->second) std::cerr << "[Realtime] can't read mesh file " << path << std::endl;
+        }
+        const uint64_t key = known->second;
+        if (!key) return {&m_posNormalMeshes};
+        // arbitrary extents: keep full float positions
+        return addShapeMesh(key, VertexPacking::Float, [&]() {
+            MeshOptimizeReport report;
+            std::shared_ptr<const IndexedMesh> mesh = ObjLoader::load(path, &report);
+            m_meshOptimizeTotals.add(report);
+            return mesh ? *mesh : IndexedMesh();
+        });
+    }
+
+    const PrimitiveType type  = shape.type;
+    if (settings.adaptiveTessellation) {
+        buildTessellationLevels(type);
+        return ShapeMesh();
+    }
+
+    const uint64_t key = MeshCache::primitiveKey(type, settings.shapeParameter1, settings.shapeParameter2);
+    return addShapeMesh(key, VertexPacking::Packed, [&]() {
+        return optimizedMesh(generateShapeData(type, settings.shapeParameter1, settings.shapeParameter2),
+                             m_meshOptimizeTotals);
+    });
+}
+
+void Realtime::generateShapeMeshes() {
+    cleanupShapeMeshes();
 
     for (const RenderShapeData& shape : m_renderData.shapes) {
-        std::vector<float> vertexData = generateShapeData(
-            shape.primitive.type,
-            settings.shapeParameter1,
-            settings.shapeParameter2
-            );
+        m_shapeMeshes.push_back(addPrimitiveMesh(shape));
+    }
+    generatePrototypeDraws();
 
-        ShapeVAO shapeVAO;
-        glGenVertexArrays(1, &shapeVAO.vao);
-        glGenBuffers(1, &shapeVAO.vbo);
+    m_shapeTessLevel.assign(m_shapeMeshes.size(), 0);
+    m_tessDirty = true;
+}
 
-        glBindVertexArray(shapeVAO.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, shapeVAO.vbo);
+// Meshes for every prototype shape, and the instance CTMs sorted by
+// prototype into one buffer.
+void Realtime::generatePrototypeDraws() {
+    const std::vector<RenderPrototype> &prototypes = m_renderData.prototypes;
+    m_prototypeDraws.resize(prototypes.size());
 
-        glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float),
-                     vertexData.data(), GL_STATIC_DRAW);
+    for (const RenderInstanceData &inst : m_renderData.instances) {
+        m_prototypeDraws[inst.prototype].instanceCount++;
+    }
+    size_t at = 0;
+    for (PrototypeDraw &g : m_prototypeDraws) {
+        g.firstInstance = at;
+        at += size_t(g.instanceCount);
+    }
+    m_shapeInstances.resize(at);
+    std::vector<size_t> cursor(m_prototypeDraws.size());
+    for (size_t p = 0; p < m_prototypeDraws.size(); ++p) {
+        cursor[p] = m_prototypeDraws[p].firstInstance;
+    }
+    for (const RenderInstanceData &inst : m_renderData.instances) {
+        m_shapeInstances[cursor[inst.prototype]++] = inst.ctm;
+    }
 
-        // Position attribute
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    for (size_t p = 0; p < prototypes.size(); ++p) {
+        if (m_prototypeDraws[p].instanceCount == 0) continue;   // never used
+        for (const RenderShapeData &shape : prototypes[p].shapes) {
+            m_prototypeDraws[p].meshes.push_back(addPrimitiveMesh(shape));
+        }
+    }
+
+    if (m_shapeInstances.empty()) return;
+    glGenBuffers(1, &m_shapeInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_shapeInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, m_shapeInstances.size() * sizeof(glm::mat4), m_shapeInstances.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-        // Normal attribute
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float),
-                              (void*)(3 * sizeof(float)));
+void Realtime::buildTessellationLevels(PrimitiveType type) {
+    std::vector<ShapeMesh> &levels = m_tessLevels[int(type)];
+    if (!levels.empty()) return;
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+    for (const glm::ivec2 &p : tessellationLevels(type)) {
+        levels.push_back(addShapeMesh(MeshCache::primitiveKey(type, p.x, p.y), VertexPacking::Packed, [&]() {
+            return optimizedMesh(generateShapeData(type, p.x, p.y), m_meshOptimizeTotals);
+        }));
+    }
+}
 
-        shapeVAO.vertexCount = vertexData.size() / 6;
-        m_shapeVAOs.push_back(shapeVAO);
+// Picks each adaptive shape's tessellation from the radius its bounding
+// sphere projects to.
+void Realtime::updateShapeTessellation(const glm::mat4 &view) {
+    if (m_tessLevels.empty()) return;
+
+    const glm::vec3 camPos  = m_camera.getPosition();
+    const glm::vec3 camLook = glm::normalize(m_camera.getLook());
+    const float pixelScale  = 0.5f * float(size().height() * m_devicePixelRatio) * m_camera.getProjMatrix()[1][1];
+
+    const bool changed = m_tessDirty ||
+                         glm::distance(camPos, m_tessCamPos) > kTessMoveDistance ||
+                         glm::dot(camLook, m_tessCamLook) < kTessTurnCos ||
+                         std::abs(pixelScale - m_tessPixelScale) > 0.05f * m_tessPixelScale;
+    if (!changed) return;
+
+    m_tessCamPos     = camPos;
+    m_tessCamLook    = camLook;
+    m_tessPixelScale = pixelScale;
+    m_tessDirty      = false;
+
+    for (size_t i = 0; i < m_shapeMeshes.size() && i < m_renderData.shapes.size(); ++i) {
+        if (m_shapeMeshes[i].pool) continue;
+
+        const RenderShapeData &data = m_renderData.shapes[i];
+        auto it = m_tessLevels.find(int(data.type));
+        if (it == m_tessLevels.end() || it->second.empty()) continue;
+
+        const ShapeMesh &finest = it->second.back();
+        const float scale = std::max({glm::length(glm::vec3(data.ctm[0])),
+                                      glm::length(glm::vec3(data.ctm[1])),
+                                      glm::length(glm::vec3(data.ctm[2]))});
+        const glm::vec3 center = glm::vec3(view * data.ctm * glm::vec4(finest.center, 1.f));
+        const float distance = std::max(-center.z, m_camera.getNearPlane());
+        const float pixels   = finest.radius * scale * pixelScale / distance;
+
+        int level = 0;
+        while (level < int(std::size(kTessPixelRadius)) && pixels > kTessPixelRadius[level]) level++;
+        m_shapeTessLevel[i] = std::min(level, int(it->second.size()) - 1);
     }
 }
 
+// The mesh shape i draws with: its own, or its current adaptive level.
+const Realtime::ShapeMesh *Realtime::shapeMesh(size_t i) const {
+    if (m_shapeMeshes[i].pool) return &m_shapeMeshes[i];
+
+    auto it = m_tessLevels.find(int(m_renderData.shapes[i].type));
+    if (it == m_tessLevels.end() || it->second.empty()) return nullptr;
+    return &it->second[std::min<size_t>(m_shapeTessLevel[i], it->second.size() - 1)];
+}
+
 std::vector<float> Realtime::generateShapeData(PrimitiveType type, int param1, int param2) {
     int p1 = std::max(1, param1);
     int p2 = std::max(3, param2);
@@ -186,12 +343,21 @@ std::vector<float> Realtime::generateShapeData(PrimitiveType type, int param1, i
     }
 }
 
-void Realtime::cleanupVAOs() {
-    for (ShapeVAO& shapeVAO : m_shapeVAOs) {
-        glDeleteBuffers(1, &shapeVAO.vbo);
-        glDeleteVertexArrays(1, &shapeVAO.vao);
+void Realtime::cleanupShapeMeshes() {
+    // shapes, tessellation levels and prototypes only hold copies of these
+    for (const auto &[key, s] : m_sharedShapeMeshes) {
+        if (s.pool && s.pool->contains(s.mesh)) s.pool->remove(s.mesh);
     }
-    m_shapeVAOs.clear();
+    m_sharedShapeMeshes.clear();
+    m_meshFileKeys.clear();
+
+    if (m_shapeInstanceVBO) glDeleteBuffers(1, &m_shapeInstanceVBO);
+    m_shapeMeshes.clear();
+    m_tessLevels.clear();
+    m_shapeTessLevel.clear();
+    m_prototypeDraws.clear();
+    m_shapeInstances.clear();
+    m_shapeInstanceVBO = 0;
 }
 
 void Realtime::resetSnake() {
@@ -265,6 +431,16 @@ void Realtime::initializeGL() {
         ":/resources/shaders/default.frag"
         );
 
+    m_shadowShader = ShaderLoader::createShaderProgram(
+        ":/resources/shaders/shadow.vert",
+        ":/resources/shaders/shadow.frag"
+        );
+    createShadowMap(m_staticShadow,  2048);
+    createShadowMap(m_dynamicShadow, 512);
+
+    const std::string cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString();
+    if (!cacheDir.empty()) m_meshCache.setDirectory(cacheDir + "/meshes");
+
 
     // Load brick diffuse + normal textures for the path
     m_pathDiffuseTex = loadTexture2D(":/resources/textures/brick_diffuse.jpg");
@@ -292,6 +468,8 @@ void Realtime::initializeGL() {
     m_camera.setProjectionMatrix(aspect, settings.nearPlane, settings.farPlane, fovY);
 
 
+    createMeshPools();
+
     // --- Generate a flat terrain so we see something ---
     generateTerrain();
     // --- Generate reusable cube mesh + arena walls ---
@@ -356,100 +534,36 @@ GLuint Realtime::loadTexture2D(const QString &path)
 }
 
 
-static std::string expandLSystem(const std::string &axiom,
-                                 const std::unordered_map<char, std::string> &rules,
-                                 int iterations)
-{
-    std::string current = axiom;
-    for (int i = 0; i < iterations; ++i) {
-        std::string next;
-        for (char c : current) {
-            auto it = rules.find(c);
-            if (it != rules.end()) {
-                next += it->second;   // rewrite using rule
-            } else {
-                next.push_back(c);    // keep as-is
-            }
-        }
-        current.swap(next);
-    }
-    return current;
-}
-
-
-// Generic version used for both the 3-tree scene and the tall-tree scene
+// Generic version used for both the 3-tree scene and the tall-tree scene.
+// The tree shape is memoized per parameter set; each call only places an instance.
 void Realtime::addLSystemPlantCustom(float baseX, float baseZ,
                                      int iterations,
                                      float segH,
                                      float horizStep)
 {
-    using std::string;
-    using RuleMap = std::unordered_map<char, string>;
-
     // Simple bush-like L-system:
     // X -> F[+X]F[-X]FX
     // F -> FF
-    RuleMap rules;
-    rules['X'] = "F[+X]F[-X]FX";
-    rules['F'] = "FF";
-
-    string axiom = "X";
-    string str   = expandLSystem(axiom, rules, iterations);
-
-    glm::vec3 trunkColor(0.50f, 0.35f, 0.20f);
-    glm::vec3 leafColor (0.35f, 0.65f, 0.30f);
-
-    struct Turtle {
-        glm::vec3 pos;
-    };
-
-    Turtle t;
-    t.pos = glm::vec3(baseX, 0.4f, baseZ);   // base on the ground-ish
-
-    std::stack<Turtle> stack;
-
-    auto addCube = [&](const glm::vec3 &p, float h, const glm::vec3 &col) {
-        CubeInstance inst;
-        inst.pos   = glm::vec3(p.x, p.y + 0.5f * h, p.z);
-        inst.scale = glm::vec3(1.f, h, 1.f);
-        inst.color = col;
-        // if CubeInstance has a material field, you can default it:
-        // inst.material = 0;
-        m_cubes.push_back(inst);
-    };
-
-    for (char c : str) {
-        switch (c) {
-        case 'F':
-            // trunk / branch going upward
-            addCube(t.pos, segH, trunkColor);
-            t.pos.y += segH;
-            break;
-        case 'X':
-            // leaf blob at the tip
-            addCube(t.pos, segH, leafColor);
-            break;
-        case '+':
-            // small horizontal offset to one side
-            t.pos.x += horizStep;
-            break;
-        case '-':
-            // small horizontal offset to the other side
-            t.pos.x -= horizStep;
-            break;
-        case '[':
-            stack.push(t);
-            break;
-        case ']':
-            if (!stack.empty()) {
-                t = stack.top();
-                stack.pop();
-            }
-            break;
-        default:
-            break;
-        }
-    }
+    TreeTemplateKey key;
+    key.grammar    = "X;X=F[+X]F[-X]FX;F=FF";
+    key.iterations = iterations;
+    key.segH       = segH;
+    key.horizStep  = horizStep;
+    key.seed       = 0;             // deterministic grammar
+
+    int id = m_treeTemplates.getOrBuild(key);
+
+    // Per-instance variation hashed from the base position:
+    // quarter-turn yaw so branches face different ways, plus a slight tint
+    float v = std::sin(baseX * 12.9898f + baseZ * 78.233f) * 43758.5453f;
+    float r = v - std::floor(v);
+
+    float yaw = glm::half_pi<float>() * std::floor(r * 4.f);
+    glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(baseX, 0.f, baseZ))
+                      * glm::rotate(glm::mat4(1.f), yaw, glm::vec3(0.f, 1.f, 0.f));
+    glm::vec3 tint(0.9f + 0.2f * r);
+
+    m_treeTemplates.addInstance(id, model, tint);
 }
 
 // Old convenience wrapper used by the arena + 3-tree test
@@ -462,7 +576,7 @@ void Realtime::addLSystemPlant(float baseX, float baseZ)
 void Realtime::buildLSystemTestScene(bool singleTall)
 {
     // Clear out gameplay stuff so it doesn't interfere
-    m_cubes.clear();
+    clearWorld();
     m_snakeBody.clear();
     m_hasFood   = false;
     m_snakeDead = false;
@@ -479,12 +593,8 @@ void Realtime::buildLSystemTestScene(bool singleTall)
     // 11x11 grid of flat tiles centered at origin
     for (int x = -5; x <= 5; ++x) {
         for (int z = -5; z <= 5; ++z) {
-            CubeInstance tile;
-            tile.pos   = glm::vec3((float)x, 0.f, (float)z);
-            tile.scale = glm::vec3(1.f, 0.2f, 1.f);
-            tile.color = glm::vec3(0.25f, 0.80f, 0.45f); // green-ish
-            // tile.material = 0; // if you have this field
-            m_cubes.push_back(tile);
+            // thin slab centered on y = 0
+            m_voxels.fillColumn(x, z, -0.1f, 0.1f, glm::vec3(0.25f, 0.80f, 0.45f), MAT_DEFAULT); // green-ish
         }
     }
 
@@ -505,6 +615,7 @@ void Realtime::buildLSystemTestScene(bool singleTall)
         addLSystemPlant( 4.f, 0.f);
     }
 
+    finalizeWorld("L-system test scene");
     update(); // trigger redraw
 }
 
@@ -523,7 +634,7 @@ void Realtime::buildLSystemTallTreeScene()
 void Realtime::buildLSystemTallWideTreeScene()
 {
     // Clear gameplay stuff so it doesn't interfere
-    m_cubes.clear();
+    clearWorld();
     m_snakeBody.clear();
     m_hasFood   = false;
     m_snakeDead = false;
@@ -539,12 +650,7 @@ void Realtime::buildLSystemTallWideTreeScene()
     // --- Simple flat platform under the tree ---
     for (int x = -5; x <= 5; ++x) {
         for (int z = -5; z <= 5; ++z) {
-            CubeInstance tile;
-            tile.pos   = glm::vec3((float)x, 0.f, (float)z);
-            tile.scale = glm::vec3(1.f, 0.2f, 1.f);
-            tile.color = glm::vec3(0.25f, 0.80f, 0.45f);
-            // tile.material = 0; // if you have a material field
-            m_cubes.push_back(tile);
+            m_voxels.fillColumn(x, z, -0.1f, 0.1f, glm::vec3(0.25f, 0.80f, 0.45f), MAT_DEFAULT);
         }
     }
 
@@ -558,14 +664,60 @@ void Realtime::buildLSystemTallWideTreeScene()
         /*horizStep*/ 1.0f     // BIGGER sideways step = longer branches
         );
 
+    finalizeWorld("L-system tall/wide scene");
     update();
 }
 
 
+// Forest of distinct 3D trees from the stochastic parametric L-system.
+// Every seed derives a different tree; the grammar is compiled only once.
+void Realtime::buildParametricForestScene()
+{
+    clearWorld();
+    m_snakeBody.clear();
+    m_hasFood   = false;
+    m_snakeDead = false;
+    m_followSnake = false;
+
+    m_camPos = glm::vec3(0.f, 14.f, 24.f);
+    m_camera.setViewMatrix(
+        m_camPos,
+        glm::vec3(0.f, 2.f, 0.f) - m_camPos,
+        glm::vec3(0.f, 1.f, 0.f)
+        );
+
+    // A(length, width): stochastic branching with leaves at the tips
+    const std::string grammar =
+        "A(1.1,0.22);"
+        "A(l,w) : 0.45 -> F(l,w)[&(32)/(90)A(l*0.78,w*0.7)L(0.5)]/(137.5)[&(28)A(l*0.74,w*0.68)L(0.45)];"
+        "A(l,w) : 0.35 -> F(l,w)/(120)[&(40)A(l*0.7,w*0.65)L(0.4)]A(l*0.86,w*0.75);"
+        "A(l,w) : 0.2 -> F(l,w)[^(25)L(0.5)]A(l*0.9,w*0.8)";
+
+    int count = 0;
+    for (int gz = -3; gz <= 3; ++gz) {
+        for (int gx = -3; gx <= 3; ++gx) {
+            TreeTemplateKey key;
+            key.engine     = TreeTemplateKey::Engine::Parametric;
+            key.grammar    = grammar;
+            key.iterations = 5;
+            key.segH       = 1.f;
+            key.angleDeg   = 25.f;
+            key.cylinders  = ((gx + gz) & 1) != 0;   // mix both segment shapes
+            key.seed       = static_cast<uint32_t>(count);
+
+            int id = m_treeTemplates.getOrBuild(key);
+            glm::mat4 model = glm::translate(glm::mat4(1.f),
+                                             glm::vec3(gx * 2.8f, 0.f, gz * 2.8f));
+            m_treeTemplates.addInstance(id, model, glm::vec3(1.f));
+            ++count;
+        }
+    }
+}
+
 
 void Realtime::buildGrassBumpTestScene() {
     // Clear any existing cubes
-    m_cubes.clear();
+    clearWorld();
 
 
     // Turn off snake follow so camera doesn't get overridden
@@ -585,6 +737,25 @@ void Realtime::buildGrassBumpTestScene() {
 }
 
 
+void Realtime::clearWorld() {
+    m_voxels.clear();
+    m_cubes.clear();
+    m_doorColumns.clear();
+    m_staticShadowDirty = true;
+    m_treeTemplates.clearInstances();
+}
+
+// Last step of every world builder. Chunk meshes are rebuilt lazily in
+// paintGL, only for chunks the builder touched.
+void Realtime::finalizeWorld(const char *label) {
+    m_staticShadowDirty = true;
+
+    std::cout << "[Realtime] " << label << ": " << m_voxels.chunkCount() << " chunks ("
+              << m_voxels.memoryBytes() / 1024 << " KB voxel data), "
+              << m_cubes.size() << " free cubes" << std::endl;
+}
+
+
 void Realtime::generateLSystemFoliageStrip(int zStart, int zEnd, bool leftSide) {
     // Distance from path center to where we plant bushes
     float baseOffsetX = (m_pathWidth * 0.5f) + 3.f; // 1–2 blocks beyond the stone border
@@ -607,44 +778,13 @@ void Realtime::generateTerrain() {
     float size     = 20.f;  // world-space width/depth
 
     std::vector<float> vertexData = m_terrainGenerator.generateFlatGrid(resolution, size);
-    m_terrainVertexCount = static_cast<int>(vertexData.size() / 6); // 3 pos + 3 normal
-
-    glGenVertexArrays(1, &m_terrainVAO);
-    glGenBuffers(1, &m_terrainVBO);
-
-    glBindVertexArray(m_terrainVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_terrainVBO);
-    glBufferData(GL_ARRAY_BUFFER,
-                 vertexData.size() * sizeof(float),
-                 vertexData.data(),
-                 GL_STATIC_DRAW);
-
-    // position attribute (location = 0)
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-                          6 * sizeof(float),
-                          (void*)0);
-
-    // normal attribute (location = 1)
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-                          6 * sizeof(float),
-                          (void*)(3 * sizeof(float)));
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // 20 units wide: halves would only resolve ~1/128 at the edges
+    m_terrainMesh = addPosNormalMesh(vertexData, VertexPacking::Float);
 }
 
 void Realtime::cleanupTerrain() {
-    if (m_terrainVBO) {
-        glDeleteBuffers(1, &m_terrainVBO);
-        m_terrainVBO = 0;
-    }
-    if (m_terrainVAO) {
-        glDeleteVertexArrays(1, &m_terrainVAO);
-        m_terrainVAO = 0;
-    }
-    m_terrainVertexCount = 0;
+    m_posNormalMeshes.remove(m_terrainMesh);
+    m_terrainMesh = MeshHandle();
 }
 
 // CUBE MESH + ARENA LAYOUT
@@ -655,74 +795,493 @@ void Realtime::generateCubeMesh() {
     Cube cube;
     cube.updateParams(1, 1); // lowest tessellation; nice blocky cube
     std::vector<float> data = cube.generateShape();
-    m_cubeVertexCount = static_cast<int>(data.size() / 6); // 3 pos + 3 normal
+    m_cubeMesh = addPosNormalMesh(data, VertexPacking::Packed);
+}
 
-    glGenVertexArrays(1, &m_cubeVAO);
-    glGenBuffers(1, &m_cubeVBO);
+void Realtime::cleanupCubeMesh() {
+    m_packedMeshes.remove(m_cubeMesh);
+    m_cubeMesh = MeshHandle();
+}
 
-    glBindVertexArray(m_cubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_cubeVBO);
 
-    glBufferData(GL_ARRAY_BUFFER,
-                 data.size() * sizeof(float),
-                 data.data(),
-                 GL_STATIC_DRAW);
+// SHARED VERTEX BUFFERS
 
-    // position (location = 0)
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-                          6 * sizeof(float),
-                          (void*)0);
+void Realtime::createMeshPools() {
+    m_posNormalMeshes.create(posNormalVertexFormat(VertexPacking::Float),  1 << 16, 1 << 16);
+    m_packedMeshes.create(posNormalVertexFormat(VertexPacking::Packed),   1 << 14, 1 << 15);
+    m_chunkMeshes.create(chunkVertexFormat(),                             1 << 15);
+}
 
-    // normal (location = 1)
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-                          6 * sizeof(float),
-                          (void*)(3 * sizeof(float)));
+// posNormal: 3 pos + 3 normal floats per vertex, as a triangle soup. The
+// shapes are indexed and reordered for the post-transform cache and overdraw
+// once here, so every draw of them afterwards is cheaper.
+MeshHandle Realtime::addPosNormalMesh(const std::vector<float> &posNormal, VertexPacking packing) {
+    return addIndexedMesh(optimizedMesh(posNormal, m_meshOptimizeTotals), packing);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+MeshHandle Realtime::addIndexedMesh(const IndexedMesh &mesh, VertexPacking packing) {
+    if (mesh.indices.empty()) return MeshHandle();
+
+    const uint32_t count = mesh.vertexCount();
+    if (packing == VertexPacking::Packed) {
+        std::vector<PackedPosNormal> packed = packPosNormal(mesh.vertices);
+        return m_packedMeshes.add(packed.data(), count, mesh.indices.data(), uint32_t(mesh.indices.size()));
+    }
+    return m_posNormalMeshes.add(mesh.vertices.data(), count, mesh.indices.data(), uint32_t(mesh.indices.size()));
 }
 
-void Realtime::cleanupCubeMesh() {
-    if (m_cubeVBO) {
-        glDeleteBuffers(1, &m_cubeVBO);
-        m_cubeVBO = 0;
+// The pool entry already made for `key` this scene, or a new one.
+Realtime::ShapeMesh Realtime::addShapeMesh(uint64_t key, VertexPacking packing,
+                                           const std::function<IndexedMesh()> &build) {
+    auto it = m_sharedShapeMeshes.find(key);
+    if (it == m_sharedShapeMeshes.end()) {
+        it = m_sharedShapeMeshes.emplace(key, loadOrBuildShapeMesh(key, packing, build)).first;
     }
-    if (m_cubeVAO) {
-        glDeleteVertexArrays(1, &m_cubeVAO);
-        m_cubeVAO = 0;
+    return it->second;
+}
+
+// Uploads straight from the cache file's mapping when there is one.
+// Otherwise builds the mesh and its LOD chain (all levels share the vertex
+// buffer; their index lists are stored back to back) and writes that to the
+// cache for next time.
+Realtime::ShapeMesh Realtime::loadOrBuildShapeMesh(uint64_t key, VertexPacking packing,
+                                                   const std::function<IndexedMesh()> &build) {
+    ShapeMesh shape;
+    shape.pool = (packing == VertexPacking::Packed) ? &m_packedMeshes : &m_posNormalMeshes;
+
+    auto setBounds = [&](const glm::vec3 &lo, const glm::vec3 &hi) {
+        shape.center = 0.5f * (lo + hi);
+        shape.radius = 0.5f * glm::length(hi - lo);
+    };
+
+    if (std::unique_ptr<CachedMesh> cached = m_meshCache.load(key, shape.pool->format())) {
+        shape.lods.assign(cached->lods(), cached->lods() + cached->lodCount());
+        setBounds(cached->boundsMin(), cached->boundsMax());
+        shape.mesh = shape.pool->add(cached->vertices(), cached->vertexCount(),
+                                     cached->indices(), cached->indexCount());
+        return shape;
+    }
+
+    IndexedMesh mesh = build();
+    if (mesh.indices.empty()) return shape;
+
+    std::vector<MeshSimplifier::LodLevel> chain = MeshSimplifier::buildLodChain(mesh, {1.f, .5f, .25f, .125f});
+    std::vector<uint32_t> indices;
+    for (const MeshSimplifier::LodLevel &level : chain) {
+        shape.lods.push_back({uint32_t(indices.size()), uint32_t(level.indices.size()), level.error});
+        indices.insert(indices.end(), level.indices.begin(), level.indices.end());
+    }
+
+    std::vector<PackedPosNormal> packed;
+    MeshBlob blob;
+    blob.vertices    = mesh.vertices.data();
+    blob.vertexCount = mesh.vertexCount();
+    blob.indices     = indices.data();
+    blob.indexCount  = uint32_t(indices.size());
+    blob.lods        = shape.lods;
+    if (packing == VertexPacking::Packed) {
+        packed = packPosNormal(mesh.vertices);
+        blob.vertices = packed.data();
+    }
+
+    blob.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    blob.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+    for (uint32_t i = 0; i < blob.vertexCount; ++i) {
+        const float *v = &mesh.vertices[size_t(i) * mesh.floatsPerVertex];
+        blob.boundsMin = glm::min(blob.boundsMin, glm::vec3(v[0], v[1], v[2]));
+        blob.boundsMax = glm::max(blob.boundsMax, glm::vec3(v[0], v[1], v[2]));
+    }
+    setBounds(blob.boundsMin, blob.boundsMax);
+
+    m_meshCache.store(key, shape.pool->format(), blob);
+    shape.mesh = shape.pool->add(blob.vertices, blob.vertexCount, blob.indices, blob.indexCount);
+    return shape;
+}
+
+// Coarsest LOD whose error, projected at the instance's nearest point,
+// stays under kLodPixelError pixels.
+int Realtime::selectLod(const ShapeMesh &shape, const glm::mat4 &model, const glm::mat4 &view) const {
+    const float scale = std::max({glm::length(glm::vec3(model[0])),
+                                  glm::length(glm::vec3(model[1])),
+                                  glm::length(glm::vec3(model[2]))});
+    const glm::vec3 center = glm::vec3(view * model * glm::vec4(shape.center, 1.f));
+    const float distance = std::max(-center.z - shape.radius * scale, m_camera.getNearPlane());
+
+    // pixels per world unit at that distance
+    const float viewportHeight = float(size().height() * m_devicePixelRatio);
+    const float pixelsPerUnit  = 0.5f * viewportHeight * m_camera.getProjMatrix()[1][1] / distance;
+
+    int lod = 0;
+    for (int i = 1; i < int(shape.lods.size()); ++i) {
+        if (shape.lods[i].error * scale * pixelsPerUnit > kLodPixelError) break;
+        lod = i;
     }
-    m_cubeVertexCount = 0;
+    return lod;
 }
 
 
-bool Realtime::cellBlocked(int gx, int gz) const {
-    // Treat outside playable area as blocked too
-    float snakeRadius = 0.4f; // half-size of the snake cube in x/z
+// TREE TEMPLATES (instanced)
+
+// Uploads geometry for templates built since the last frame and re-sends the
+// instance buffers that changed. Builders run outside a GL context, so this
+// is called lazily from paintGL.
+void Realtime::syncTreeBuffers() {
+    std::vector<TreeTemplate> &templates = m_treeTemplates.templates();
+    if (m_treeVAOs.size() < templates.size()) {
+        m_treeVAOs.resize(templates.size());
+    }
+
+    const GLsizei vStride = TreeTemplateCache::kFloatsPerVertex * sizeof(float);
+    const GLsizei iStride = sizeof(TreeInstance);
+
+    for (size_t i = 0; i < templates.size(); ++i) {
+        TreeTemplate &t = templates[i];
+        TreeVAO      &g = m_treeVAOs[i];
+
+        if (!g.vao) {
+            glGenVertexArrays(1, &g.vao);
+            glGenBuffers(1, &g.vbo);
+            glGenBuffers(1, &g.instanceVBO);
+
+            glBindVertexArray(g.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, g.vbo);
+            glBufferData(GL_ARRAY_BUFFER,
+                         t.mesh.size() * sizeof(float),
+                         t.mesh.data(),
+                         GL_STATIC_DRAW);
+
+            // position, normal, block-local position, color (locations 0..3)
+            for (int a = 0; a < 4; ++a) {
+                glEnableVertexAttribArray(a);
+                glVertexAttribPointer(a, 3, GL_FLOAT, GL_FALSE, vStride,
+                                      (void*)(a * 3 * sizeof(float)));
+            }
+
+            // per-instance model matrix (locations 4..7) + tint (location 8)
+            glBindBuffer(GL_ARRAY_BUFFER, g.instanceVBO);
+            for (int c = 0; c < 4; ++c) {
+                glEnableVertexAttribArray(4 + c);
+                glVertexAttribPointer(4 + c, 4, GL_FLOAT, GL_FALSE, iStride,
+                                      (void*)(offsetof(TreeInstance, model) + c * sizeof(glm::vec4)));
+                glVertexAttribDivisor(4 + c, 1);
+            }
+            glEnableVertexAttribArray(8);
+            glVertexAttribPointer(8, 3, GL_FLOAT, GL_FALSE, iStride,
+                                  (void*)offsetof(TreeInstance, tint));
+            glVertexAttribDivisor(8, 1);
+
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindVertexArray(0);
+
+            g.vertexCount = t.vertexCount;
+        }
+
+        if (t.instancesDirty) {
+            glBindBuffer(GL_ARRAY_BUFFER, g.instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER,
+                         t.instances.size() * sizeof(TreeInstance),
+                         t.instances.data(),
+                         GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            g.instanceCount  = static_cast<int>(t.instances.size());
+            t.instancesDirty = false;
+            m_staticShadowDirty = true;
+        }
+    }
+}
+
+void Realtime::cleanupTreeBuffers() {
+    for (TreeVAO &g : m_treeVAOs) {
+        if (g.instanceVBO) glDeleteBuffers(1, &g.instanceVBO);
+        if (g.vbo)         glDeleteBuffers(1, &g.vbo);
+        if (g.vao)         glDeleteVertexArrays(1, &g.vao);
+    }
+    m_treeVAOs.clear();
+
+    // templates need re-uploading if the context comes back
+    for (TreeTemplate &t : m_treeTemplates.templates()) {
+        t.instancesDirty = true;
+    }
+}
+
+void Realtime::syncChunkMeshes() {
+    std::vector<int64_t> dirty = m_voxels.takeDirtyChunks();
+    if (dirty.empty()) return;
+
+    // mesh + light bake on all cores, then upload here on the GL thread
+    LightBakeSettings light;
+    light.toSun = -m_sunDir;
+
+    QElapsedTimer bakeTimer;
+    bakeTimer.start();
+    std::vector<ChunkMesh> meshes;
+    ChunkMesher::buildAll(m_voxels, dirty, light, meshes);
+    m_lastBakeChunks = dirty.size();
+    m_lastBakeMs     = bakeTimer.nsecsElapsed() / 1.0e6;
+
+    // free the old ranges first so the new meshes can reuse them
+    for (int64_t key : dirty) {
+        auto it = m_chunkDraws.find(key);
+        if (it != m_chunkDraws.end()) {
+            m_chunkMeshes.remove(it->second.mesh);
+            m_chunkDraws.erase(it);
+        }
+    }
+
+    for (size_t i = 0; i < dirty.size(); ++i) {
+        const ChunkMesh &mesh = meshes[i];
+        if (mesh.vertexCount() == 0) continue;   // chunk emptied or dropped
+
+        ChunkDraw g;
+        std::vector<PackedChunkVertex> packed = packChunkVertices(mesh.vertices);
+        g.mesh = m_chunkMeshes.add(packed.data(), uint32_t(packed.size()));
+        g.defaultVertexCount = mesh.defaultVertexCount;
+        g.pathVertexCount    = mesh.pathVertexCount;
+        m_chunkDraws.emplace(dirty[i], g);
+    }
+
+    m_staticShadowDirty = true;
+}
 
-    for (const CubeInstance &c : m_cubes) {
-        float hx = 0.5f * c.scale.x;
-        float hz = 0.5f * c.scale.z;
+void Realtime::cleanupChunkMeshes() {
+    for (auto &[key, g] : m_chunkDraws) {
+        m_chunkMeshes.remove(g.mesh);
+    }
+    m_chunkDraws.clear();
+}
 
-        float dx = std::abs(float(gx) - c.pos.x);
-        float dz = std::abs(float(gz) - c.pos.z);
+void Realtime::createShadowMap(ShadowMap &sm, int size) {
+    sm.size = size;
+
+    glGenTextures(1, &sm.depthTex);
+    glBindTexture(GL_TEXTURE_2D, sm.depthTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+    // hardware depth compare + bilinear = 2x2 PCF per tap
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    float border[4] = {1.f, 1.f, 1.f, 1.f};   // outside the map = lit
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-        if (dx < hx + snakeRadius && dz < hz + snakeRadius) {
-            // Only *taller* cubes are solid. Low cubes (path floor) are walkable.
-            if (c.scale.y > 0.6f) {
-                return true;
+    glGenFramebuffers(1, &sm.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, sm.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sm.depthTex, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "[Realtime] shadow framebuffer is not complete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+}
+
+void Realtime::cleanupShadowMaps() {
+    for (ShadowMap *sm : {&m_staticShadow, &m_dynamicShadow}) {
+        if (sm->fbo)      glDeleteFramebuffers(1, &sm->fbo);
+        if (sm->depthTex) glDeleteTextures(1, &sm->depthTex);
+        *sm = ShadowMap();
+    }
+}
+
+glm::mat4 Realtime::snakeHeadModel() const {
+    float baseScale = 0.8f;
+    float scaleY    = baseScale;
+    float scaleXZ   = baseScale;
+
+    if (m_snakeDead) {
+        float t = glm::clamp(m_snakeDeathTime / 0.5f, 0.f, 1.f);
+        scaleY  = baseScale * (1.f - t);
+        scaleXZ = baseScale * (1.f + 0.4f * t);
+    }
+
+    return glm::translate(glm::mat4(1.f), m_snake.pos) *
+           glm::scale(glm::mat4(1.f), glm::vec3(scaleXZ, scaleY, scaleXZ));
+}
+
+// Orthographic sun projection of a world-space box, in the m_sunView frame.
+// snapTexels > 0 snaps the window to whole texels so moving casters don't shimmer.
+static glm::mat4 fitSunOrtho(const glm::mat4 &sunView, const glm::vec3 &lo, const glm::vec3 &hi,
+                             float zNear, float zFar, int snapTexels) {
+    glm::vec2 mn( 1e30f), mx(-1e30f);
+    for (int c = 0; c < 8; ++c) {
+        glm::vec3 p((c & 1) ? hi.x : lo.x, (c & 2) ? hi.y : lo.y, (c & 4) ? hi.z : lo.z);
+        glm::vec3 v = glm::vec3(sunView * glm::vec4(p, 1.f));
+        mn = glm::min(mn, glm::vec2(v));
+        mx = glm::max(mx, glm::vec2(v));
+    }
+
+    if (snapTexels > 0) {
+        float extent = std::max(mx.x - mn.x, mx.y - mn.y);
+        float texel  = extent / snapTexels;
+        mn = glm::floor(mn / texel) * texel;
+        mx = mn + glm::vec2(extent);
+    }
+
+    return glm::ortho(mn.x, mx.x, mn.y, mx.y, zNear, zFar);
+}
+
+void Realtime::renderShadowMaps() {
+    if (!m_shadowShader || !m_staticShadow.fbo) return;
+
+    GLint prevFbo = 0;
+    GLint prevViewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
+    glGetIntegerv(GL_VIEWPORT, prevViewport);
+
+    m_gl.useProgram(m_shadowShader);
+
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.f, 4.f);
+
+    auto drawCube = [&](const glm::mat4 &model) {
+        if (!m_packedMeshes.contains(m_cubeMesh)) return;
+        m_gl.uniform("model", model);
+        m_packedMeshes.draw(m_cubeMesh);
+    };
+
+    // ---------- 1) static casters, only when something changed ----------
+    if (m_staticShadowDirty) {
+        m_staticShadowDirty = false;
+
+        // world bounds: terrain, chunks, props, trees
+        glm::vec3 lo(-10.f, float(VoxelWorld::kMinY), -10.f);
+        glm::vec3 hi( 10.f, float(VoxelWorld::kMinY + VoxelChunk::kHeight), 10.f);
+        for (const auto &[key, g] : m_chunkDraws) {
+            glm::ivec2 c = VoxelWorld::chunkCoords(key);
+            lo = glm::min(lo, glm::vec3(c.x * VoxelChunk::kSize - 0.5f, lo.y, c.y * VoxelChunk::kSize - 0.5f));
+            hi = glm::max(hi, glm::vec3((c.x + 1) * VoxelChunk::kSize - 0.5f, hi.y, (c.y + 1) * VoxelChunk::kSize - 0.5f));
+        }
+        for (size_t i = 0; i < m_cubes.size(); ++i) {
+            CubeInstance c = m_cubes.at(i);
+            lo = glm::min(lo, c.pos - 0.5f * c.scale);
+            hi = glm::max(hi, c.pos + 0.5f * c.scale);
+        }
+        for (const TreeTemplate &t : m_treeTemplates.templates()) {
+            for (const TreeInstance &inst : t.instances) {
+                glm::vec3 base(inst.model[3]);
+                lo = glm::min(lo, base - glm::vec3(4.f, 0.f, 4.f));
+                hi = glm::max(hi, base + glm::vec3(4.f, 10.f, 4.f));
             }
         }
+
+        glm::vec3 center = 0.5f * (lo + hi);
+        float     radius = glm::length(hi - lo) * 0.5f + 1.f;
+        m_sunView = glm::lookAt(center - m_sunDir * radius, center, glm::vec3(0.f, 1.f, 0.f));
+        m_sunNear = 0.f;
+        m_sunFar  = 2.f * radius;
+        m_staticShadow.viewProj = fitSunOrtho(m_sunView, lo, hi, m_sunNear, m_sunFar, 0) * m_sunView;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_staticShadow.fbo);
+        glViewport(0, 0, m_staticShadow.size, m_staticShadow.size);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        m_gl.uniform("lightViewProj", m_staticShadow.viewProj);
+
+        m_gl.uniform("useInstancing", 0);
+        m_gl.uniform("model", glm::mat4(1.f));
+        m_gl.bindVertexArray(m_chunkMeshes.vao());
+        for (const auto &[key, g] : m_chunkDraws) {
+            glDrawArrays(GL_TRIANGLES, m_chunkMeshes.first(g.mesh), m_chunkMeshes.count(g.mesh));
+        }
+
+        m_gl.bindVertexArray(m_packedMeshes.vao());
+        for (size_t i = 0; i < m_cubes.size(); ++i) {
+            CubeInstance c = m_cubes.at(i);
+            drawCube(glm::translate(glm::mat4(1.f), c.pos) * glm::scale(glm::mat4(1.f), c.scale));
+        }
+
+        m_gl.uniform("useInstancing", 1);
+        for (const TreeVAO &g : m_treeVAOs) {
+            if (!g.vao || g.instanceCount == 0) continue;
+            m_gl.bindVertexArray(g.vao);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, g.vertexCount, g.instanceCount);
+        }
+        m_gl.uniform("useInstancing", 0);
+    }
+
+    // ---------- 2) snake + food, every frame, fitted around them ----------
+    {
+        glm::vec3 lo = m_snake.pos - glm::vec3(0.6f);
+        glm::vec3 hi = m_snake.pos + glm::vec3(0.6f);
+        for (const glm::vec3 &seg : m_snakeBody) {
+            lo = glm::min(lo, seg - glm::vec3(0.6f));
+            hi = glm::max(hi, seg + glm::vec3(0.6f));
+        }
+        if (m_hasFood) {
+            lo = glm::min(lo, m_foodPos - glm::vec3(0.6f));
+            hi = glm::max(hi, m_foodPos + glm::vec3(0.6f));
+        }
+
+        // same light frame and depth range as the static map, so receivers
+        // anywhere in the world compare against the same depths
+        m_dynamicShadow.viewProj =
+            fitSunOrtho(m_sunView, lo, hi, m_sunNear, m_sunFar, m_dynamicShadow.size) * m_sunView;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_dynamicShadow.fbo);
+        glViewport(0, 0, m_dynamicShadow.size, m_dynamicShadow.size);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        m_gl.uniform("lightViewProj", m_dynamicShadow.viewProj);
+        m_gl.uniform("useInstancing", 0);
+
+        m_gl.bindVertexArray(m_packedMeshes.vao());
+        drawCube(snakeHeadModel());
+        for (const glm::vec3 &seg : m_snakeBody) {
+            drawCube(glm::translate(glm::mat4(1.f), seg) * glm::scale(glm::mat4(1.f), glm::vec3(0.7f)));
+        }
+        if (m_hasFood) {
+            drawCube(glm::translate(glm::mat4(1.f), m_foodPos) * glm::scale(glm::mat4(1.f), glm::vec3(0.6f)));
+        }
     }
 
-    return false;
+    m_gl.bindVertexArray(0);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+    glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+}
+
+bool Realtime::cellBlocked(int gx, int gz) const {
+    // Only *taller* columns are solid. Low blocks (path floor) are walkable.
+    if (m_voxels.columnTop(gx, gz) > 0.6f) return true;
+
+    // Off-grid props: work on the quantized arrays directly (centi-units).
+    // Only x, z, size and height are read, and the loop has no early exit so
+    // it vectorizes.
+    const int snakeRadius = 40;   // half-size of the snake cube in x/z (0.4)
+
+    // Positive halves compare like their bit patterns.
+    const uint16_t solidHeight = CubeStore::toHalf(0.6f);
+
+    const int qx = gx * int(CubeStore::kQuantum);
+    const int qz = gz * int(CubeStore::kQuantum);
+
+    const int16_t  *xs    = m_cubes.xs();
+    const int16_t  *zs    = m_cubes.zs();
+    const uint16_t *sizes = m_cubes.sizes();
+    const uint16_t *hs    = m_cubes.heights();
+    const size_t    n     = m_cubes.size();
+
+    int hit = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int reach2 = int(sizes[i]) + 2 * snakeRadius;   // doubled to keep integers
+        int dx2    = 2 * std::abs(qx - int(xs[i]));
+        int dz2    = 2 * std::abs(qz - int(zs[i]));
+
+        hit |= int(dx2 < reach2) & int(dz2 < reach2) & int(hs[i] > solidHeight);
+    }
+
+    return hit != 0;
 }
 
 
 
 void Realtime::buildArenaLayout() {
-    m_cubes.clear();
+    clearWorld();
 
     // Our terrain is size = 20.f, centered at origin -> half extent = 10
     const float half       = 10.f;
@@ -734,19 +1293,20 @@ void Realtime::buildArenaLayout() {
     auto addCube = [&](float x, float z, float height,
                        const glm::vec3 &color,
                        int material = MAT_DEFAULT) {
-        CubeInstance inst;
-        inst.pos      = glm::vec3(x, height * 0.5f, z); // center at half height
-        inst.scale    = glm::vec3(unit, height, unit);
-        inst.color    = color;
-        inst.material = material;
-        m_cubes.push_back(inst);
+        // column standing on the ground, 0..height
+        m_voxels.fillColumn(int(std::lround(x)), int(std::lround(z)), 0.f, height, color, material);
     };
 
     // ---------- 1) BORDER WALLS (solid ring) ----------
+    const float doorHalfWidth = 1.5f;   // centered opening, see openFrontDoor()
     for (float x = -half; x <= half; x += unit) {
         // front & back walls – **no gap here**, door opens later in openFrontDoor()
         addCube(x, -half, wallHeight, wallColor, MAT_WALL); // front (z = -10)
         addCube(x,  half, wallHeight, wallColor, MAT_WALL); // back  (z = +10)
+
+        if (std::abs(x) <= doorHalfWidth) {
+            m_doorColumns.push_back(glm::ivec2(int(std::lround(x)), int(-half)));
+        }
     }
 
     for (float z = -half; z <= half; z += unit) {
@@ -793,6 +1353,8 @@ void Realtime::buildArenaLayout() {
             addCube(float(gx), float(gz), height, color);
         }
     }
+
+    finalizeWorld("arena");
 }
 
 
@@ -810,12 +1372,8 @@ void Realtime::buildInitialPathStrip() {
 
     auto addCube = [&](float x, float yHeight, float z,
                        const glm::vec3 &color, int material) {
-        CubeInstance inst;
-        inst.pos     = glm::vec3(x, yHeight * 0.5f, z);
-        inst.scale   = glm::vec3(unit, yHeight, unit);
-        inst.color   = color;
-        inst.material = material; // 0 = default, 1 = path floor
-        m_cubes.push_back(inst);
+        // 0 = default, 1 = path floor
+        m_voxels.fillColumn(int(std::lround(x)), int(std::lround(z)), 0.f, yHeight, color, material);
     };
 
 
@@ -849,13 +1407,15 @@ void Realtime::buildInitialPathStrip() {
     // Add L-system bushes along both sides of the path
     generateLSystemFoliageStrip(zStart, zEnd, /*leftSide=*/true);
     generateLSystemFoliageStrip(zStart, zEnd, /*leftSide=*/false);
+
+    finalizeWorld("path strip");
 }
 
 
 
 void Realtime::buildNormalMapTestScene() {
     // Clear any existing cubes
-    m_cubes.clear();
+    clearWorld();
 
     // One big cube at origin that uses the PATH material (normal-mapped bricks)
     CubeInstance inst;
@@ -863,7 +1423,7 @@ void Realtime::buildNormalMapTestScene() {
     inst.scale    = glm::vec3(4.f, 4.f, 4.f); // nice big cube
     inst.color    = glm::vec3(1.f, 1.f, 1.f); // white so brick texture shows clearly
     inst.material = MAT_PATH;                 // uses brick diffuse + normal map
-    m_cubes.push_back(inst);
+    m_cubes.insert(inst);                     // off the voxel grid (centered on a cell corner)
 
     // Turn off snake follow so camera doesn't get overridden
     m_followSnake = false;
@@ -880,7 +1440,7 @@ void Realtime::buildNormalMapTestScene() {
 
 void Realtime::rebuildMainArenaScene() {
     // Restore original arena + snake + camera so you can keep playing
-    m_cubes.clear();
+    clearWorld();
     buildArenaLayout();
 
     // Reset door/path state
@@ -908,22 +1468,11 @@ void Realtime::openFrontDoor() {
     if (m_doorOpened) return;
     m_doorOpened = true;
 
-    // Arena extent must match buildArenaLayout
-    const float half      = 10.f;
-    const float doorZ     = -half;       // front wall (same side as path: m_pathStartZ = -10)
-    const float doorXStart = -1.5f;      // centered opening
-    const float doorXEnd   =  1.5f;
-    const float zEpsilon   = 0.5f;
-
-    for (CubeInstance &c : m_cubes) {
-        bool onFrontWall = std::abs(c.pos.z - doorZ) < zEpsilon;
-        bool inDoorSpan  = (c.pos.x >= doorXStart && c.pos.x <= doorXEnd);
-
-        if (onFrontWall && inDoorSpan && c.scale.y > 0.f) {
-            // “remove” the cube by shrinking its height
-            c.scale.y = 0.f;
-        }
+    // door columns were recorded by buildArenaLayout (front wall, z = -10)
+    for (const glm::ivec2 &col : m_doorColumns) {
+        m_voxels.clearColumn(col.x, col.y);
     }
+    m_doorColumns.clear();
 }
 
 
@@ -931,236 +1480,367 @@ void Realtime::paintGL() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     if (!m_shader) return;
 
-    glUseProgram(m_shader);
+    m_gl.beginFrame();
 
-    // --- material & texture uniforms ---
-    GLint useBlockyLoc       = glGetUniformLocation(m_shader, "useBlocky");
-    GLint useNormalMapLoc    = glGetUniformLocation(m_shader, "useNormalMap");
-    GLint usePathMaterialLoc = glGetUniformLocation(m_shader, "usePathMaterial");
-    GLint pathUVScaleLoc     = glGetUniformLocation(m_shader, "pathUVScale");
+    // bring static meshes up to date, then the shadow maps (static one only
+    // if something changed)
+    syncChunkMeshes();
+    syncTreeBuffers();
 
-    // UV scale for brick tiling
-    glUniform1f(pathUVScaleLoc, m_pathUVScale);
+    // Qt and the uploads above bind things behind the cache's back
+    m_gl.invalidateBindings();
+    renderShadowMaps();
 
-    // Bind brick textures to texture units 0 and 1
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_pathDiffuseTex);
-    glUniform1i(glGetUniformLocation(m_shader, "pathDiffuseMap"), 0);
+    m_gl.useProgram(m_shader);
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_pathNormalTex);
-    glUniform1i(glGetUniformLocation(m_shader, "pathNormalMap"), 1);
+    // --- material & texture uniforms (per-draw flags are set by drawRenderQueue) ---
+    // UV scale for brick tiling
+    m_gl.uniform("pathUVScale", m_pathUVScale);
 
+    // Bind brick textures to texture units 0 and 1
+    m_gl.bindTexture(0, GL_TEXTURE_2D, m_pathDiffuseTex);
+    m_gl.uniform("pathDiffuseMap", 0);
 
+    m_gl.bindTexture(1, GL_TEXTURE_2D, m_pathNormalTex);
+    m_gl.uniform("pathNormalMap", 1);
 
     //GRASSS
     // NEW: bind grass textures to units 2 and 3
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, m_grassDiffuseTex);
-    glUniform1i(glGetUniformLocation(m_shader, "grassDiffuseMap"), 2);
+    m_gl.bindTexture(2, GL_TEXTURE_2D, m_grassDiffuseTex);
+    m_gl.uniform("grassDiffuseMap", 2);
 
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, m_grassHeightTex);
-    glUniform1i(glGetUniformLocation(m_shader, "grassHeightMap"), 3);
+    m_gl.bindTexture(3, GL_TEXTURE_2D, m_grassHeightTex);
+    m_gl.uniform("grassHeightMap", 3);
 
     // UV + bump strength
-    glUniform1f(glGetUniformLocation(m_shader, "grassUVScale"),  m_grassUVScale);
-    glUniform1f(glGetUniformLocation(m_shader, "grassBumpScale"), m_grassBumpScale);
-
-    GLint useGrassBumpLoc = glGetUniformLocation(m_shader, "useGrassBump");
-
+    m_gl.uniform("grassUVScale",   m_grassUVScale);
+    m_gl.uniform("grassBumpScale", m_grassBumpScale);
 
+    // Sun shadow maps on units 4 (static, cached) and 5 (snake + food)
+    m_gl.bindTexture(4, GL_TEXTURE_2D, m_staticShadow.depthTex);
+    m_gl.uniform("staticShadowMap", 4);
 
+    m_gl.bindTexture(5, GL_TEXTURE_2D, m_dynamicShadow.depthTex);
+    m_gl.uniform("dynamicShadowMap", 5);
 
+    m_gl.uniform("staticLightVP",  m_staticShadow.viewProj);
+    m_gl.uniform("dynamicLightVP", m_dynamicShadow.viewProj);
+    m_gl.uniform("useShadows", m_staticShadow.depthTex ? 1 : 0);
 
     // --- camera matrices ---
     glm::mat4 view = m_camera.getViewMatrix();
     glm::mat4 proj = m_camera.getProjMatrix();
-    glUniformMatrix4fv(glGetUniformLocation(m_shader, "view"),
-                       1, GL_FALSE, &view[0][0]);
-    glUniformMatrix4fv(glGetUniformLocation(m_shader, "proj"),
-                       1, GL_FALSE, &proj[0][0]);
+    m_gl.uniform("view", view);
+    m_gl.uniform("proj", proj);
 
     // --- camera position ---
-    glUniform3fv(glGetUniformLocation(m_shader, "camPos"),
-                 1, &m_camPos[0]);
+    m_gl.uniform("camPos", m_camPos);
 
     // --- global lighting coeffs ---
     float ka = 0.2f, kd = 0.8f, ks = 0.3f;
-    glUniform1f(glGetUniformLocation(m_shader, "k_a"), ka);
-    glUniform1f(glGetUniformLocation(m_shader, "k_d"), kd);
-    glUniform1f(glGetUniformLocation(m_shader, "k_s"), ks);
+    m_gl.uniform("k_a", ka);
+    m_gl.uniform("k_d", kd);
+    m_gl.uniform("k_s", ks);
 
     // --- one directional light ---
-    auto loc0 = [&](const std::string &field) {
-        std::string name = "lights[0]." + field;
-        return glGetUniformLocation(m_shader, name.c_str());
-    };
-    glUniform1i(glGetUniformLocation(m_shader, "numLights"), 1);
+    m_gl.uniform("numLights", 1);
 
     int typeDir = 1;
     glm::vec3 lightColor(1.f, 1.f, 1.f);
-    glm::vec3 lightDir = glm::normalize(glm::vec3(-1.f, -1.f, -1.f));
+    glm::vec3 lightDir = m_sunDir;     // chunk meshes baked their shadows with it
     glm::vec3 lightPos(0.f);            // unused for directional
     glm::vec3 atten(1.f, 0.f, 0.f);     // no falloff
 
-    glUniform1i(loc0("type"), typeDir);
-    glUniform3fv(loc0("color"), 1, &lightColor[0]);
-    glUniform3fv(loc0("pos"),   1, &lightPos[0]);
-    glUniform3fv(loc0("dir"),   1, &lightDir[0]);
-    glUniform3fv(loc0("atten"), 1, &atten[0]);
-    glUniform1f(loc0("angle"),    0.f);
-    glUniform1f(loc0("penumbra"), 0.f);
+    m_gl.uniform("lights[0].type",     typeDir);
+    m_gl.uniform("lights[0].color",    lightColor);
+    m_gl.uniform("lights[0].pos",      lightPos);
+    m_gl.uniform("lights[0].dir",      lightDir);
+    m_gl.uniform("lights[0].atten",    atten);
+    m_gl.uniform("lights[0].angle",    0.f);
+    m_gl.uniform("lights[0].penumbra", 0.f);
+
+    // ---------- everything opaque goes through the sorted render queue ----------
+    m_renderQueue.clear();
+    m_renderQueue.setDepthRange(m_camera.getNearPlane(), m_camera.getFarPlane());
+    submitSceneDraws(view);
+    m_renderQueue.sort();
+    drawRenderQueue();
+
+    m_gl.useProgram(0);
+}
+
 
 
 
-    // ---------- TERRAIN (no blocky effect, no textures) ----------
-    // ---------- TERRAIN (bump-mapped grass) ----------
-    glUniform1i(useBlockyLoc,       0);
-    glUniform1i(usePathMaterialLoc, 0);
-    // glUniform1i(useNormalMapLoc,    0);
-
-    // NEW: enable bump mapping for terrain
-    glUniform1i(useGrassBumpLoc, 1);
-
-    if (m_terrainVAO && m_terrainVertexCount > 0) {
-        glm::mat4 model(1.f);
-        glUniformMatrix4fv(glGetUniformLocation(m_shader, "model"),
-                           1, GL_FALSE, &model[0][0]);
-
-        // These will still be used as "base" values, but diffuse will get overridden
-        glm::vec3 cA(0.35f, 0.55f, 0.35f);
-        glm::vec3 cD(0.55f, 0.85f, 0.55f);
-        glm::vec3 cS(0.04f, 0.04f, 0.04f);
-        glUniform3fv(glGetUniformLocation(m_shader, "cAmbient"),  1, &cA[0]);
-        glUniform3fv(glGetUniformLocation(m_shader, "cDiffuse"),  1, &cD[0]);
-        glUniform3fv(glGetUniformLocation(m_shader, "cSpecular"), 1, &cS[0]);
-        glUniform1f(glGetUniformLocation(m_shader, "shininess"),  6.f);
-
-        glBindVertexArray(m_terrainVAO);
-        glDrawArrays(GL_TRIANGLES, 0, m_terrainVertexCount);
-        glBindVertexArray(0);
-    }
-
-
-    // ---------- ARENA WALL CUBES + PATH (blocky) ----------
-    glUniform1i(useGrassBumpLoc,   0);
-    glUniform1i(useBlockyLoc, 1);
-
-    if (m_cubeVAO && m_cubeVertexCount > 0) {
-        for (const CubeInstance &inst : m_cubes) {
-            // Skip "deleted" cubes (e.g., door pieces) so they don't cause seams
-            if (inst.scale.y <= 0.f) continue;
-
-            // === material flags: 1 = path bricks, 0 = normal cube ===
-            bool isPathFloor = (inst.material == 1);
-
-            glUniform1i(usePathMaterialLoc, isPathFloor ? 1 : 0);
-            glUniform1i(useNormalMapLoc,
-                        (isPathFloor && m_pathNormalTex != 0) ? 1 : 0);
-
-            glm::mat4 model = glm::translate(glm::mat4(1.f), inst.pos)
-                              * glm::scale(glm::mat4(1.f), inst.scale);
-            glUniformMatrix4fv(glGetUniformLocation(m_shader, "model"),
-                               1, GL_FALSE, &model[0][0]);
-
-            glm::vec3 cD = inst.color;
-            glm::vec3 cA = 0.6f * cD;
-            glm::vec3 cS(0.08f, 0.08f, 0.08f);
-            glUniform3fv(glGetUniformLocation(m_shader, "cAmbient"),  1, &cA[0]);
-            glUniform3fv(glGetUniformLocation(m_shader, "cDiffuse"),  1, &cD[0]);
-            glUniform3fv(glGetUniformLocation(m_shader, "cSpecular"), 1, &cS[0]);
-            glUniform1f(glGetUniformLocation(m_shader, "shininess"), 10.f);
-
-            glBindVertexArray(m_cubeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, m_cubeVertexCount);
-            glBindVertexArray(0);
-        }
 
-        // ---------- SNAKE (single rigid-body cube, blocky, NO normal map) ----------
-        // ---------- SNAKE HEAD (single rigid-body cube, blocky, NO normal map) ----------
-        glUniform1i(usePathMaterialLoc, 0);
-        glUniform1i(useNormalMapLoc,    0);
+// Fills m_renderQueue with this frame's opaque draws. Depth is the distance
+// of each draw's center along the view axis.
+void Realtime::submitSceneDraws(const glm::mat4 &view) {
+    auto viewDepth = [&](const glm::vec3 &p) {
+        return -(view * glm::vec4(p, 1.f)).z;
+    };
 
-        float baseScale = 0.8f;
-        float scaleY    = baseScale;
-        float scaleXZ   = baseScale;
+    // ---------- SCENEFILE SHAPES, one tessellation / LOD per instance ----------
+    updateShapeTessellation(view);
+
+    m_shapeTriangles = 0;
+    for (size_t i = 0; i < m_shapeMeshes.size() && i < m_renderData.shapes.size(); ++i) {
+        const ShapeMesh *mesh = shapeMesh(i);
+        if (!mesh || !mesh->pool->contains(mesh->mesh) || mesh->lods.empty()) continue;
+        const ShapeMesh &shape = *mesh;
+
+        const RenderShapeData &data = m_renderData.shapes[i];
+        const SceneMaterial   &mat  = m_renderData.materials[data.material];
+        const MeshLod         &lod  = shape.lods[selectLod(shape, data.ctm, view)];
+
+        DrawItem d;
+        d.vao        = shape.pool->vao();
+        d.first      = shape.pool->first(shape.mesh);
+        d.firstIndex = shape.pool->firstIndex(shape.mesh) + int(lod.firstIndex);
+        d.count      = int(lod.indexCount);
+        d.variant    = DrawVariant::Shape;
+        d.batch      = data.material + 1;
+        d.model      = data.ctm;
+        d.ambient    = glm::vec3(mat.cAmbient);
+        d.diffuse    = glm::vec3(mat.cDiffuse);
+        d.specular   = glm::vec3(mat.cSpecular);
+        d.shininess  = mat.shininess;
+        m_renderQueue.submit(d, viewDepth(glm::vec3(data.ctm * glm::vec4(shape.center, 1.f))));
+        m_shapeTriangles += lod.indexCount / 3;
+    }
 
-        if (m_snakeDead) {
-            float t = glm::clamp(m_snakeDeathTime / 0.5f, 0.f, 1.f);
-            scaleY  = baseScale * (1.f - t);
-            scaleXZ = baseScale * (1.f + 0.4f * t);
+    // ---------- TEMPLATE INSTANCES, one instanced draw per prototype shape ----------
+    for (size_t p = 0; p < m_prototypeDraws.size(); ++p) {
+        const PrototypeDraw &g = m_prototypeDraws[p];
+        if (g.instanceCount == 0) continue;
+
+        // the instances are spread out; LOD and sort go by the nearest one
+        size_t nearestAt = g.firstInstance;
+        float  nearest   = std::numeric_limits<float>::max();
+        for (size_t i = g.firstInstance; i < g.firstInstance + size_t(g.instanceCount); ++i) {
+            const float depth = viewDepth(glm::vec3(m_shapeInstances[i][3]));
+            if (depth < nearest) {
+                nearest   = depth;
+                nearestAt = i;
+            }
+        }
+
+        const std::vector<RenderShapeData> &shapes = m_renderData.prototypes[p].shapes;
+        for (size_t i = 0; i < g.meshes.size() && i < shapes.size(); ++i) {
+            const ShapeMesh *mesh = &g.meshes[i];
+            if (!mesh->pool) {
+                auto it = m_tessLevels.find(int(shapes[i].type));
+                if (it == m_tessLevels.end() || it->second.empty()) continue;
+                mesh = &it->second.back();
+            }
+            if (!mesh->pool->contains(mesh->mesh) || mesh->lods.empty()) continue;
+            const ShapeMesh &shape = *mesh;
+
+            const RenderShapeData &data = shapes[i];
+            const SceneMaterial   &mat  = m_renderData.materials[data.material];
+            const MeshLod         &lod  = shape.lods[selectLod(shape, m_shapeInstances[nearestAt] * data.ctm, view)];
+
+            DrawItem d;
+            d.vao            = shape.pool->vao();
+            d.first          = shape.pool->first(shape.mesh);
+            d.firstIndex     = shape.pool->firstIndex(shape.mesh) + int(lod.firstIndex);
+            d.count          = int(lod.indexCount);
+            d.instances      = g.instanceCount;
+            d.instanceBuffer = m_shapeInstanceVBO;
+            d.instanceOffset = uint32_t(g.firstInstance * sizeof(glm::mat4));
+            d.variant        = DrawVariant::ShapeInstanced;
+            d.batch          = data.material + 1;
+            d.model          = data.ctm;   // inside the template; instances go on top
+            d.ambient        = glm::vec3(mat.cAmbient);
+            d.diffuse        = glm::vec3(mat.cDiffuse);
+            d.specular       = glm::vec3(mat.cSpecular);
+            d.shininess      = mat.shininess;
+            m_renderQueue.submit(d, nearest);
+            m_shapeTriangles += uint64_t(lod.indexCount / 3) * uint64_t(g.instanceCount);
         }
+    }
 
-        glm::mat4 snakeModel =
-            glm::translate(glm::mat4(1.f), m_snake.pos) *
-            glm::scale(glm::mat4(1.f), glm::vec3(scaleXZ, scaleY, scaleXZ));
+    // ---------- TERRAIN (bump-mapped grass) ----------
+    if (m_posNormalMeshes.contains(m_terrainMesh)) {
+        DrawItem d;
+        d.vao       = m_posNormalMeshes.vao();
+        d.first      = m_posNormalMeshes.first(m_terrainMesh);
+        d.firstIndex = m_posNormalMeshes.firstIndex(m_terrainMesh);
+        d.count      = m_posNormalMeshes.indexCount(m_terrainMesh);
+        d.variant   = DrawVariant::Terrain;
+        d.textures  = TextureSet::Grass;
+        // base values, the grass texture overrides diffuse
+        d.ambient   = glm::vec3(0.35f, 0.55f, 0.35f);
+        d.diffuse   = glm::vec3(0.55f, 0.85f, 0.55f);
+        d.specular  = glm::vec3(0.04f);
+        d.shininess = 6.f;
+        m_renderQueue.submit(d, viewDepth(glm::vec3(0.f)));
+    }
 
-        glUniformMatrix4fv(glGetUniformLocation(m_shader, "model"),
-                           1, GL_FALSE, &snakeModel[0][0]);
+    // ---------- ARENA WALLS + PATH (voxel chunk meshes, blocky, baked AO) ----------
+    for (const auto &[key, g] : m_chunkDraws) {
+        const glm::ivec2 cc = VoxelWorld::chunkCoords(key);
+        const float half = 0.5f * VoxelChunk::kSize;
+        glm::vec3 center(cc.x * VoxelChunk::kSize + half - 0.5f,
+                         VoxelWorld::kMinY + 0.5f * VoxelChunk::kHeight,
+                         cc.y * VoxelChunk::kSize + half - 0.5f);
+
+        const GLint base = m_chunkMeshes.first(g.mesh);
+
+        DrawItem d;
+        d.vao       = m_chunkMeshes.vao();
+        d.variant   = DrawVariant::Chunk;
+        d.specular  = glm::vec3(0.08f);
+        d.shininess = 10.f;
+
+        if (g.defaultVertexCount > 0) {
+            d.first    = base;
+            d.count    = g.defaultVertexCount;
+            d.material = MAT_DEFAULT;
+            d.textures = TextureSet::None;
+            m_renderQueue.submit(d, viewDepth(center));
+        }
+        if (g.pathVertexCount > 0) {
+            d.first    = base + g.defaultVertexCount;
+            d.count    = g.pathVertexCount;
+            d.material = MAT_PATH;
+            d.textures = TextureSet::Path;
+            m_renderQueue.submit(d, viewDepth(center));
+        }
+    }
 
-        glm::vec3 headD(1.0f, 0.9f, 0.2f);
-        glm::vec3 headA = 0.6f * headD;
-        glm::vec3 headS(0.12f, 0.12f, 0.12f);
+    // ---------- L-SYSTEM TREES (one instanced draw per template) ----------
+    for (size_t t = 0; t < m_treeVAOs.size(); ++t) {
+        const TreeVAO &g = m_treeVAOs[t];
+        if (!g.vao || g.instanceCount == 0) continue;
+
+        DrawItem d;
+        d.vao       = g.vao;
+        d.count     = g.vertexCount;
+        d.instances = g.instanceCount;
+        d.variant   = DrawVariant::Instanced;
+        d.specular  = glm::vec3(0.08f);
+        d.shininess = 10.f;
+        // the instances are spread out; sort the group by its nearest tree
+        float nearest = std::numeric_limits<float>::max();
+        for (const TreeInstance &inst : m_treeTemplates.templates()[t].instances) {
+            nearest = std::min(nearest, viewDepth(glm::vec3(inst.model[3])));
+        }
+        m_renderQueue.submit(d, nearest);
+    }
 
-        glUniform3fv(glGetUniformLocation(m_shader, "cAmbient"),  1, &headA[0]);
-        glUniform3fv(glGetUniformLocation(m_shader, "cDiffuse"),  1, &headD[0]);
-        glUniform3fv(glGetUniformLocation(m_shader, "cSpecular"), 1, &headS[0]);
-        glUniform1f(glGetUniformLocation(m_shader, "shininess"),  18.f);
+    if (!m_packedMeshes.contains(m_cubeMesh)) return;
+
+    auto submitCube = [&](const glm::mat4 &model, const glm::vec3 &color,
+                          const glm::vec3 &specular, float shininess, int material) {
+        DrawItem d;
+        d.vao       = m_packedMeshes.vao();
+        d.first      = m_packedMeshes.first(m_cubeMesh);
+        d.firstIndex = m_packedMeshes.firstIndex(m_cubeMesh);
+        d.count      = m_packedMeshes.indexCount(m_cubeMesh);
+        d.variant   = DrawVariant::Cube;
+        d.material  = material;
+        d.textures  = (material == MAT_PATH) ? TextureSet::Path : TextureSet::None;
+        d.model     = model;
+        d.ambient   = 0.6f * color;
+        d.diffuse   = color;
+        d.specular  = specular;
+        d.shininess = shininess;
+        m_renderQueue.submit(d, viewDepth(glm::vec3(model[3])));
+    };
 
-        glBindVertexArray(m_cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, m_cubeVertexCount);
+    // ---------- OFF-GRID PROPS (blocky cubes) ----------
+    for (size_t i = 0; i < m_cubes.size(); ++i) {
+        const CubeInstance inst = m_cubes.at(i);
+        glm::mat4 model = glm::translate(glm::mat4(1.f), inst.pos)
+                          * glm::scale(glm::mat4(1.f), inst.scale);
+        submitCube(model, inst.color, glm::vec3(0.08f), 10.f, inst.material);
+    }
 
-        // ---------- SNAKE BODY SEGMENTS ----------
-        for (const glm::vec3 &segPos : m_snakeBody) {
-            glm::mat4 bodyModel =
-                glm::translate(glm::mat4(1.f), segPos) *
-                glm::scale(glm::mat4(1.f), glm::vec3(0.7f, 0.7f, 0.7f));
+    // ---------- SNAKE HEAD + BODY (no normal map) ----------
+    submitCube(snakeHeadModel(), glm::vec3(1.0f, 0.9f, 0.2f), glm::vec3(0.12f), 18.f, MAT_DEFAULT);
 
-            glUniformMatrix4fv(glGetUniformLocation(m_shader, "model"),
-                               1, GL_FALSE, &bodyModel[0][0]);
+    for (const glm::vec3 &segPos : m_snakeBody) {
+        glm::mat4 bodyModel =
+            glm::translate(glm::mat4(1.f), segPos) *
+            glm::scale(glm::mat4(1.f), glm::vec3(0.7f, 0.7f, 0.7f));
+        // slightly dimmer yellow
+        submitCube(bodyModel, glm::vec3(0.95f, 0.8f, 0.2f), glm::vec3(0.10f), 12.f, MAT_DEFAULT);
+    }
 
-            glm::vec3 bodyD(0.95f, 0.8f, 0.2f); // slightly dimmer yellow
-            glm::vec3 bodyA = 0.6f * bodyD;
-            glm::vec3 bodyS(0.10f, 0.10f, 0.10f);
-            glUniform3fv(glGetUniformLocation(m_shader, "cAmbient"),  1, &bodyA[0]);
-            glUniform3fv(glGetUniformLocation(m_shader, "cDiffuse"),  1, &bodyD[0]);
-            glUniform3fv(glGetUniformLocation(m_shader, "cSpecular"), 1, &bodyS[0]);
-            glUniform1f(glGetUniformLocation(m_shader, "shininess"),  12.f);
+    // ---------- FOOD ----------
+    if (m_hasFood) {
+        glm::mat4 foodModel =
+            glm::translate(glm::mat4(1.f), m_foodPos) *
+            glm::scale(glm::mat4(1.f), glm::vec3(0.6f, 0.6f, 0.6f));
+        // reddish fruit
+        submitCube(foodModel, glm::vec3(0.95f, 0.25f, 0.25f), glm::vec3(0.12f), 20.f, MAT_DEFAULT);
+    }
+}
 
-            glDrawArrays(GL_TRIANGLES, 0, m_cubeVertexCount);
+// Issues the sorted queue. Consecutive draws mostly share flags, VAO and
+// material, and m_gl drops the calls that wouldn't change anything.
+void Realtime::drawRenderQueue() {
+    for (uint32_t idx : m_renderQueue.order()) {
+        const DrawItem &d = m_renderQueue.item(idx);
+        const bool isPath = (d.material == MAT_PATH);
+
+        m_gl.uniform("useGrassBump",    d.variant == DrawVariant::Terrain   ? 1 : 0);
+        m_gl.uniform("useBlocky",       (d.variant == DrawVariant::Terrain ||
+                                         d.variant == DrawVariant::Shape ||
+                                         d.variant == DrawVariant::ShapeInstanced) ? 0 : 1);
+        m_gl.uniform("useVertexColor",  d.variant == DrawVariant::Chunk     ? 1 : 0);
+        m_gl.uniform("useInstancing",   d.variant == DrawVariant::Instanced      ? 1
+                                        : d.variant == DrawVariant::ShapeInstanced ? 2 : 0);
+        m_gl.uniform("usePathMaterial", isPath ? 1 : 0);
+        m_gl.uniform("useNormalMap",    (isPath && m_pathNormalTex != 0) ? 1 : 0);
+
+        m_gl.uniform("model",     d.model);
+        m_gl.uniform("cAmbient",  d.ambient);
+        m_gl.uniform("cDiffuse",  d.diffuse);
+        m_gl.uniform("cSpecular", d.specular);
+        m_gl.uniform("shininess", d.shininess);
+
+        m_gl.bindVertexArray(d.vao);
+
+        // per-instance matrices for a shared pool VAO: pointed at this
+        // draw's range, and switched off again after it so the pool's
+        // other meshes don't fetch them
+        if (d.instanceBuffer) {
+            glBindBuffer(GL_ARRAY_BUFFER, d.instanceBuffer);
+            for (GLuint c = 0; c < 4; ++c) {
+                glEnableVertexAttribArray(4 + c);
+                glVertexAttribPointer(4 + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                      (void*)(intptr_t(d.instanceOffset) + c * sizeof(glm::vec4)));
+                glVertexAttribDivisor(4 + c, 1);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
 
-        // ---------- FOOD ----------
-        if (m_hasFood) {
-            glm::mat4 foodModel =
-                glm::translate(glm::mat4(1.f), m_foodPos) *
-                glm::scale(glm::mat4(1.f), glm::vec3(0.6f, 0.6f, 0.6f));
-
-            glUniformMatrix4fv(glGetUniformLocation(m_shader, "model"),
-                               1, GL_FALSE, &foodModel[0][0]);
-
-            glm::vec3 fd(0.95f, 0.25f, 0.25f); // reddish fruit
-            glm::vec3 fa = 0.6f * fd;
-            glm::vec3 fs(0.12f, 0.12f, 0.12f);
-            glUniform3fv(glGetUniformLocation(m_shader, "cAmbient"),  1, &fa[0]);
-            glUniform3fv(glGetUniformLocation(m_shader, "cDiffuse"),  1, &fd[0]);
-            glUniform3fv(glGetUniformLocation(m_shader, "cSpecular"), 1, &fs[0]);
-            glUniform1f(glGetUniformLocation(m_shader, "shininess"),  20.f);
-
-            glDrawArrays(GL_TRIANGLES, 0, m_cubeVertexCount);
+        if (d.firstIndex >= 0) {
+            const void *offset = (void*)(intptr_t(d.firstIndex) * sizeof(uint32_t));
+            if (d.instances > 0) {
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, d.count, GL_UNSIGNED_INT, offset,
+                                                  d.instances, d.first);
+            } else {
+                glDrawElementsBaseVertex(GL_TRIANGLES, d.count, GL_UNSIGNED_INT, offset, d.first);
+            }
+        } else if (d.instances > 0) {
+            glDrawArraysInstanced(GL_TRIANGLES, d.first, d.count, d.instances);
+        } else {
+            glDrawArrays(GL_TRIANGLES, d.first, d.count);
         }
 
-        glBindVertexArray(0);
+        if (d.instanceBuffer) {
+            for (GLuint c = 0; c < 4; ++c) {
+                glDisableVertexAttribArray(4 + c);
+            }
+        }
     }
 
-    glUseProgram(0);
+    m_gl.bindVertexArray(0);
 }
 
-
-
-
-
 void Realtime::resizeGL(int w, int h) {
     glViewport(0, 0,
                size().width() * m_devicePixelRatio,
@@ -1191,12 +1871,13 @@ void Realtime::settingsChanged() {
 
     makeCurrent();
 
-    if (!m_renderData.shapes.empty()) {
-        generateShapeVAOs();
+    const bool hasScene = !m_renderData.shapes.empty() || !m_renderData.instances.empty();
+    if (hasScene) {
+        generateShapeMeshes();
     }
 
     float aspect = float(size().width()) / float(size().height());
-    float fovY = !m_renderData.shapes.empty()
+    float fovY = hasScene
                      ? m_renderData.cameraData.heightAngle
                      : 45.f * 3.1415926535f / 180.f;
 
@@ -1266,6 +1947,13 @@ void Realtime::keyPressEvent(QKeyEvent *event) {
         return;
     }
 
+    if (key == Qt::Key_P) {
+        // P = forest of distinct stochastic 3D L-system trees
+        buildParametricForestScene();
+        update();
+        return;
+    }
+
     if (key == Qt::Key_R) {
         // R = Return to main arena game
         rebuildMainArenaScene();
@@ -1273,6 +1961,42 @@ void Realtime::keyPressEvent(QKeyEvent *event) {
         return;
     }
 
+    if (key == Qt::Key_F) {
+        // F = GL calls issued / skipped by the state cache last frame, plus
+        // the cache stats of the meshes built so far and the cost of the
+        // last chunk remesh
+        const GLStateCache::Stats &st = m_gl.lastFrame();
+        std::cout << "[GL] last frame: " << st.totalIssued() << " issued, "
+                  << st.totalElided() << " elided";
+        for (int c = 0; c < GLStateCache::kCategoryCount; ++c) {
+            std::cout << " | " << GLStateCache::categoryName(GLStateCache::Category(c)) << " "
+                      << st.issued[c] << "/" << st.issued[c] + st.elided[c];
+        }
+        std::cout << std::endl;
+        if (!m_shapeMeshes.empty()) {
+            std::cout << "[LOD] scene shapes: " << m_shapeTriangles << " triangles" << std::endl;
+        }
+        if (m_meshOptimizeTotals.meshes > 0) {
+            const MeshOptimizeTotals &t = m_meshOptimizeTotals;
+            std::cout << "[MeshOptimizer] " << t.meshes << " meshes built, " << t.triangles << " tris: ACMR "
+                      << t.generated().acmr << " -> " << t.optimized().acmr << ", ATVR "
+                      << t.generated().atvr << " -> " << t.optimized().atvr << std::endl;
+        }
+        if (m_lastBakeChunks > 0) {
+            std::cout << "[Realtime] last remesh: baked " << m_lastBakeChunks << " chunks in "
+                      << m_lastBakeMs << " ms" << std::endl;
+        }
+        return;
+    }
+
+    if (key == Qt::Key_V) {
+        // V = adaptive tessellation on/off (off: shapeParameter1/2 apply)
+        settings.adaptiveTessellation = !settings.adaptiveTessellation;
+        std::cout << "adaptiveTessellation = " << settings.adaptiveTessellation << std::endl;
+        settingsChanged();
+        return;
+    }
+
     if (event->key() == Qt::Key_N) {
         m_useNormalMap = !m_useNormalMap;
         std::cout << "useNormalMap = " << m_useNormalMap << std::endl;
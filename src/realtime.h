@@ -8,6 +8,7 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <functional>
 #include <vector>
 #include <unordered_map>
 
@@ -28,6 +29,18 @@
 #include "scenedata.h"
 #include "sceneparser.h"
 #include "terraingenerator.h"
+#include "cubeinstance.h"
+#include "cubestore.h"
+#include "voxelworld.h"
+#include "chunkmesher.h"
+#include "renderqueue.h"
+#include "glstatecache.h"
+#include "meshpool.h"
+#include "vertexpacking.h"
+#include "meshoptimizer.h"
+#include "meshcache.h"
+#include "meshsimplifier.h"
+#include "treetemplates.h"
 #include <QImage>
 #include <deque>
 #include <QDebug>
@@ -71,18 +84,115 @@ private:
     // ========== Shaders ==========
     GLuint m_shader = 0;
 
-    // ========== Shape VAOs from scenefile (if used) ==========
-    struct ShapeVAO {
-        GLuint vao = 0;
-        GLuint vbo = 0;
-        int    vertexCount = 0;
+    // Skips redundant binds / uniform uploads; press F for last frame's counts
+    GLStateCache m_gl;
+
+    // ========== Sun shadows ==========
+    // Static casters (voxel chunks, props, trees) go into a big depth map that
+    // is only re-rendered when the world changes. The snake + food are
+    // re-rendered every frame into a small map fitted around them; the main
+    // shader combines both with PCF.
+    struct ShadowMap {
+        GLuint    fbo      = 0;
+        GLuint    depthTex = 0;
+        int       size     = 0;
+        glm::mat4 viewProj = glm::mat4(1.f);
     };
 
-    std::vector<ShapeVAO> m_shapeVAOs;
+    GLuint    m_shadowShader = 0;
+    ShadowMap m_staticShadow;
+    ShadowMap m_dynamicShadow;
+    bool      m_staticShadowDirty = true;   // set whenever static casters change
+    glm::mat4 m_sunView  = glm::mat4(1.f);
+    float     m_sunNear  = 0.f;             // depth range of the static fit, the
+    float     m_sunFar   = 1.f;             // dynamic map reuses it
+
+    void createShadowMap(ShadowMap &sm, int size);
+    void renderShadowMaps();
+    void cleanupShadowMaps();
+
+    // ========== Shared vertex buffers ==========
+    // One pool per vertex format; each pool has a single VAO and meshes are
+    // sub-ranges of its buffer. [pos, normal] meshes pick a pool by
+    // VertexPacking: the terrain keeps full floats, the unit cube and
+    // scenefile shapes use the 12-byte packed layout. Chunk meshes are
+    // always packed (PackedChunkVertex).
+    MeshPool m_posNormalMeshes;   // VertexPacking::Float
+    MeshPool m_packedMeshes;      // VertexPacking::Packed
+    MeshPool m_chunkMeshes;
+
+    void       createMeshPools();
+    MeshHandle addPosNormalMesh(const std::vector<float> &posNormal, VertexPacking packing);
+    MeshHandle addIndexedMesh(const IndexedMesh &mesh, VertexPacking packing);
+
+    // built meshes on disk, keyed by their source
+    MeshCache m_meshCache;
+
+    // ========== Shape meshes from scenefile (if used) ==========
+    // primitives live in m_packedMeshes, OBJ meshes in m_posNormalMeshes.
+    // Every shape carries a LOD chain: index ranges of its pool entry,
+    // finest first, picked per instance by projected error.
+    struct ShapeMesh {
+        MeshPool            *pool = nullptr;
+        MeshHandle           mesh;
+        std::vector<MeshLod> lods;
+        glm::vec3            center = glm::vec3(0.f);   // object-space bounds
+        float                radius = 0.f;
+    };
+    std::vector<ShapeMesh> m_shapeMeshes;
+
+    static constexpr float kLodPixelError = 1.f;   // allowed screen-space error
+    uint64_t m_shapeTriangles = 0;                 // drawn last frame
+    MeshOptimizeTotals m_meshOptimizeTotals;       // every mesh optimized so far, printed on F
+
+    // Every shape with the same MeshCache key shares one pool entry, so N
+    // shapes naming one OBJ (or one primitive tessellation) upload, simplify
+    // and hash it once. Entries are released once, in cleanupShapeMeshes.
+    std::unordered_map<uint64_t, ShapeMesh>    m_sharedShapeMeshes;   // by MeshCache key
+    std::unordered_map<std::string, uint64_t>  m_meshFileKeys;        // path -> MeshCache::fileKey
+
+    ShapeMesh addShapeMesh(uint64_t key, VertexPacking packing,
+                           const std::function<IndexedMesh()> &build);
+    ShapeMesh loadOrBuildShapeMesh(uint64_t key, VertexPacking packing,
+                                   const std::function<IndexedMesh()> &build);
+    int       selectLod(const ShapeMesh &shape, const glm::mat4 &model, const glm::mat4 &view) const;
+
+    // Adaptive tessellation (settings.adaptiveTessellation): every primitive
+    // type gets a few tessellations, shared by all shapes of that type, and
+    // each shape uses the one that fits its projected size. Such shapes
+    // have a null pool in m_shapeMeshes. Levels are re-picked only after
+    // the camera moved or turned noticeably.
+    std::unordered_map<int, std::vector<ShapeMesh>> m_tessLevels;   // PrimitiveType -> coarse..fine
+    std::vector<int> m_shapeTessLevel;                               // per shape
+    glm::vec3 m_tessCamPos  = glm::vec3(0.f);
+    glm::vec3 m_tessCamLook = glm::vec3(0.f);
+    float     m_tessPixelScale = 0.f;
+    bool      m_tessDirty      = true;
+
+    void             buildTessellationLevels(PrimitiveType type);
+    void             updateShapeTessellation(const glm::mat4 &view);
+    const ShapeMesh *shapeMesh(size_t i) const;
+
+    // Template groups (RenderData::prototypes): each prototype shape is one
+    // instanced draw over every use of its template, with the instance
+    // CTMs, grouped by prototype, in m_shapeInstanceVBO. All instances of a
+    // draw share the LOD (or, for adaptive shapes, the finest tessellation)
+    // their nearest member needs.
+    struct PrototypeDraw {
+        size_t                 firstInstance = 0;   // into m_shapeInstances
+        int                    instanceCount = 0;
+        std::vector<ShapeMesh> meshes;              // by prototype shape
+    };
+    std::vector<PrototypeDraw> m_prototypeDraws;
+    std::vector<glm::mat4>     m_shapeInstances;    // as uploaded
+    GLuint                     m_shapeInstanceVBO = 0;
+
+    void generatePrototypeDraws();
 
     void loadScene();
-    void generateShapeVAOs();
-    void cleanupVAOs();
+    ShapeMesh addPrimitiveMesh(const RenderShapeData &shape);
+    void generateShapeMeshes();
+    void cleanupShapeMeshes();
     std::vector<float> generateShapeData(PrimitiveType type, int param1, int param2);
 
     // ========== Camera ==========
@@ -93,32 +203,40 @@ private:
 
     // ========== Terrain ==========
     TerrainGenerator m_terrainGenerator;
-    GLuint m_terrainVAO        = 0;
-    GLuint m_terrainVBO        = 0;
-    int    m_terrainVertexCount = 0;
+    MeshHandle m_terrainMesh;   // in m_posNormalMeshes
 
     void generateTerrain();
     void cleanupTerrain();
 
     // ========== Cube mesh re-used for walls/snake/etc. ==========
-    enum MaterialType {
-        MAT_DEFAULT = 0,
-        MAT_PATH    = 1,
-        MAT_WALL    = 2
+    MeshHandle m_cubeMesh;      // in m_packedMeshes
+
+    // The blocky world lives in m_voxels and is drawn as one mesh per chunk;
+    // m_cubes only holds props that don't sit on the grid (still quantized SoA,
+    // and still scanned by cellBlocked after the heightmap lookup).
+    VoxelWorld m_voxels;
+    CubeStore  m_cubes;
+    std::vector<glm::ivec2> m_doorColumns;  // front-wall columns cleared by openFrontDoor()
+
+    struct ChunkDraw {
+        MeshHandle mesh;                  // in m_chunkMeshes
+        int        defaultVertexCount = 0;
+        int        pathVertexCount    = 0;
     };
+    std::unordered_map<int64_t, ChunkDraw> m_chunkDraws;   // by VoxelWorld::chunkKey
+    size_t m_lastBakeChunks = 0;     // last syncChunkMeshes(), printed on F
+    double m_lastBakeMs     = 0.0;
 
-    struct CubeInstance {
-        glm::vec3 pos;
-        glm::vec3 scale;
-        glm::vec3 color;
-        int material = MAT_DEFAULT; // safe now, enum is above
-    };
+    // The one directional light; static blocks bake their shadows against it
+    const glm::vec3 m_sunDir = glm::normalize(glm::vec3(-1.f, -1.f, -1.f));
 
-    GLuint m_cubeVAO        = 0;
-    GLuint m_cubeVBO        = 0;
-    int    m_cubeVertexCount = 0;
+    // Opaque draws of the frame, sorted by state then front-to-back depth
+    RenderQueue m_renderQueue;
+    void submitSceneDraws(const glm::mat4 &view);
+    void drawRenderQueue();
 
-    std::vector<CubeInstance> m_cubes;   // arena walls, props, etc.
+    void syncChunkMeshes();      // remeshes + uploads dirty chunks only
+    void cleanupChunkMeshes();
     bool cellBlocked(int gx, int gz) const;
 
     // collision helpers
@@ -169,6 +287,21 @@ private:
                                float segH,
                                float horizStep);
     void buildLSystemTestScene(bool singleTall);
+
+    // Memoized tree shapes, drawn with one instanced call per template
+    struct TreeVAO {
+        GLuint vao           = 0;
+        GLuint vbo           = 0;
+        GLuint instanceVBO   = 0;
+        int    vertexCount   = 0;
+        int    instanceCount = 0;
+    };
+
+    TreeTemplateCache    m_treeTemplates;
+    std::vector<TreeVAO> m_treeVAOs;   // indexed by template id
+
+    void syncTreeBuffers();
+    void cleanupTreeBuffers();
     void buildLSystemOnlyScene();      // 3 trees (old behavior)
     void buildLSystemTallTreeScene();  // 1 tall tree
 
@@ -182,6 +315,9 @@ private:
     void generateCubeMesh();
     void cleanupCubeMesh();
     void buildArenaLayout();
+    void clearWorld();                // drops voxels, cubes + placed trees
+    glm::mat4 snakeHeadModel() const;
+    void finalizeWorld(const char *label);
 
     // ========== Snake (single rigid body cube) ==========
     struct SnakeState {
@@ -236,6 +372,7 @@ private:
     void buildNormalMapTestScene();   // big brick cube in front of camera
     void rebuildMainArenaScene();     // back to normal game
     void buildLSystemTallWideTreeScene();
+    void buildParametricForestScene();
     void buildGrassBumpTestScene();
 
 
@@ -0,0 +1,83 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+void RenderQueue::clear() {
+    m_items.clear();
+    m_keys.clear();
+    m_order.clear();
+}
+
+void RenderQueue::setDepthRange(float nearDepth, float farDepth) {
+    m_near = nearDepth;
+    m_far  = std::max(farDepth, nearDepth + 1e-3f);
+}
+
+uint64_t RenderQueue::makeKey(Pass pass, DrawVariant variant, uint32_t state,
+                              uint32_t depthBits, uint32_t sequence) {
+    return (uint64_t(pass & 0xf)                   << 60) |
+           (uint64_t(uint8_t(variant) & 0xf)        << 56) |
+           (uint64_t(state & 0xffff)                << 40) |
+           (uint64_t(depthBits & 0xffffff)          << 16) |
+           uint64_t(sequence & 0xffff);
+}
+
+uint32_t RenderQueue::stateBits(const DrawItem &item) {
+    if (item.batch) return item.batch & 0xffff;
+    return (uint32_t(item.material & 0xff) << 8) | uint8_t(item.textures);
+}
+
+uint32_t RenderQueue::quantizeDepth(float viewDepth) const {
+    float t = std::clamp((viewDepth - m_near) / (m_far - m_near), 0.f, 1.f);
+    return uint32_t(t * float(0xffffff));
+}
+
+void RenderQueue::submit(const DrawItem &item, float viewDepth, Pass pass) {
+    uint32_t sequence = uint32_t(m_items.size());
+    m_keys.push_back(makeKey(pass, item.variant, stateBits(item),
+                             quantizeDepth(viewDepth), sequence));
+    m_items.push_back(item);
+}
+
+void RenderQueue::sort() {
+    const size_t n = m_keys.size();
+    m_order.resize(n);
+    std::iota(m_order.begin(), m_order.end(), 0u);
+    if (n < 2) return;
+
+    // one pass over the keys builds all eight byte histograms
+    std::array<std::array<uint32_t, 256>, 8> counts{};
+    for (uint64_t k : m_keys) {
+        for (int b = 0; b < 8; ++b) {
+            counts[b][(k >> (8 * b)) & 0xff]++;
+        }
+    }
+
+    std::vector<uint64_t> &keys = m_keys;   // ends up sorted alongside m_order
+    m_keyScratch.resize(n);
+    m_orderScratch.resize(n);
+
+    for (int b = 0; b < 8; ++b) {
+        std::array<uint32_t, 256> &c = counts[b];
+
+        // every key has the same byte here: nothing to do
+        if (c[(keys[0] >> (8 * b)) & 0xff] == n) continue;
+
+        uint32_t sum = 0;
+        for (uint32_t &v : c) {
+            uint32_t tmp = v;
+            v = sum;
+            sum += tmp;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t dst = c[(keys[i] >> (8 * b)) & 0xff]++;
+            m_keyScratch[dst]   = keys[i];
+            m_orderScratch[dst] = m_order[i];
+        }
+        keys.swap(m_keyScratch);
+        m_order.swap(m_orderScratch);
+    }
+}
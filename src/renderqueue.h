@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Which shader branch a draw uses. The order is the draw order inside a
+// pass: big static occluders first so later draws lose more fragments to
+// early-Z, and the full-screen-ish terrain last.
+enum class DrawVariant : uint8_t {
+    Chunk     = 0,   // voxel chunk mesh: vertex colors + baked light
+    Instanced = 1,   // tree templates
+    Cube      = 2,   // unit cube with a model matrix (props, snake, food)
+    Shape     = 3,   // scenefile primitives and meshes, at a LOD
+    ShapeInstanced = 4,   // the same, instanced over a template group's uses
+    Terrain   = 5,   // bump-mapped grass
+};
+
+// Texture units a draw actually samples. All of them stay bound for the
+// frame, so this only groups draws that read the same images.
+enum class TextureSet : uint8_t {
+    None  = 0,
+    Path  = 1,   // brick diffuse + normal map
+    Grass = 2,   // grass diffuse + height map
+};
+
+// One draw call plus the per-draw uniforms it needs.
+struct DrawItem {
+    uint32_t    vao       = 0;
+    int         first     = 0;        // first vertex, or base vertex when indexed
+    int         count     = 0;        // vertices, or indices when indexed
+    int         firstIndex = -1;      // >= 0: glDrawElements from the VAO's index buffer
+    int         instances = 0;        // 0 = non-instanced draw, otherwise instanced
+    uint32_t    instanceBuffer = 0;   // != 0: per-instance mat4s at locations 4..7,
+    uint32_t    instanceOffset = 0;   // read from this byte offset into it
+
+    DrawVariant variant   = DrawVariant::Cube;
+    int         material  = 0;        // MaterialType
+    uint32_t    batch     = 0;        // != 0: scenefile material + 1, keeps equal materials adjacent
+    TextureSet  textures  = TextureSet::None;   // ignored for the key when batch != 0
+
+    glm::mat4   model     = glm::mat4(1.f);
+    glm::vec3   ambient   = glm::vec3(0.f);
+    glm::vec3   diffuse   = glm::vec3(0.f);
+    glm::vec3   specular  = glm::vec3(0.f);
+    float       shininess = 1.f;
+};
+
+// Per-frame list of draws, ordered by a 64-bit key:
+//
+//   63..60  pass
+//   59..56  shader variant
+//   55..40  material << 8 | texture set, or the draw's batch (16 bits)
+//   39..16  view depth, front to back (24 bits)
+//   15..0   submission order
+//
+// so state changes happen as rarely as possible and, within one state,
+// near geometry is drawn first. Keys are sorted with an LSD radix sort.
+//
+// Batched draws (scenefile shapes) don't sample textures, so their batch gets
+// the texture byte too: up to 65535 scene materials sort apart. Past that,
+// batches share a key field and are only grouped by depth within it.
+class RenderQueue {
+public:
+    enum Pass : uint8_t { kOpaque = 0 };
+
+    void clear();
+
+    // Depth range used to quantize viewDepth (distance along the view axis).
+    void setDepthRange(float nearDepth, float farDepth);
+
+    void submit(const DrawItem &item, float viewDepth, Pass pass = kOpaque);
+
+    // Sorts the submitted items; order() is valid until the next clear().
+    void sort();
+
+    const std::vector<uint32_t> &order() const { return m_order; }
+    const DrawItem &item(uint32_t i) const { return m_items[i]; }
+    size_t size() const { return m_items.size(); }
+
+    static uint64_t makeKey(Pass pass, DrawVariant variant, uint32_t state,
+                            uint32_t depthBits, uint32_t sequence);
+    static uint32_t stateBits(const DrawItem &item);
+    uint32_t quantizeDepth(float viewDepth) const;
+
+private:
+    std::vector<DrawItem> m_items;
+    std::vector<uint64_t> m_keys;
+    std::vector<uint32_t> m_order;
+
+    // radix sort scratch, kept between frames
+    std::vector<uint64_t> m_keyScratch;
+    std::vector<uint32_t> m_orderScratch;
+
+    float m_near = 0.1f;
+    float m_far  = 100.f;
+};
@@ -7,6 +7,8 @@ struct Settings {
     std::string sceneFilePath;
     int shapeParameter1 = 1;
     int shapeParameter2 = 1;
+    bool adaptiveTessellation = false;  // primitives ignore shapeParameter1/2 and
+                                        // pick a level by on-screen size (V)
     float nearPlane = 1;
     float farPlane = 1;
     bool perPixelFilter = false;
@@ -0,0 +1,130 @@
+// Scenefile parse benchmark: writes a generated scene of N group nodes (each
+// with a transform and a primitive, plus a point light per 100 nodes), then
+// times SceneParser::parse on it cold (no .cache) and again from the cache.
+//
+//   scenebench [nodes = 100000] [out = scenebench.json]
+//
+// Built only with -DBUILD_SCENE_BENCH=ON.
+
+#include "sceneparser.h"
+#include "scenecache.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+constexpr int kFanOut = 8;
+
+struct Generator {
+    std::ofstream &out;
+    std::mt19937   rng{1230};
+    size_t         remaining;
+
+    float uniform(float lo, float hi) {
+        return std::uniform_real_distribution<float>(lo, hi)(rng);
+    }
+
+    void vec3(float lo, float hi) {
+        out << "[" << uniform(lo, hi) << "," << uniform(lo, hi) << "," << uniform(lo, hi) << "]";
+    }
+
+    void group(int depth) {
+        static const char *kTypes[] = {"cube", "sphere", "cylinder", "cone"};
+        const size_t index = remaining--;
+
+        out << "{\"translate\":";
+        vec3(-2.f, 2.f);
+        out << ",\"rotate\":[0,1,0," << uniform(0.f, 180.f) << "]";
+        if (index % 100 == 0) {
+            out << ",\"lights\":[{\"type\":\"point\",\"color\":";
+            vec3(0.f, 1.f);
+            out << ",\"attenuationCoeff\":[1,0.1,0.01]}]";
+        }
+        out << ",\"primitives\":[{\"type\":\"" << kTypes[rng() % 4] << "\",\"diffuse\":";
+        vec3(0.f, 1.f);
+        out << ",\"ambient\":[0.1,0.1,0.1]}]";
+
+        if (depth < 6 && remaining > 0) {
+            out << ",\"groups\":[";
+            for (int i = 0; i < kFanOut && remaining > 0; ++i) {
+                if (i) out << ",";
+                group(depth + 1);
+            }
+            out << "]";
+        }
+        out << "}";
+    }
+};
+
+bool writeScene(const std::string &path, size_t nodes) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[scenebench] can't write " << path << std::endl;
+        return false;
+    }
+
+    out << "{\"name\":\"scenebench\","
+        << "\"globalData\":{\"ambientCoeff\":0.5,\"diffuseCoeff\":0.5,\"specularCoeff\":0.5},"
+        << "\"cameraData\":{\"position\":[0,0,20],\"up\":[0,1,0],\"look\":[0,0,-1],\"heightAngle\":45},"
+        << "\"groups\":[";
+    Generator gen{out, std::mt19937(1230), nodes};
+    for (bool first = true; gen.remaining > 0; first = false) {
+        if (!first) out << ",";
+        gen.group(0);
+    }
+    out << "]}";
+    return bool(out);
+}
+
+double timedParse(const std::string &path, RenderData &data) {
+    const auto start = std::chrono::steady_clock::now();
+    if (!SceneParser::parse(path, data)) return -1.0;
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printPeakRss() {
+#ifndef _WIN32
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // kilobytes on Linux, bytes on macOS
+#ifdef __APPLE__
+        std::cout << "  peak RSS = " << usage.ru_maxrss / (1024 * 1024) << " MB" << std::endl;
+#else
+        std::cout << "  peak RSS = " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+#endif
+    }
+#endif
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const size_t      nodes = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    const std::string path  = (argc > 2) ? argv[2] : "scenebench.json";
+    if (nodes == 0 || !writeScene(path, nodes)) return 1;
+
+    std::error_code ec;
+    std::filesystem::remove(SceneCache::cachePath(path), ec);
+
+    RenderData cold;
+    const double coldMs = timedParse(path, cold);
+    if (coldMs < 0.0) return 1;
+    std::cout << "[scenebench] " << nodes << " nodes, "
+              << std::filesystem::file_size(path, ec) / 1024 << " KB: parsed in " << coldMs << " ms" << std::endl;
+    printPeakRss();
+
+    RenderData cached;
+    const double cachedMs = timedParse(path, cached);
+    if (cachedMs < 0.0) return 1;
+    std::cout << "[scenebench] from cache in " << cachedMs << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include "treetemplates.h"
+#include "lsystem.h"
+#include "cube.h"
+#include "cylinder.h"
+#include "cubecleanup.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <functional>
+#include <sstream>
+#include <unordered_set>
+
+static inline size_t hashCombine(size_t seed, size_t v) {
+    return seed ^ (v + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+static inline uint32_t floatBits(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+size_t TreeTemplateKeyHash::operator()(const TreeTemplateKey &k) const {
+    size_t h = std::hash<std::string>()(k.grammar);
+    h = hashCombine(h, std::hash<int>()(k.iterations));
+    h = hashCombine(h, std::hash<uint32_t>()(floatBits(k.segH)));
+    h = hashCombine(h, std::hash<uint32_t>()(floatBits(k.horizStep)));
+    h = hashCombine(h, std::hash<uint32_t>()(floatBits(k.angleDeg)));
+    h = hashCombine(h, std::hash<int>()(static_cast<int>(k.engine) * 2 + (k.cylinders ? 1 : 0)));
+    h = hashCombine(h, std::hash<uint32_t>()(k.seed));
+    return h;
+}
+
+int TreeTemplateCache::getOrBuild(const TreeTemplateKey &key) {
+    auto it = m_lookup.find(key);
+    if (it != m_lookup.end()) {
+        return it->second;
+    }
+
+    TreeTemplate t;
+    t.key = key;
+    if (key.engine == TreeTemplateKey::Engine::Parametric) {
+        buildParametric(t);
+    } else {
+        buildBlocks(t);
+        buildMesh(t);
+    }
+
+    int id = static_cast<int>(m_templates.size());
+    m_templates.push_back(std::move(t));
+    m_lookup[key] = id;
+    return id;
+}
+
+void TreeTemplateCache::addInstance(int id, const glm::mat4 &model, const glm::vec3 &tint) {
+    if (id < 0 || id >= static_cast<int>(m_templates.size())) return;
+
+    TreeTemplate &t = m_templates[id];
+    t.instances.push_back({model, tint});
+    t.instancesDirty = true;
+}
+
+void TreeTemplateCache::clearInstances() {
+    for (TreeTemplate &t : m_templates) {
+        if (!t.instances.empty()) {
+            t.instances.clear();
+            t.instancesDirty = true;
+        }
+    }
+}
+
+// Runs the L-system turtle once and records the blocks in template space.
+void TreeTemplateCache::buildBlocks(TreeTemplate &t) const {
+    // grammar = "axiom;A=succ;B=succ"
+    LSystem lsys;
+    std::string axiom;
+    {
+        std::stringstream ss(t.key.grammar);
+        std::string part;
+        bool first = true;
+        while (std::getline(ss, part, ';')) {
+            if (first) {
+                axiom = part;
+                first = false;
+            } else if (part.size() >= 2 && part[1] == '=') {
+                lsys.setRule(part[0], part.substr(2));
+            }
+        }
+    }
+
+    const glm::vec3 trunkColor(0.50f, 0.35f, 0.20f);
+    const glm::vec3 leafColor (0.35f, 0.65f, 0.30f);
+    const float segH      = t.key.segH;
+    const float horizStep = t.key.horizStep;
+
+    struct Turtle {
+        glm::vec3 pos;
+    };
+
+    Turtle turtle;
+    turtle.pos = glm::vec3(0.f, 0.4f, 0.f);   // base on the ground-ish
+
+    std::vector<Turtle> stack;
+
+    auto addBlock = [&](const glm::vec3 &p, float h, const glm::vec3 &col) {
+        CubeInstance b;
+        b.pos   = glm::vec3(p.x, p.y + 0.5f * h, p.z);
+        b.scale = glm::vec3(1.f, h, 1.f);
+        b.color = col;
+        t.blocks.push_back(b);
+    };
+
+    lsys.generate(axiom, t.key.iterations, [&](char c) {
+        switch (c) {
+        case 'F':
+            // trunk / branch going upward
+            addBlock(turtle.pos, segH, trunkColor);
+            turtle.pos.y += segH;
+            break;
+        case 'X':
+            // leaf blob at the tip
+            addBlock(turtle.pos, segH, leafColor);
+            break;
+        case '+':
+            turtle.pos.x += horizStep;
+            break;
+        case '-':
+            turtle.pos.x -= horizStep;
+            break;
+        case '[':
+            stack.push_back(turtle);
+            break;
+        case ']':
+            if (!stack.empty()) {
+                turtle = stack.back();
+                stack.pop_back();
+            }
+            break;
+        default:
+            break;
+        }
+    });
+
+    // after ']' the turtle re-emits blocks where a sibling branch already put
+    // one; drop those before the mesh is baked
+    removeRedundantCubes(t.blocks);
+}
+
+// Unit shapes baked into the merged meshes, [p, n] per vertex
+static const std::vector<float> &unitCube() {
+    static const std::vector<float> data = [] {
+        Cube cube;
+        cube.updateParams(1, 1);
+        return cube.generateShape();
+    }();
+    return data;
+}
+
+static const std::vector<float> &unitCylinder() {
+    static const std::vector<float> data = [] {
+        Cylinder cylinder;
+        cylinder.updateParams(1, 8);
+        return cylinder.generateShape();
+    }();
+    return data;
+}
+
+// Bakes every block into one vertex buffer so a whole tree is a single draw.
+void TreeTemplateCache::buildMesh(TreeTemplate &t) const {
+    const std::vector<float> &unit = unitCube();
+    const size_t unitVerts = unit.size() / 6;
+
+    t.mesh.clear();
+    t.mesh.reserve(t.blocks.size() * unitVerts * kFloatsPerVertex);
+
+    for (const CubeInstance &b : t.blocks) {
+        for (size_t v = 0; v < unitVerts; ++v) {
+            const float *src = &unit[v * 6];
+            glm::vec3 local(src[0], src[1], src[2]);
+            glm::vec3 p = b.pos + local * b.scale;
+
+            t.mesh.insert(t.mesh.end(), {
+                p.x, p.y, p.z,
+                src[3], src[4], src[5],     // axis-aligned scale keeps normals
+                local.x, local.y, local.z,
+                b.color.r, b.color.g, b.color.b
+            });
+        }
+    }
+
+    t.vertexCount = static_cast<int>(t.mesh.size() / kFloatsPerVertex);
+}
+
+namespace {
+
+// Segment quantized to 1/100 units: start, heading, up, length, width, leaf
+struct SegmentKey {
+    int v[12];
+    bool operator==(const SegmentKey &o) const {
+        return std::memcmp(v, o.v, sizeof(v)) == 0;
+    }
+};
+
+struct SegmentKeyHash {
+    size_t operator()(const SegmentKey &k) const {
+        size_t h = 0;
+        for (int x : k.v) h = hashCombine(h, std::hash<int>()(x));
+        return h;
+    }
+};
+
+} // namespace
+
+// Parametric segments are oriented, so removeRedundantCubes' axis-aligned
+// containment test does not apply; only exact repeats (same start, frame and
+// size at 1/100 units) are dropped, e.g. two bracketed branches that derive the
+// same module string from the same turtle state.
+static size_t removeDuplicateSegments(std::vector<ParametricLSystem::Segment> &segments) {
+    auto q = [](float f) { return int(std::lround(f * 100.f)); };
+
+    std::unordered_set<SegmentKey, SegmentKeyHash> seen;
+    seen.reserve(segments.size());
+    size_t kept = 0;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const ParametricLSystem::Segment &s = segments[i];
+        SegmentKey k;
+        for (int a = 0; a < 3; ++a) {
+            k.v[a]     = q(s.start[a]);
+            k.v[3 + a] = q(s.heading[a]);
+            k.v[6 + a] = q(s.up[a]);
+        }
+        k.v[9]  = q(s.length);
+        k.v[10] = q(s.width);
+        k.v[11] = s.leaf ? 1 : 0;
+        if (!seen.insert(k).second) continue;
+        segments[kept++] = s;
+    }
+    size_t removed = segments.size() - kept;
+    segments.resize(kept);
+    return removed;
+}
+
+// Derives a stochastic 3D tree and bakes its oriented segments into one mesh.
+void TreeTemplateCache::buildParametric(TreeTemplate &t) {
+    // grammar = "axiom;rule;rule", compiled once and shared by every seed
+    auto prog = m_programs.find(t.key.grammar);
+    if (prog == m_programs.end()) {
+        std::string axiom;
+        std::vector<std::string> rules;
+        std::stringstream ss(t.key.grammar);
+        std::string part;
+        bool first = true;
+        while (std::getline(ss, part, ';')) {
+            if (first) {
+                axiom = part;
+                first = false;
+            } else if (!part.empty()) {
+                rules.push_back(part);
+            }
+        }
+
+        ParametricLSystem lsys;
+        if (!lsys.compile(axiom, rules)) {
+            std::cerr << "[TreeTemplateCache] invalid grammar, tree left empty" << std::endl;
+        }
+        prog = m_programs.emplace(t.key.grammar, std::move(lsys)).first;
+    }
+
+    ParametricLSystem::ModuleString modules;
+    prog->second.derive(t.key.iterations, t.key.seed, modules);
+
+    ParametricLSystem::TurtleSettings turtle;
+    turtle.stepLength = t.key.segH;
+    turtle.angleDeg   = t.key.angleDeg;
+
+    std::vector<ParametricLSystem::Segment> segments;
+    prog->second.interpret(modules, turtle, segments);
+    removeDuplicateSegments(segments);
+
+    const glm::vec3 barkColor(0.45f, 0.32f, 0.20f);
+    const glm::vec3 leafColor(0.30f, 0.62f, 0.28f);
+
+    const std::vector<float> &cubeData = unitCube();
+    const std::vector<float> &cylData  = unitCylinder();
+
+    t.mesh.clear();
+    for (const ParametricLSystem::Segment &seg : segments) {
+        // leaves are always blocky; branches use the requested shape
+        bool cyl = t.key.cylinders && !seg.leaf;
+        const std::vector<float> &unit = cyl ? cylData : cubeData;
+        glm::vec3 color = seg.leaf ? leafColor : barkColor;
+
+        // unit shape axes -> segment frame: x -> left, y -> heading, z -> up
+        glm::vec3 ax = seg.left    * seg.width;
+        glm::vec3 ay = seg.heading * seg.length;
+        glm::vec3 az = seg.up      * seg.width;
+        glm::vec3 origin = seg.start + 0.5f * ay;
+
+        for (size_t v = 0; v + 5 < unit.size(); v += 6) {
+            glm::vec3 local(unit[v], unit[v + 1], unit[v + 2]);
+            glm::vec3 p = origin + ax * local.x + ay * local.y + az * local.z;
+
+            // inverse-transpose of the (orthogonal, scaled) frame
+            glm::vec3 n = glm::normalize(seg.left    * (unit[v + 3] / seg.width) +
+                                         seg.heading * (unit[v + 4] / seg.length) +
+                                         seg.up      * (unit[v + 5] / seg.width));
+
+            // cylinders get a centered block position so no blocky margin is drawn
+            glm::vec3 b = cyl ? glm::vec3(0.f) : local;
+
+            t.mesh.insert(t.mesh.end(), {
+                p.x, p.y, p.z,
+                n.x, n.y, n.z,
+                b.x, b.y, b.z,
+                color.r, color.g, color.b
+            });
+        }
+    }
+
+    t.vertexCount = static_cast<int>(t.mesh.size() / kFloatsPerVertex);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "cubeinstance.h"
+#include "parametriclsystem.h"
+
+// Identifies one tree shape. Two plants with the same key are geometrically
+// identical, so their geometry is built once and reused through instancing.
+//
+// Bush:       grammar = "axiom;A=succ;B=succ" e.g. "X;X=F[+X]F[-X]FX;F=FF",
+//             the flat blocky turtle (segH tall trunks, horizStep side offsets)
+// Parametric: grammar = "axiom;rule;rule" in ParametricLSystem notation,
+//             3D turtle with segH as the default step and angleDeg as the
+//             default turn; seed picks the stochastic variant
+struct TreeTemplateKey {
+    enum class Engine { Bush, Parametric };
+
+    Engine      engine     = Engine::Bush;
+    std::string grammar;
+    int         iterations = 0;
+    float       segH       = 0.f;
+    float       horizStep  = 0.f;
+    float       angleDeg   = 0.f;
+    bool        cylinders  = false;   // parametric: cylinder instead of cube segments
+    uint32_t    seed       = 0;
+
+    bool operator==(const TreeTemplateKey &o) const {
+        return engine == o.engine && grammar == o.grammar && iterations == o.iterations &&
+               segH == o.segH && horizStep == o.horizStep && angleDeg == o.angleDeg &&
+               cylinders == o.cylinders && seed == o.seed;
+    }
+};
+
+struct TreeTemplateKeyHash {
+    size_t operator()(const TreeTemplateKey &k) const;
+};
+
+// One placed copy of a template; uploaded as-is as a per-instance attribute
+struct TreeInstance {
+    glm::mat4 model;
+    glm::vec3 tint;
+};
+
+// Geometry of a tree in its own space (base at the origin)
+struct TreeTemplate {
+    TreeTemplateKey           key;
+    std::vector<CubeInstance> blocks;
+
+    // Merged mesh, layout per vertex:
+    //   [px, py, pz, nx, ny, nz, bx, by, bz, r, g, b]
+    // b = position inside the source unit cube ([-0.5, 0.5]^3) for the blocky margin
+    std::vector<float> mesh;
+    int                vertexCount = 0;
+
+    std::vector<TreeInstance> instances;
+    bool                      instancesDirty = true;
+};
+
+// Memoizes L-system trees: each distinct key is expanded and meshed once,
+// every additional plant only appends an instance.
+class TreeTemplateCache {
+public:
+    static constexpr int kFloatsPerVertex = 12;
+
+    // Returns the template id for key, building it on first use.
+    int getOrBuild(const TreeTemplateKey &key);
+
+    void addInstance(int id, const glm::mat4 &model, const glm::vec3 &tint);
+
+    // Drops every placed instance but keeps the memoized geometry.
+    void clearInstances();
+
+    std::vector<TreeTemplate>       &templates()       { return m_templates; }
+    const std::vector<TreeTemplate> &templates() const { return m_templates; }
+
+private:
+    void buildBlocks(TreeTemplate &t) const;
+    void buildMesh(TreeTemplate &t) const;
+    void buildParametric(TreeTemplate &t);
+
+    std::vector<TreeTemplate> m_templates;
+    std::unordered_map<std::string, ParametricLSystem> m_programs; // compiled once per grammar
+    std::unordered_map<TreeTemplateKey, int, TreeTemplateKeyHash> m_lookup;
+};
@@ -0,0 +1,40 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+constexpr size_t kMaxBlockBytes = 4 << 20;   // stop doubling at 4 MB
+
+} // namespace
+
+Arena::Arena(size_t firstBlockBytes)
+    : m_nextBlock(std::max<size_t>(firstBlockBytes, 1024)) {}
+
+Arena::~Arena() {
+    for (Cleanup *c = m_cleanups; c; c = c->next) {
+        c->destroy(c->object);
+    }
+    for (char *block : m_blocks) {
+        ::operator delete(block);
+    }
+}
+
+void *Arena::allocate(size_t bytes, size_t align) {
+    uintptr_t p = (reinterpret_cast<uintptr_t>(m_cursor) + (align - 1)) & ~uintptr_t(align - 1);
+    if (!m_cursor || p + bytes > reinterpret_cast<uintptr_t>(m_end)) {
+        // new block; oversized requests get one of their own
+        const size_t size = std::max(m_nextBlock, bytes + align);
+        char *block = static_cast<char *>(::operator new(size));
+        m_blocks.push_back(block);
+        m_cursor    = block;
+        m_end       = block + size;
+        m_reserved += size;
+        m_nextBlock = std::min(m_nextBlock * 2, kMaxBlockBytes);
+        p = (reinterpret_cast<uintptr_t>(m_cursor) + (align - 1)) & ~uintptr_t(align - 1);
+    }
+    m_cursor = reinterpret_cast<char *>(p + bytes);
+    m_used  += bytes;
+    return reinterpret_cast<void *>(p);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Monotonic (bump) allocator: objects are carved out of large blocks and
+// never freed one by one; everything goes at once when the arena dies.
+// Objects with non-trivial destructors (vectors, strings) get a small
+// cleanup record, and their destructors run in reverse creation order.
+class Arena {
+public:
+    explicit Arena(size_t firstBlockBytes = 64 * 1024);
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t bytes, size_t align);
+
+    template <typename T, typename... Args>
+    T *make(Args &&...args) {
+        if constexpr (std::is_trivially_destructible_v<T>) {
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        } else {
+            Cleanup *cleanup = static_cast<Cleanup *>(allocate(sizeof(Cleanup), alignof(Cleanup)));
+            T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            cleanup->destroy = [](void *p) { static_cast<T *>(p)->~T(); };
+            cleanup->object  = object;
+            cleanup->next    = m_cleanups;
+            m_cleanups = cleanup;
+            return object;
+        }
+    }
+
+    size_t bytesUsed()     const { return m_used; }
+    size_t bytesReserved() const { return m_reserved; }
+
+private:
+    struct Cleanup {
+        void   (*destroy)(void *);
+        void    *object;
+        Cleanup *next;
+    };
+
+    std::vector<char *> m_blocks;
+    char    *m_cursor    = nullptr;
+    char    *m_end       = nullptr;
+    size_t   m_nextBlock;
+    size_t   m_used      = 0;
+    size_t   m_reserved  = 0;
+    Cleanup *m_cleanups  = nullptr;
+};
@@ -23,6 +23,8 @@ public:
     const glm::mat4 &getProjMatrix()  const { return m_proj; }
     glm::vec3        getPosition()    const { return m_pos;  }
     glm::vec3        getLook()        const { return m_look; }
+    float            getNearPlane()   const { return m_near; }
+    float            getFarPlane()    const { return m_far;  }
 
 
     // Movement hooks
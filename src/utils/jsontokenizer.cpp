@@ -0,0 +1,348 @@
+#include "jsontokenizer.h"
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <locale>
+#include <sstream>
+
+namespace {
+
+constexpr size_t kBufferBytes = 1 << 20;
+
+bool isDigit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+int hexValue(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void appendUtf8(std::string &out, uint32_t code) {
+    if (code < 0x80) {
+        out += char(code);
+    } else if (code < 0x800) {
+        out += char(0xc0 | (code >> 6));
+        out += char(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        out += char(0xe0 | (code >> 12));
+        out += char(0x80 | ((code >> 6) & 0x3f));
+        out += char(0x80 | (code & 0x3f));
+    } else {
+        out += char(0xf0 | (code >> 18));
+        out += char(0x80 | ((code >> 12) & 0x3f));
+        out += char(0x80 | ((code >> 6) & 0x3f));
+        out += char(0x80 | (code & 0x3f));
+    }
+}
+
+} // namespace
+
+bool JsonTokenizer::open(const std::string &path) {
+    m_file.open(path, std::ios::binary);
+    if (!m_file) return false;
+
+    m_buffer.resize(kBufferBytes);
+    m_pos = m_len = 0;
+    m_stack.clear();
+    m_top    = State::Value;
+    m_error.clear();
+    m_line   = 1;
+    m_column = 1;
+    return true;
+}
+
+bool JsonTokenizer::refill() {
+    if (!m_file) return false;
+    m_file.read(m_buffer.data(), std::streamsize(m_buffer.size()));
+    m_len = size_t(m_file.gcount());
+    m_pos = 0;
+    return m_len > 0;
+}
+
+int JsonTokenizer::peekChar() {
+    if (m_pos == m_len && !refill()) return EOF;
+    return static_cast<unsigned char>(m_buffer[m_pos]);
+}
+
+int JsonTokenizer::getChar() {
+    const int c = peekChar();
+    if (c == EOF) return EOF;
+    m_pos++;
+    if (c == '\n') {
+        m_line++;
+        m_column = 1;
+    } else {
+        m_column++;
+    }
+    return c;
+}
+
+void JsonTokenizer::skipWhitespace() {
+    for (int c = peekChar(); c == ' ' || c == '\t' || c == '\n' || c == '\r'; c = peekChar()) {
+        getChar();
+    }
+}
+
+JsonTokenizer::Token JsonTokenizer::fail(const std::string &message) {
+    if (m_error.empty()) m_error = message;
+    return Token::Error;
+}
+
+void JsonTokenizer::valueDone() {
+    if (m_stack.empty()) m_top = State::Done;
+    else m_stack.back().state = State::CommaOrEnd;
+}
+
+JsonTokenizer::Token JsonTokenizer::next() {
+    if (!m_error.empty()) return Token::Error;
+    skipWhitespace();
+
+    State &state = m_stack.empty() ? m_top : m_stack.back().state;
+    switch (state) {
+    case State::Done:
+        if (peekChar() == EOF) return Token::End;
+        return fail("unexpected data after the document");
+
+    case State::Value:
+        return readValue(false);
+
+    case State::ValueOrEnd:
+        return readValue(true);
+
+    case State::KeyOrEnd:
+        if (peekChar() == '}') return closeContainer(getChar());
+        return readKey();
+
+    case State::Key:
+        return readKey();
+
+    case State::CommaOrEnd: {
+        const int c = getChar();
+        if (c == ',') {
+            state = m_stack.back().object ? State::Key : State::Value;
+            return next();
+        }
+        if (c == '}' || c == ']') return closeContainer(c);
+        return fail(c == EOF ? "unexpected end of file" : "expected ',' or a closing bracket");
+    }
+    }
+    return fail("invalid state");
+}
+
+JsonTokenizer::Token JsonTokenizer::closeContainer(int c) {
+    const bool object = m_stack.back().object;
+    if ((c == '}') != object) return fail("mismatched closing bracket");
+    m_stack.pop_back();
+    valueDone();
+    return object ? Token::EndObject : Token::EndArray;
+}
+
+JsonTokenizer::Token JsonTokenizer::readKey() {
+    if (peekChar() != '"') return fail("expected a key");
+    if (!readString()) return Token::Error;
+    skipWhitespace();
+    if (getChar() != ':') return fail("expected ':'");
+    m_stack.back().state = State::Value;
+    return Token::Key;
+}
+
+JsonTokenizer::Token JsonTokenizer::readValue(bool allowEnd) {
+    const int c = peekChar();
+    if (allowEnd && c == ']') return closeContainer(getChar());
+
+    switch (c) {
+    case '{':
+        getChar();
+        m_stack.push_back({true, State::KeyOrEnd});
+        return Token::BeginObject;
+    case '[':
+        getChar();
+        m_stack.push_back({false, State::ValueOrEnd});
+        return Token::BeginArray;
+    case '"':
+        if (!readString()) return Token::Error;
+        valueDone();
+        return Token::String;
+    case 't':
+        if (!readLiteral("true")) return Token::Error;
+        valueDone();
+        return Token::True;
+    case 'f':
+        if (!readLiteral("false")) return Token::Error;
+        valueDone();
+        return Token::False;
+    case 'n':
+        if (!readLiteral("null")) return Token::Error;
+        valueDone();
+        return Token::Null;
+    case EOF:
+        return fail("unexpected end of file");
+    default:
+        if (c == '-' || isDigit(c)) {
+            if (!readNumber()) return Token::Error;
+            valueDone();
+            return Token::Number;
+        }
+        return fail("unexpected character");
+    }
+}
+
+bool JsonTokenizer::readString() {
+    getChar();   // opening quote
+    m_text.clear();
+    for (;;) {
+        int c = getChar();
+        if (c == EOF) {
+            fail("unterminated string");
+            return false;
+        }
+        if (c == '"') return true;
+        if (c < 0x20) {
+            fail("control character in string");
+            return false;
+        }
+        if (c != '\\') {
+            m_text += char(c);
+            continue;
+        }
+
+        c = getChar();
+        switch (c) {
+        case '"':  m_text += '"';  break;
+        case '\\': m_text += '\\'; break;
+        case '/':  m_text += '/';  break;
+        case 'b':  m_text += '\b'; break;
+        case 'f':  m_text += '\f'; break;
+        case 'n':  m_text += '\n'; break;
+        case 'r':  m_text += '\r'; break;
+        case 't':  m_text += '\t'; break;
+        case 'u': {
+            auto readHex4 = [&](uint32_t &out) {
+                out = 0;
+                for (int i = 0; i < 4; ++i) {
+                    const int h = hexValue(getChar());
+                    if (h < 0) return false;
+                    out = out * 16 + uint32_t(h);
+                }
+                return true;
+            };
+            uint32_t code;
+            if (!readHex4(code)) {
+                fail("invalid \\u escape");
+                return false;
+            }
+            if (code >= 0xdc00 && code < 0xe000) {
+                fail("unpaired low surrogate");
+                return false;
+            }
+            if (code >= 0xd800 && code < 0xdc00) {
+                uint32_t low;
+                if (getChar() != '\\' || getChar() != 'u' || !readHex4(low) || low < 0xdc00 || low >= 0xe000) {
+                    fail("invalid surrogate pair");
+                    return false;
+                }
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+            }
+            appendUtf8(m_text, code);
+            break;
+        }
+        default:
+            fail("invalid escape in string");
+            return false;
+        }
+    }
+}
+
+bool JsonTokenizer::readNumber() {
+    char digits[64];
+    size_t n = 0;
+    for (int c = peekChar(); isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'; c = peekChar()) {
+        if (n == sizeof(digits)) {
+            fail("number too long");
+            return false;
+        }
+        digits[n++] = char(getChar());
+    }
+
+    // JSON's grammar is stricter than from_chars: -?(0|[1-9]d*)(.d+)?([eE][+-]?d+)?
+    size_t i = 0;
+    auto runOfDigits = [&]() {
+        const size_t start = i;
+        while (i < n && isDigit(digits[i])) i++;
+        return i > start;
+    };
+    bool ok = true;
+    if (i < n && digits[i] == '-') i++;
+    if (i < n && digits[i] == '0') i++;
+    else ok = runOfDigits();
+    if (ok && i < n && digits[i] == '.') {
+        i++;
+        ok = runOfDigits();
+    }
+    if (ok && i < n && (digits[i] == 'e' || digits[i] == 'E')) {
+        i++;
+        if (i < n && (digits[i] == '+' || digits[i] == '-')) i++;
+        ok = runOfDigits();
+    }
+    if (!ok || i != n) {
+        fail("invalid number");
+        return false;
+    }
+
+#if defined(__cpp_lib_to_chars)
+    const auto result = std::from_chars(digits, digits + n, m_number);
+    if (result.ec != std::errc()) {
+        fail("number out of range");
+        return false;
+    }
+#else
+    // no floating-point from_chars (older Apple libc++); the classic locale
+    // keeps '.' the decimal point whatever the C locale is
+    std::istringstream in(std::string(digits, n));
+    in.imbue(std::locale::classic());
+    if (!(in >> m_number)) {
+        fail("number out of range");
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool JsonTokenizer::readLiteral(const char *word) {
+    for (const char *p = word; *p; ++p) {
+        if (getChar() != *p) {
+            fail("invalid literal");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonTokenizer::skip(Token first) {
+    if (first == Token::Error || first == Token::End) return false;
+    if (first != Token::BeginObject && first != Token::BeginArray) return true;
+
+    int depth = 1;
+    while (depth > 0) {
+        switch (next()) {
+        case Token::BeginObject:
+        case Token::BeginArray:
+            depth++;
+            break;
+        case Token::EndObject:
+        case Token::EndArray:
+            depth--;
+            break;
+        case Token::Error:
+        case Token::End:
+            return false;
+        default:
+            break;
+        }
+    }
+    return true;
+}
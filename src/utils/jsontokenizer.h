@@ -0,0 +1,74 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Pull tokenizer for JSON, read through a fixed-size window so a file of any
+// size is tokenized in bounded memory. Structure is checked as it goes
+// (commas, colons, matching brackets, one top-level value), so callers only
+// see well-formed token sequences up to the first Error:
+//
+//   {"a": [1, "x"]}  ->  BeginObject Key(a) BeginArray Number String
+//                        EndArray EndObject End
+class JsonTokenizer {
+public:
+    enum class Token {
+        BeginObject, EndObject, BeginArray, EndArray,
+        Key, String, Number, True, False, Null,
+        End, Error
+    };
+
+    bool open(const std::string &path);
+
+    Token next();
+
+    // Skips the rest of the value whose first token was just returned by
+    // next(); a no-op for scalars.
+    bool skip(Token first);
+
+    // Key and String tokens, UTF-8
+    const std::string &text()   const { return m_text; }
+    double             number() const { return m_number; }
+
+    // set once next() returns Error
+    const std::string &error()  const { return m_error; }
+    int                line()   const { return m_line; }
+    int                column() const { return m_column; }
+
+private:
+    enum class State { Value, ValueOrEnd, Key, KeyOrEnd, CommaOrEnd, Done };
+
+    struct Frame {
+        bool  object;
+        State state;
+    };
+
+    int  peekChar();
+    int  getChar();
+    bool refill();
+    void skipWhitespace();
+
+    Token fail(const std::string &message);
+    Token readValue(bool allowEnd);
+    Token readKey();
+    Token closeContainer(int c);
+    bool  readString();
+    bool  readNumber();
+    bool  readLiteral(const char *word);
+    void  valueDone();
+
+    std::ifstream     m_file;
+    std::vector<char> m_buffer;
+    size_t            m_pos = 0;
+    size_t            m_len = 0;
+
+    std::vector<Frame> m_stack;
+    State              m_top = State::Value;   // outside any container
+
+    std::string m_text;
+    double      m_number = 0.0;
+    std::string m_error;
+    int         m_line   = 1;
+    int         m_column = 1;
+};
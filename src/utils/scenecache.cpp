@@ -0,0 +1,325 @@
+#include "scenecache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#include "mappedfile.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'S', 'C', 'N', 'C'};
+
+struct FileMapRecord {
+    uint32_t isUsed;
+    float    repeatU;
+    float    repeatV;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+struct MaterialRecord {
+    glm::vec4     cAmbient, cDiffuse, cSpecular;
+    glm::vec4     cReflective, cTransparent, cEmissive;
+    float         shininess;
+    float         ior;
+    float         blend;
+    FileMapRecord textureMap;
+    FileMapRecord bumpMap;
+};
+
+struct StringRecord {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// shapes [firstShape, firstShape + shapeCount) of the shape array
+struct PrototypeRecord {
+    uint32_t firstShape;
+    uint32_t shapeCount;
+};
+
+struct FileHeader {
+    char            magic[4];
+    uint32_t        version;
+    uint64_t        sourceHash;
+    uint32_t        lightSize;     // sizeof(SceneLightData) when written
+    uint32_t        shapeSize;     // sizeof(RenderShapeData)
+    uint32_t        instanceSize;  // sizeof(RenderInstanceData)
+    uint32_t        materialSize;  // sizeof(MaterialRecord)
+    uint32_t        lightCount;
+    uint32_t        shapeCount;    // scene shapes, then every prototype's
+    uint32_t        sceneShapeCount;
+    uint32_t        prototypeCount;
+    uint32_t        instanceCount;
+    uint32_t        materialCount;
+    uint32_t        pathCount;
+    uint64_t        stringBytes;
+    uint64_t        lightsOffset;
+    uint64_t        shapesOffset;
+    uint64_t        prototypesOffset;
+    uint64_t        instancesOffset;
+    uint64_t        materialsOffset;
+    uint64_t        pathsOffset;
+    uint64_t        stringsOffset;
+    uint64_t        fileSize;
+    SceneGlobalData globalData;
+    SceneCameraData cameraData;
+};
+
+static_assert(std::is_trivially_copyable_v<SceneLightData>,     "lights are stored as raw bytes");
+static_assert(std::is_trivially_copyable_v<RenderShapeData>,    "shapes are stored as raw bytes");
+static_assert(std::is_trivially_copyable_v<RenderInstanceData>, "instances are stored as raw bytes");
+static_assert(std::is_trivially_copyable_v<SceneGlobalData>,    "stored as raw bytes");
+static_assert(std::is_trivially_copyable_v<SceneCameraData>,    "stored as raw bytes");
+
+uint64_t align16(uint64_t v) {
+    return (v + 15) & ~uint64_t(15);
+}
+
+} // namespace
+
+uint64_t SceneCache::sourceHash(const std::string &scenePath) {
+    MappedFile file(scenePath);
+    if (!file.valid()) return 0;
+    uint64_t h = hashBytes(scenePath.data(), scenePath.size(), kVersion);
+    return hashBytes(file.data(), file.size(), h);
+}
+
+bool SceneCache::load(const std::string &scenePath, uint64_t sourceHash, RenderData &out) {
+    MappedFile file(cachePath(scenePath));
+    if (!file.valid() || file.size() < sizeof(FileHeader)) return false;
+
+    const char  *data = file.data();
+    const size_t size = file.size();
+
+    FileHeader h;
+    std::memcpy(&h, data, sizeof(h));
+    if (std::memcmp(h.magic, kMagic, 4) != 0 || h.version != kVersion || h.sourceHash != sourceHash ||
+        h.lightSize != sizeof(SceneLightData) || h.shapeSize != sizeof(RenderShapeData) ||
+        h.instanceSize != sizeof(RenderInstanceData) || h.materialSize != sizeof(MaterialRecord) ||
+        h.fileSize != size || h.sceneShapeCount > h.shapeCount) {
+        return false;
+    }
+
+    auto fits = [&](uint64_t offset, uint64_t bytes) {
+        return offset <= size && bytes <= size - offset;
+    };
+    if (!fits(h.lightsOffset, uint64_t(h.lightCount) * sizeof(SceneLightData)) ||
+        !fits(h.shapesOffset, uint64_t(h.shapeCount) * sizeof(RenderShapeData)) ||
+        !fits(h.prototypesOffset, uint64_t(h.prototypeCount) * sizeof(PrototypeRecord)) ||
+        !fits(h.instancesOffset, uint64_t(h.instanceCount) * sizeof(RenderInstanceData)) ||
+        !fits(h.materialsOffset, uint64_t(h.materialCount) * sizeof(MaterialRecord)) ||
+        !fits(h.pathsOffset, uint64_t(h.pathCount) * sizeof(StringRecord)) ||
+        !fits(h.stringsOffset, h.stringBytes)) {
+        return false;
+    }
+
+    const char *strings = data + h.stringsOffset;
+    bool stringsOk = true;
+    auto string = [&](uint32_t offset, uint32_t length) {
+        if (uint64_t(offset) + length > h.stringBytes) {
+            stringsOk = false;
+            return std::string();
+        }
+        return std::string(strings + offset, length);
+    };
+    auto fileMap = [&](const FileMapRecord &r) {
+        SceneFileMap m;
+        m.isUsed   = r.isUsed != 0;
+        m.repeatU  = r.repeatU;
+        m.repeatV  = r.repeatV;
+        m.filename = string(r.nameOffset, r.nameLength);
+        return m;
+    };
+
+    RenderData loaded;
+    loaded.globalData = h.globalData;
+    loaded.cameraData = h.cameraData;
+
+    loaded.lights.resize(h.lightCount);
+    if (h.lightCount) {
+        std::memcpy(loaded.lights.data(), data + h.lightsOffset, h.lightCount * sizeof(SceneLightData));
+    }
+    for (const SceneLightData &l : loaded.lights) {
+        const int type = static_cast<int>(l.type);
+        if (type < int(LightType::LIGHT_POINT) || type > int(LightType::LIGHT_SPOT)) return false;
+    }
+
+    loaded.materials.resize(h.materialCount);
+    for (uint32_t i = 0; i < h.materialCount; ++i) {
+        MaterialRecord r;
+        std::memcpy(&r, data + h.materialsOffset + uint64_t(i) * sizeof(MaterialRecord), sizeof(r));
+
+        SceneMaterial &m = loaded.materials[i];
+        m.cAmbient     = r.cAmbient;
+        m.cDiffuse     = r.cDiffuse;
+        m.cSpecular    = r.cSpecular;
+        m.shininess    = r.shininess;
+        m.cReflective  = r.cReflective;
+        m.cTransparent = r.cTransparent;
+        m.ior          = r.ior;
+        m.textureMap   = fileMap(r.textureMap);
+        m.blend        = r.blend;
+        m.cEmissive    = r.cEmissive;
+        m.bumpMap      = fileMap(r.bumpMap);
+    }
+
+    loaded.paths.resize(h.pathCount);
+    for (uint32_t i = 0; i < h.pathCount; ++i) {
+        StringRecord r;
+        std::memcpy(&r, data + h.pathsOffset + uint64_t(i) * sizeof(StringRecord), sizeof(r));
+        loaded.paths[i] = string(r.offset, r.length);
+    }
+    if (!stringsOk) return false;
+
+    // shapes and instances are copied as-is, then their types and indices
+    // checked
+    const RenderShapeData *shapes = reinterpret_cast<const RenderShapeData *>(data + h.shapesOffset);
+    auto copyShapes = [&](std::vector<RenderShapeData> &to, uint32_t first, uint32_t count) {
+        to.resize(count);
+        if (count) std::memcpy(to.data(), shapes + first, count * sizeof(RenderShapeData));
+        for (const RenderShapeData &s : to) {
+            const int type = static_cast<int>(s.type);
+            if (type < int(PrimitiveType::PRIMITIVE_CUBE) || type > int(PrimitiveType::PRIMITIVE_MESH) ||
+                s.material >= h.materialCount || s.meshfile >= h.pathCount) {
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!copyShapes(loaded.shapes, 0, h.sceneShapeCount)) return false;
+
+    loaded.prototypes.resize(h.prototypeCount);
+    for (uint32_t p = 0; p < h.prototypeCount; ++p) {
+        PrototypeRecord r;
+        std::memcpy(&r, data + h.prototypesOffset + uint64_t(p) * sizeof(PrototypeRecord), sizeof(r));
+        if (r.firstShape < h.sceneShapeCount || uint64_t(r.firstShape) + r.shapeCount > h.shapeCount ||
+            !copyShapes(loaded.prototypes[p].shapes, r.firstShape, r.shapeCount)) {
+            return false;
+        }
+    }
+
+    loaded.instances.resize(h.instanceCount);
+    if (h.instanceCount) {
+        std::memcpy(loaded.instances.data(), data + h.instancesOffset, h.instanceCount * sizeof(RenderInstanceData));
+    }
+    for (const RenderInstanceData &inst : loaded.instances) {
+        if (inst.prototype >= h.prototypeCount) return false;
+    }
+
+    out = std::move(loaded);
+    return true;
+}
+
+bool SceneCache::store(const std::string &scenePath, uint64_t sourceHash, const RenderData &data) {
+    std::string strings;
+    auto addString = [&](const std::string &s, uint32_t &offset, uint32_t &length) {
+        offset = uint32_t(strings.size());
+        length = uint32_t(s.size());
+        strings += s;
+    };
+    auto fileMap = [&](const SceneFileMap &m, FileMapRecord &r) {
+        r.isUsed  = m.isUsed ? 1 : 0;
+        r.repeatU = m.repeatU;
+        r.repeatV = m.repeatV;
+        addString(m.filename, r.nameOffset, r.nameLength);
+    };
+
+    std::vector<MaterialRecord> materials(data.materials.size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+        const SceneMaterial &m = data.materials[i];
+        MaterialRecord      &r = materials[i];
+        std::memset(&r, 0, sizeof(r));   // no stray padding bytes in the file
+        r.cAmbient     = m.cAmbient;
+        r.cDiffuse     = m.cDiffuse;
+        r.cSpecular    = m.cSpecular;
+        r.shininess    = m.shininess;
+        r.cReflective  = m.cReflective;
+        r.cTransparent = m.cTransparent;
+        r.ior          = m.ior;
+        r.blend        = m.blend;
+        r.cEmissive    = m.cEmissive;
+        fileMap(m.textureMap, r.textureMap);
+        fileMap(m.bumpMap, r.bumpMap);
+    }
+
+    std::vector<StringRecord> paths(data.paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        addString(data.paths[i], paths[i].offset, paths[i].length);
+    }
+
+    // scene shapes, then each prototype's
+    std::vector<RenderShapeData> shapes(data.shapes);
+    std::vector<PrototypeRecord> prototypes;
+    for (const RenderPrototype &p : data.prototypes) {
+        prototypes.push_back({uint32_t(shapes.size()), uint32_t(p.shapes.size())});
+        shapes.insert(shapes.end(), p.shapes.begin(), p.shapes.end());
+    }
+
+    FileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kMagic, 4);
+    h.version         = kVersion;
+    h.sourceHash      = sourceHash;
+    h.lightSize       = sizeof(SceneLightData);
+    h.shapeSize       = sizeof(RenderShapeData);
+    h.instanceSize    = sizeof(RenderInstanceData);
+    h.materialSize    = sizeof(MaterialRecord);
+    h.lightCount      = uint32_t(data.lights.size());
+    h.shapeCount      = uint32_t(shapes.size());
+    h.sceneShapeCount = uint32_t(data.shapes.size());
+    h.prototypeCount  = uint32_t(prototypes.size());
+    h.instanceCount   = uint32_t(data.instances.size());
+    h.materialCount   = uint32_t(materials.size());
+    h.pathCount       = uint32_t(paths.size());
+    h.stringBytes     = strings.size();
+    h.globalData      = data.globalData;
+    h.cameraData      = data.cameraData;
+    h.lightsOffset     = align16(sizeof(FileHeader));
+    h.shapesOffset     = align16(h.lightsOffset + data.lights.size() * sizeof(SceneLightData));
+    h.prototypesOffset = align16(h.shapesOffset + shapes.size() * sizeof(RenderShapeData));
+    h.instancesOffset  = align16(h.prototypesOffset + prototypes.size() * sizeof(PrototypeRecord));
+    h.materialsOffset  = align16(h.instancesOffset + data.instances.size() * sizeof(RenderInstanceData));
+    h.pathsOffset      = align16(h.materialsOffset + materials.size() * sizeof(MaterialRecord));
+    h.stringsOffset    = align16(h.pathsOffset + paths.size() * sizeof(StringRecord));
+    h.fileSize         = h.stringsOffset + strings.size();
+
+    // written beside the target and renamed, like the mesh cache
+    const std::string path = cachePath(scenePath);
+    const std::string tmp  = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[SceneCache] can't write " << tmp << std::endl;
+            return false;
+        }
+        auto writeAt = [&](uint64_t offset, const void *bytes, uint64_t count) {
+            static const char zeros[16] = {};
+            out.write(zeros, std::streamsize(offset - uint64_t(out.tellp())));
+            out.write(static_cast<const char*>(bytes), std::streamsize(count));
+        };
+        writeAt(0, &h, sizeof(h));
+        writeAt(h.lightsOffset,     data.lights.data(), data.lights.size() * sizeof(SceneLightData));
+        writeAt(h.shapesOffset,     shapes.data(), shapes.size() * sizeof(RenderShapeData));
+        writeAt(h.prototypesOffset, prototypes.data(), prototypes.size() * sizeof(PrototypeRecord));
+        writeAt(h.instancesOffset,  data.instances.data(), data.instances.size() * sizeof(RenderInstanceData));
+        writeAt(h.materialsOffset,  materials.data(), materials.size() * sizeof(MaterialRecord));
+        writeAt(h.pathsOffset,      paths.data(), paths.size() * sizeof(StringRecord));
+        writeAt(h.stringsOffset,    strings.data(), strings.size());
+        if (!out) {
+            std::cerr << "[SceneCache] write to " << tmp << " failed" << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "sceneparser.h"
+
+// Binary snapshot of a parsed, flattened scene, stored next to the
+// scenefile as "<scenefile>.cache":
+//
+//   header      magic, version, source hash, record sizes, counts,
+//               offsets, global + camera data
+//   lights      SceneLightData[], copied as-is
+//   shapes      RenderShapeData[], copied as-is: scene shapes, then each
+//               prototype's
+//   prototypes  range of the shapes per template group
+//   instances   RenderInstanceData[], copied as-is
+//   materials   fixed-size records; texture names are offset + length into
+//               the string blob
+//   paths       offset + length into the string blob
+//   strings     mesh and texture file names
+//
+// The source hash covers the scenefile's bytes and its path (mesh paths are
+// resolved relative to it), so editing or moving the scene invalidates the
+// snapshot. Anything that doesn't validate is a miss.
+class SceneCache {
+public:
+    static constexpr uint32_t kVersion = 3;
+
+    static std::string cachePath(const std::string &scenePath) { return scenePath + ".cache"; }
+
+    // 0 if the scenefile can't be read
+    static uint64_t sourceHash(const std::string &scenePath);
+
+    static bool load(const std::string &scenePath, uint64_t sourceHash, RenderData &out);
+    static bool store(const std::string &scenePath, uint64_t sourceHash, const RenderData &data);
+};
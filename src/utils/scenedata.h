@@ -166,4 +166,5 @@ struct SceneNode {
     std::vector<ScenePrimitive*> primitives;
     std::vector<SceneLight*> lights;
     std::vector<SceneNode*> children;
+    int templateIndex = -1; // >= 0 on a templateGroup's root, see ScenefileReader::getTemplateNodes
 };
@@ -24,32 +24,14 @@ ScenefileReader::ScenefileReader(const std::string &name) {
     memset(&m_cameraData, 0, sizeof(SceneCameraData));
     memset(&m_globalData, 0, sizeof(SceneGlobalData));
 
-    m_root = new SceneNode;
+    m_root = m_arena.make<SceneNode>();
 
     m_templates.clear();
-    m_nodes.clear();
-
-    m_nodes.push_back(m_root);
+    m_templateNodes.clear();
 }
 
 ScenefileReader::~ScenefileReader() {
-    // Delete all Scene Nodes
-    for (unsigned int node = 0; node < m_nodes.size(); node++) {
-        for (size_t i = 0; i < (m_nodes[node])->transformations.size(); i++)
-        {
-            delete (m_nodes[node])->transformations[i];
-        }
-        for (size_t i = 0; i < (m_nodes[node])->primitives.size(); i++)
-        {
-            delete (m_nodes[node])->primitives[i];
-        }
-        (m_nodes[node])->transformations.clear();
-        (m_nodes[node])->primitives.clear();
-        (m_nodes[node])->children.clear();
-        delete m_nodes[node];
-    }
-
-    m_nodes.clear();
+    // the graph itself goes with m_arena, in one shot
     m_templates.clear();
 }
 
@@ -144,6 +126,316 @@ bool ScenefileReader::readJSON() {
     return true;
 }
 
+namespace {
+
+using Token = JsonTokenizer::Token;
+
+bool streamError(const JsonTokenizer &tokens) {
+    std::cout << "parse error at line " << tokens.line() << " col " << tokens.column() << ": "
+              << tokens.error() << std::endl;
+    return false;
+}
+
+// Builds the value whose first token was just read. Only used for objects
+// small enough to go through the readJSON checks as they are (primitives,
+// lights, camera, templates), never for a whole group tree.
+bool readValue(JsonTokenizer &tokens, Token first, QJsonValue &out) {
+    switch (first) {
+    case Token::BeginObject: {
+        QJsonObject object;
+        for (Token t = tokens.next(); t != Token::EndObject; t = tokens.next()) {
+            if (t != Token::Key) return false;
+            const QString key = QString::fromStdString(tokens.text());
+            QJsonValue value;
+            if (!readValue(tokens, tokens.next(), value)) return false;
+            object.insert(key, value);
+        }
+        out = object;
+        return true;
+    }
+    case Token::BeginArray: {
+        QJsonArray array;
+        for (Token t = tokens.next(); t != Token::EndArray; t = tokens.next()) {
+            QJsonValue value;
+            if (!readValue(tokens, t, value)) return false;
+            array.append(value);
+        }
+        out = array;
+        return true;
+    }
+    case Token::String:
+        out = QString::fromStdString(tokens.text());
+        return true;
+    case Token::Number:
+        out = tokens.number();
+        return true;
+    case Token::True:
+    case Token::False:
+        out = first == Token::True;
+        return true;
+    case Token::Null:
+        out = QJsonValue(QJsonValue::Null);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Skips the remaining fields of the object being read, up to its '}'.
+bool skipFields(JsonTokenizer &tokens) {
+    Token t;
+    while ((t = tokens.next()) == Token::Key) {
+        if (!tokens.skip(tokens.next())) return false;
+    }
+    return t == Token::EndObject;
+}
+
+} // namespace
+
+bool ScenefileReader::streamJSON(SceneStreamHandler &handler) {
+    JsonTokenizer tokens;
+    if (!tokens.open(file_name)) {
+        std::cout << "could not open " << file_name << std::endl;
+        return false;
+    }
+
+    Token t = tokens.next();
+    if (t != Token::BeginObject) {
+        if (t == Token::Error) return streamError(tokens);
+        std::cout << "document is not an object" << std::endl;
+        return false;
+    }
+
+    bool hasGlobalData = false;
+    bool hasCameraData = false;
+    bool hasGroups = false;
+    while ((t = tokens.next()) == Token::Key) {
+        const std::string field = tokens.text();
+        const Token first = tokens.next();
+
+        if (field == "globalData") {
+            QJsonValue value;
+            if (!readValue(tokens, first, value)) return streamError(tokens);
+            if (!parseGlobalData(value.toObject())) {
+                std::cout << "could not parse \"globalData\"" << std::endl;
+                return false;
+            }
+            hasGlobalData = true;
+        }
+        else if (field == "cameraData") {
+            QJsonValue value;
+            if (!readValue(tokens, first, value)) return streamError(tokens);
+            if (!parseCameraData(value.toObject())) {
+                std::cout << "could not parse \"cameraData\"" << std::endl;
+                return false;
+            }
+            hasCameraData = true;
+        }
+        else if (field == "templateGroups") {
+            // groups already handed out may have named one of these
+            if (hasGroups) {
+                std::cout << "templateGroups must come before groups to stream " << file_name << std::endl;
+                return false;
+            }
+            QJsonValue value;
+            if (!readValue(tokens, first, value)) return streamError(tokens);
+            if (!parseTemplateGroups(value)) {
+                return false;
+            }
+        }
+        else if (field == "groups") {
+            hasGroups = true;
+            if (!streamGroups(tokens, first, handler)) {
+                return false;
+            }
+        }
+        else if (field == "name") {
+            if (!tokens.skip(first)) return streamError(tokens);
+        }
+        else {
+            std::cout << "unknown field \"" << field << "\" on root object" << std::endl;
+            return false;
+        }
+    }
+    if (t != Token::EndObject || tokens.next() != Token::End) {
+        return streamError(tokens);
+    }
+
+    if (!hasGlobalData) {
+        std::cout << "missing required field \"globalData\" on root object" << std::endl;
+        return false;
+    }
+    if (!hasCameraData) {
+        std::cout << "missing required field \"cameraData\" on root object" << std::endl;
+        return false;
+    }
+
+    std::cout << "Finished streaming " << file_name << std::endl;
+    return true;
+}
+
+bool ScenefileReader::streamGroups(JsonTokenizer &tokens, Token first, SceneStreamHandler &handler) {
+    if (first != Token::BeginArray) {
+        if (first == Token::Error) return streamError(tokens);
+        std::cout << "groups must be of type array" << std::endl;
+        return false;
+    }
+
+    for (Token t = tokens.next(); t != Token::EndArray; t = tokens.next()) {
+        if (t != Token::BeginObject) {
+            if (t == Token::Error) return streamError(tokens);
+            std::cout << "group items must be of type object" << std::endl;
+            return false;
+        }
+        if (!streamGroup(tokens, handler)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Stream one group object, whose '{' has just been read. The group is opened
+ * on the handler at its first light, primitive or child group, by which
+ * point its transforms have all been seen. Its own lights and primitives
+ * must come before its child groups, so they reach the handler in the order
+ * parseGroupData's graph is flattened in.
+ */
+bool ScenefileReader::streamGroup(JsonTokenizer &tokens, SceneStreamHandler &handler) {
+    QJsonObject transforms;
+    bool opened = false;
+    bool childrenSeen = false;
+    auto open = [&]() {
+        std::vector<SceneTransformation> transformations;
+        if (!parseTransformations(transforms, transformations)) {
+            return false;
+        }
+        handler.beginGroup(transformations);
+        opened = true;
+        return true;
+    };
+
+    Token t;
+    while ((t = tokens.next()) == Token::Key) {
+        const std::string field = tokens.text();
+        const Token first = tokens.next();
+
+        if (field == "name") {
+            if (first != Token::String) {
+                if (first == Token::Error) return streamError(tokens);
+                std::cout << "group name must be of type string" << std::endl;
+                return false;
+            }
+
+            // if its a reference to a template group hand out an instance;
+            // like readJSON, the rest of the group is ignored
+            auto found = m_templates.find(tokens.text());
+            if (found == m_templates.end()) {
+                continue;
+            }
+            if (opened) {
+                std::cout << "group \"" << tokens.text() << "\" names a template after its contents; can't stream "
+                          << file_name << std::endl;
+                return false;
+            }
+            handler.instance(*found->second);
+            if (!skipFields(tokens)) return streamError(tokens);
+            return true;
+        }
+        else if (field == "translate" || field == "rotate" || field == "scale" || field == "matrix") {
+            if (opened) {
+                std::cout << "group " << field << " comes after the group's contents; can't stream "
+                          << file_name << std::endl;
+                return false;
+            }
+            QJsonValue value;
+            if (!readValue(tokens, first, value)) return streamError(tokens);
+            transforms.insert(QString::fromStdString(field), value);
+        }
+        else if (field == "lights" || field == "primitives" || field == "groups") {
+            if (childrenSeen && field != "groups") {
+                std::cout << "group " << field << " comes after the group's child groups; can't stream "
+                          << file_name << std::endl;
+                return false;
+            }
+            childrenSeen = childrenSeen || field == "groups";
+            if (!opened && !open()) {
+                return false;
+            }
+            const bool ok = field == "lights"     ? streamLights(tokens, first, handler)
+                          : field == "primitives" ? streamPrimitives(tokens, first, handler)
+                                                  : streamGroups(tokens, first, handler);
+            if (!ok) {
+                return false;
+            }
+        }
+        else {
+            std::cout << "unknown field \"" << field << "\" on group object" << std::endl;
+            return false;
+        }
+    }
+    if (t != Token::EndObject) return streamError(tokens);
+
+    if (!opened && !open()) {
+        return false;
+    }
+    handler.endGroup();
+    return true;
+}
+
+bool ScenefileReader::streamLights(JsonTokenizer &tokens, Token first, SceneStreamHandler &handler) {
+    if (first != Token::BeginArray) {
+        if (first == Token::Error) return streamError(tokens);
+        std::cout << "group lights must be of type array" << std::endl;
+        return false;
+    }
+
+    for (Token t = tokens.next(); t != Token::EndArray; t = tokens.next()) {
+        if (t != Token::BeginObject) {
+            if (t == Token::Error) return streamError(tokens);
+            std::cout << "light must be of type object" << std::endl;
+            return false;
+        }
+        QJsonValue value;
+        if (!readValue(tokens, t, value)) return streamError(tokens);
+
+        SceneLight light;
+        if (!parseLight(value.toObject(), &light)) {
+            return false;
+        }
+        handler.light(light);
+    }
+
+    return true;
+}
+
+bool ScenefileReader::streamPrimitives(JsonTokenizer &tokens, Token first, SceneStreamHandler &handler) {
+    if (first != Token::BeginArray) {
+        if (first == Token::Error) return streamError(tokens);
+        std::cout << "group primitives must be of type array" << std::endl;
+        return false;
+    }
+
+    for (Token t = tokens.next(); t != Token::EndArray; t = tokens.next()) {
+        if (t != Token::BeginObject) {
+            if (t == Token::Error) return streamError(tokens);
+            std::cout << "primitive must be of type object" << std::endl;
+            return false;
+        }
+        QJsonValue value;
+        if (!readValue(tokens, t, value)) return streamError(tokens);
+
+        ScenePrimitive primitive{};
+        if (!parsePrimitiveData(value.toObject(), &primitive)) {
+            return false;
+        }
+        handler.primitive(primitive);
+    }
+
+    return true;
+}
+
 /**
  * Parse a globalData field and fill in m_globalData.
  */
@@ -203,6 +495,15 @@ bool ScenefileReader::parseGlobalData(const QJsonObject &globalData) {
  * Parse a Light and add a new CS123SceneLightData to m_lights.
  */
 bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *node) {
+    SceneLight *light = m_arena.make<SceneLight>();
+    node->lights.push_back(light);
+    return parseLight(lightData, light);
+}
+
+/**
+ * Check a light object and fill in light.
+ */
+bool ScenefileReader::parseLight(const QJsonObject &lightData, SceneLight *light) {
     QStringList requiredFields = {"type", "color"};
     QStringList optionalFields = {"name", "attenuationCoeff", "direction", "penumbra", "angle"};
     QStringList allFields = requiredFields + optionalFields;
@@ -219,10 +520,8 @@ bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *no
         }
     }
 
-    // Create a default light
-    SceneLight *light = new SceneLight();
+    // Start from a default light
     memset(light, 0, sizeof(SceneLight));
-    node->lights.push_back(light);
 
     light->dir = glm::vec4(0.f, 0.f, 0.f, 0.f);
     light->function = glm::vec3(1, 0, 0);
@@ -566,15 +865,16 @@ bool ScenefileReader::parseTemplateGroupData(const QJsonObject &templateGroup) {
         std::cout << "templateGroups cannot have the same" << std::endl;
     }
 
-    SceneNode *templateNode = new SceneNode;
-    m_nodes.push_back(templateNode);
+    SceneNode *templateNode = m_arena.make<SceneNode>();
+    templateNode->templateIndex = int(m_templateNodes.size());
     m_templates[templateGroup["name"].toString().toStdString()] = templateNode;
+    m_templateNodes.push_back(templateNode);
 
     return parseGroupData(templateGroup, templateNode);
 }
 
 /**
- * Parse a group object and create a new CS123SceneNode in m_nodes.
+ * Parse a group object and create a new CS123SceneNode in m_arena.
  * NAME OF NODE CANNOT REFERENCE TEMPLATE NODE
  */
 bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node) {
@@ -587,6 +887,66 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
         }
     }
 
+    std::vector<SceneTransformation> transformations;
+    if (!parseTransformations(object, transformations)) {
+        return false;
+    }
+    for (const SceneTransformation &transformation : transformations) {
+        node->transformations.push_back(m_arena.make<SceneTransformation>(transformation));
+    }
+
+    // parse lights if any
+    if (object.contains("lights")) {
+        if (!object["lights"].isArray()) {
+            std::cout << "group lights must be of type array" << std::endl;
+            return false;
+        }
+        QJsonArray lightsArray = object["lights"].toArray();
+        for (auto light : lightsArray) {
+            if (!light.isObject()) {
+                std::cout << "light must be of type object" << std::endl;
+                return false;
+            }
+
+            if (!parseLightData(light.toObject(), node)) {
+                return false;
+            }
+        }
+    }
+
+    // parse primitives if any
+    if (object.contains("primitives")) {
+        if (!object["primitives"].isArray()) {
+            std::cout << "group primitives must be of type array" << std::endl;
+            return false;
+        }
+        QJsonArray primitivesArray = object["primitives"].toArray();
+        for (auto primitive : primitivesArray) {
+            if (!primitive.isObject()) {
+                std::cout << "primitive must be of type object" << std::endl;
+                return false;
+            }
+
+            if (!parsePrimitive(primitive.toObject(), node)) {
+                return false;
+            }
+        }
+    }
+
+    // parse children groups if any
+    if (object.contains("groups")) {
+        if (!parseGroups(object["groups"], node)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Parse the translate, rotate, scale and matrix fields of a group, in that order.
+ */
+bool ScenefileReader::parseTransformations(const QJsonObject &object, std::vector<SceneTransformation> &transformations) {
     // parse translation if defined
     if (object.contains("translate")) {
         if (!object["translate"].isArray()) {
@@ -604,13 +964,13 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
             return false;
         }
 
-        SceneTransformation *translation = new SceneTransformation();
-        translation->type = TransformationType::TRANSFORMATION_TRANSLATE;
-        translation->translate.x = translateArray[0].toDouble();
-        translation->translate.y = translateArray[1].toDouble();
-        translation->translate.z = translateArray[2].toDouble();
+        SceneTransformation translation{};
+        translation.type = TransformationType::TRANSFORMATION_TRANSLATE;
+        translation.translate.x = translateArray[0].toDouble();
+        translation.translate.y = translateArray[1].toDouble();
+        translation.translate.z = translateArray[2].toDouble();
 
-        node->transformations.push_back(translation);
+        transformations.push_back(translation);
     }
 
     // parse rotation if defined
@@ -630,14 +990,14 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
             return false;
         }
 
-        SceneTransformation *rotation = new SceneTransformation();
-        rotation->type = TransformationType::TRANSFORMATION_ROTATE;
-        rotation->rotate.x = rotateArray[0].toDouble();
-        rotation->rotate.y = rotateArray[1].toDouble();
-        rotation->rotate.z = rotateArray[2].toDouble();
-        rotation->angle = rotateArray[3].toDouble() * M_PI / 180.f;
+        SceneTransformation rotation{};
+        rotation.type = TransformationType::TRANSFORMATION_ROTATE;
+        rotation.rotate.x = rotateArray[0].toDouble();
+        rotation.rotate.y = rotateArray[1].toDouble();
+        rotation.rotate.z = rotateArray[2].toDouble();
+        rotation.angle = rotateArray[3].toDouble() * M_PI / 180.f;
 
-        node->transformations.push_back(rotation);
+        transformations.push_back(rotation);
     }
 
     // parse scale if defined
@@ -657,13 +1017,13 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
             return false;
         }
 
-        SceneTransformation *scale = new SceneTransformation();
-        scale->type = TransformationType::TRANSFORMATION_SCALE;
-        scale->scale.x = scaleArray[0].toDouble();
-        scale->scale.y = scaleArray[1].toDouble();
-        scale->scale.z = scaleArray[2].toDouble();
+        SceneTransformation scale{};
+        scale.type = TransformationType::TRANSFORMATION_SCALE;
+        scale.scale.x = scaleArray[0].toDouble();
+        scale.scale.y = scaleArray[1].toDouble();
+        scale.scale.z = scaleArray[2].toDouble();
 
-        node->transformations.push_back(scale);
+        transformations.push_back(scale);
     }
 
     // parse matrix if defined
@@ -679,10 +1039,10 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
             return false;
         }
 
-        SceneTransformation *matrixTransformation = new SceneTransformation();
-        matrixTransformation->type = TransformationType::TRANSFORMATION_MATRIX;
+        SceneTransformation matrixTransformation{};
+        matrixTransformation.type = TransformationType::TRANSFORMATION_MATRIX;
 
-        float *matrixPtr = glm::value_ptr(matrixTransformation->matrix);
+        float *matrixPtr = glm::value_ptr(matrixTransformation.matrix);
         int rowIndex = 0;
         for (auto row : matrixArray) {
             if (!row.isArray()) {
@@ -710,52 +1070,7 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
             rowIndex++;
         }
 
-        node->transformations.push_back(matrixTransformation);
-    }
-
-    // parse lights if any
-    if (object.contains("lights")) {
-        if (!object["lights"].isArray()) {
-            std::cout << "group lights must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray lightsArray = object["lights"].toArray();
-        for (auto light : lightsArray) {
-            if (!light.isObject()) {
-                std::cout << "light must be of type object" << std::endl;
-                return false;
-            }
-
-            if (!parseLightData(light.toObject(), node)) {
-                return false;
-            }
-        }
-    }
-
-    // parse primitives if any
-    if (object.contains("primitives")) {
-        if (!object["primitives"].isArray()) {
-            std::cout << "group primitives must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray primitivesArray = object["primitives"].toArray();
-        for (auto primitive : primitivesArray) {
-            if (!primitive.isObject()) {
-                std::cout << "primitive must be of type object" << std::endl;
-                return false;
-            }
-
-            if (!parsePrimitive(primitive.toObject(), node)) {
-                return false;
-            }
-        }
-    }
-
-    // parse children groups if any
-    if (object.contains("groups")) {
-        if (!parseGroups(object["groups"], node)) {
-            return false;
-        }
+        transformations.push_back(matrixTransformation);
     }
 
     return true;
@@ -789,8 +1104,7 @@ bool ScenefileReader::parseGroups(const QJsonValue &groups, SceneNode *parent) {
             }
         }
 
-        SceneNode *node = new SceneNode;
-        m_nodes.push_back(node);
+        SceneNode *node = m_arena.make<SceneNode>();
         parent->children.push_back(node);
 
         if (!parseGroupData(group.toObject(), node)) {
@@ -805,6 +1119,15 @@ bool ScenefileReader::parseGroups(const QJsonValue &groups, SceneNode *parent) {
  * Parse an <object type="primitive"> tag into node.
  */
 bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
+    ScenePrimitive *primitive = m_arena.make<ScenePrimitive>();
+    node->primitives.push_back(primitive);
+    return parsePrimitiveData(prim, primitive);
+}
+
+/**
+ * Check a primitive object and fill in primitive.
+ */
+bool ScenefileReader::parsePrimitiveData(const QJsonObject &prim, ScenePrimitive *primitive) {
     QStringList requiredFields = {"type"};
     QStringList optionalFields = {
         "meshFile", "ambient", "diffuse", "specular", "reflective", "transparent", "shininess", "ior",
@@ -831,14 +1154,12 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
     std::string primType = prim["type"].toString().toStdString();
 
     // Default primitive
-    ScenePrimitive *primitive = new ScenePrimitive();
     SceneMaterial &mat = primitive->material;
     mat.clear();
     primitive->type = PrimitiveType::PRIMITIVE_CUBE;
     mat.textureMap.isUsed = false;
     mat.bumpMap.isUsed = false;
     mat.cDiffuse.r = mat.cDiffuse.g = mat.cDiffuse.b = 1;
-    node->primitives.push_back(primitive);
 
     std::filesystem::path basepath = std::filesystem::path(file_name).parent_path().parent_path();
     if (primType == "sphere")
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "scenedata.h"
+#include "arena.h"
+#include "jsontokenizer.h"
 
 #include <vector>
 #include <map>
@@ -8,6 +10,23 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 
+// Receives the scene from ScenefileReader::streamJSON as it is read. Groups
+// nest: every beginGroup is matched by an endGroup, and the primitives and
+// lights in between belong to the innermost open group.
+class SceneStreamHandler {
+public:
+    virtual ~SceneStreamHandler() = default;
+
+    virtual void beginGroup(const std::vector<SceneTransformation> &transformations) = 0;
+    virtual void endGroup() = 0;
+    virtual void primitive(const ScenePrimitive &primitive) = 0;
+    virtual void light(const SceneLight &light) = 0;
+
+    // A group naming a template group, in place of beginGroup/endGroup and
+    // the template's contents (ScenefileReader::getTemplateNodes has them).
+    virtual void instance(const SceneNode &templateRoot) = 0;
+};
+
 // This class parses the scene graph specified by the CS123 Xml file format.
 class ScenefileReader {
 public:
@@ -20,12 +39,32 @@ public:
     // Parse the XML scene file. Returns false if scene is invalid.
     bool readJSON();
 
+    // Alternative to readJSON for very large scenes: tokenizes the file
+    // through a fixed-size buffer and hands groups, primitives and lights to
+    // `handler` as each one completes, without building a QJsonDocument or
+    // the node graph. Objects go through the same checks as in readJSON.
+    //
+    // Needs the order every generator writes: templateGroups before groups,
+    // a group's name and transforms before its lights, primitives and
+    // groups, and its lights and primitives before its groups. Files that
+    // break it are rejected (use readJSON for them), so shapes and lights
+    // come out in the same order as from the flattened readJSON graph. On
+    // failure the handler may already have seen part of the scene.
+    bool streamJSON(SceneStreamHandler &handler);
+
     SceneGlobalData getGlobalData() const;
 
     SceneCameraData getCameraData() const;
 
     SceneNode *getRootNode() const;
 
+    // Roots of the template groups, by SceneNode::templateIndex. Groups that
+    // name a template share its root as their node, so the graph is a DAG.
+    const std::vector<SceneNode *> &getTemplateNodes() const { return m_templateNodes; }
+
+    // bytes taken by the node graph
+    size_t graphBytes() const { return m_arena.bytesUsed(); }
+
 private:
     // The filename should be contained within this parser implementation.
     // If you want to parse a new file, instantiate a different parser.
@@ -37,14 +76,26 @@ private:
     bool parseGroupData(const QJsonObject &object, SceneNode *node);
     bool parsePrimitive(const QJsonObject &prim, SceneNode *node);
     bool parseLightData(const QJsonObject &lightData, SceneNode *node);
+    bool parseTransformations(const QJsonObject &object, std::vector<SceneTransformation> &transformations);
+    bool parsePrimitiveData(const QJsonObject &prim, ScenePrimitive *primitive);
+    bool parseLight(const QJsonObject &lightData, SceneLight *light);
+
+    bool streamGroups(JsonTokenizer &tokens, JsonTokenizer::Token first, SceneStreamHandler &handler);
+    bool streamGroup(JsonTokenizer &tokens, SceneStreamHandler &handler);
+    bool streamLights(JsonTokenizer &tokens, JsonTokenizer::Token first, SceneStreamHandler &handler);
+    bool streamPrimitives(JsonTokenizer &tokens, JsonTokenizer::Token first, SceneStreamHandler &handler);
 
     std::string file_name;
 
     mutable std::map<std::string, SceneNode *> m_templates;
+    std::vector<SceneNode *> m_templateNodes;
 
     SceneGlobalData m_globalData;
     SceneCameraData m_cameraData;
 
+    // Every node, transformation, primitive and light of the graph; they
+    // are released together with the reader.
+    Arena m_arena;
+
     SceneNode *m_root;
-    std::vector<SceneNode *> m_nodes;
 };
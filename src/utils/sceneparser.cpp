@@ -1,9 +1,25 @@
 #include "sceneparser.h"
 #include "scenefilereader.h"
+#include "scenecache.h"
+#include "scenetables.h"
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// scenefiles at least this big are streamed rather than loaded whole
+static constexpr uintmax_t kStreamBytes = 32u << 20;
 
 
 
@@ -58,63 +74,420 @@ static SceneLightData makeLight(const SceneLight* L, const glm::mat4 &CTM) {
 }
 
 
-static void traverse(const SceneNode* node,
-                     const glm::mat4 &parentCTM,
-                     RenderData &out)
-{
-    // accumulate CTM
-    glm::mat4 M = parentCTM;
+// a * b for column-major 4x4 matrices: each column of the result is the
+// columns of a scaled by one column of b, four lanes at a time. Same
+// operation order as glm's operator* (bit-identical unless the compiler
+// fuses glm's multiply-adds, e.g. with -march=native).
+static glm::mat4 mulMat4(const glm::mat4 &a, const glm::mat4 &b) {
+#if defined(__SSE__) || defined(_M_X64)
+    const float *pa = glm::value_ptr(a);
+    const float *pb = glm::value_ptr(b);
+    const __m128 a0 = _mm_loadu_ps(pa);
+    const __m128 a1 = _mm_loadu_ps(pa + 4);
+    const __m128 a2 = _mm_loadu_ps(pa + 8);
+    const __m128 a3 = _mm_loadu_ps(pa + 12);
+
+    glm::mat4 c;
+    float *pc = glm::value_ptr(c);
+    for (int j = 0; j < 4; ++j) {
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(pb[4 * j]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(pb[4 * j + 1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(pb[4 * j + 2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(pb[4 * j + 3])));
+        _mm_storeu_ps(pc + 4 * j, r);
+    }
+    return c;
+#elif defined(__ARM_NEON)
+    const float *pa = glm::value_ptr(a);
+    const float *pb = glm::value_ptr(b);
+    const float32x4_t a0 = vld1q_f32(pa);
+    const float32x4_t a1 = vld1q_f32(pa + 4);
+    const float32x4_t a2 = vld1q_f32(pa + 8);
+    const float32x4_t a3 = vld1q_f32(pa + 12);
+
+    glm::mat4 c;
+    float *pc = glm::value_ptr(c);
+    for (int j = 0; j < 4; ++j) {
+        float32x4_t r = vmulq_n_f32(a0, pb[4 * j]);
+        r = vaddq_f32(r, vmulq_n_f32(a1, pb[4 * j + 1]));
+        r = vaddq_f32(r, vmulq_n_f32(a2, pb[4 * j + 2]));
+        r = vaddq_f32(r, vmulq_n_f32(a3, pb[4 * j + 3]));
+        vst1q_f32(pc + 4 * j, r);
+    }
+    return c;
+#else
+    return a * b;
+#endif
+}
+
+
+// A piece of the graph to flatten: a whole subtree, or (for nodes split
+// into their children) just the node's own primitives and lights.
+struct FlattenTask {
+    const SceneNode* node;
+    glm::mat4        parentCTM;
+    bool             ownOnly;
+    size_t           shapeAt;    // where its output starts in out.shapes
+    size_t           lightAt;    // in out.lights
+    size_t           instanceAt; // and in out.instances
+};
+
+struct FlattenCounts {
+    size_t shapes    = 0;
+    size_t lights    = 0;
+    size_t instances = 0;
+};
+
+// Where flattenNode writes; each pointer moves past what it wrote. Unless
+// `instancing`, template groups are expanded in place; a null `lights`
+// drops lights. Shapes' materials and paths go into `tables`.
+struct FlattenCursor {
+    RenderShapeData*    shapes;
+    SceneLightData*     lights;
+    RenderInstanceData* instances;
+    bool                instancing;
+    SceneTables*        tables;
+};
+
+static glm::mat4 nodeCTM(const SceneNode* node, const glm::mat4 &parentCTM) {
+    glm::mat4 local(1.f);
     for (const SceneTransformation* t : node->transformations) {
-        M = M * toMat(t);
+        local = mulMat4(local, toMat(t));
     }
+    return mulMat4(parentCTM, local);
+}
 
-    // primitives
-    for (const ScenePrimitive* p : node->primitives) {
-        RenderShapeData rs{};
-        rs.primitive = *p;   // copy primitive data
-        rs.ctm       = M;    // cumulative transform
-        out.shapes.push_back(rs);
+static void countSubtree(const SceneNode* node, bool instancing, FlattenCounts &counts) {
+    if (instancing && node->templateIndex >= 0) {
+        FlattenCounts expanded;
+        countSubtree(node, false, expanded);
+        counts.lights += expanded.lights;
+        counts.instances++;
+        return;
     }
 
-    // lights
-    for (const SceneLight* L : node->lights) {
-        out.lights.push_back(makeLight(L, M));
+    counts.shapes += node->primitives.size();
+    counts.lights += node->lights.size();
+    for (const SceneNode* child : node->children) {
+        countSubtree(child, instancing, counts);
     }
+}
 
-    // recurse on children
+static void flattenLights(const SceneNode* node, const glm::mat4 &parentCTM, SceneLightData* &at) {
+    const glm::mat4 M = nodeCTM(node, parentCTM);
+    for (const SceneLight* L : node->lights) {
+        *at++ = makeLight(L, M);
+    }
     for (const SceneNode* child : node->children) {
-        traverse(child, M, out);
+        flattenLights(child, M, at);
     }
 }
 
+// Writes node's primitives and lights at the cursor; if `recurse`, then
+// each child's subtree after them, depth-first. A template group becomes
+// one instance plus its lights.
+static void flattenNode(const SceneNode* node, const glm::mat4 &parentCTM, bool recurse, FlattenCursor &at) {
+    if (at.instancing && node->templateIndex >= 0) {
+        *at.instances++ = {uint32_t(node->templateIndex), parentCTM};
+        flattenLights(node, parentCTM, at.lights);
+        return;
+    }
 
+    const glm::mat4 M = nodeCTM(node, parentCTM);
 
-bool SceneParser::parse(std::string filepath, RenderData &renderData) {
+    for (const ScenePrimitive* p : node->primitives) {
+        RenderShapeData &rs = *at.shapes++;
+        rs.type     = p->type;
+        rs.material = at.tables->material(p->material);
+        rs.meshfile = at.tables->path(p->meshfile);
+        rs.ctm      = M;    // cumulative transform
+    }
+    if (at.lights) {
+        for (const SceneLight* L : node->lights) {
+            *at.lights++ = makeLight(L, M);
+        }
+    }
+
+    if (recurse) {
+        for (const SceneNode* child : node->children) {
+            flattenNode(child, M, true, at);
+        }
+    }
+}
+
+// Runs job(i) for i in [0, count) on up to `threads` threads.
+template <typename Job>
+static void runParallel(size_t count, size_t threads, const Job &job) {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            job(i);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < std::min(threads, count); ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &t : pool) {
+        t.join();
+    }
+}
+
+// One prototype per template group, each flattened once on its own.
+static void flattenTemplates(const std::vector<SceneNode*> &templates, SceneTables &tables, RenderData &out) {
+    out.prototypes.resize(templates.size());
+    for (size_t i = 0; i < templates.size(); ++i) {
+        FlattenCounts counts;
+        countSubtree(templates[i], false, counts);
+
+        std::vector<RenderShapeData> &shapes = out.prototypes[i].shapes;
+        shapes.resize(counts.shapes);
+        FlattenCursor at{shapes.data(), nullptr, nullptr, false, &tables};
+        flattenNode(templates[i], glm::mat4(1.f), true, at);
+    }
+}
+
+// Flattens the graph under root into out.shapes / out.lights /
+// out.instances, in the same order as a depth-first walk.
+//
+// A serial count of the whole graph sizes the output and picks the worker
+// count; small graphs are flattened serially as one task. Otherwise the top
+// of the tree is split, a level at a time, into a list of independent tasks
+// kept in output order (a split node becomes its own primitives and lights
+// followed by one task per child). Workers count each task's output, a
+// prefix sum gives every task its slot in the pre-sized arrays, and workers
+// then flatten the tasks straight into them. Each task interns into its own
+// tables, which are merged into `tables` in task order afterwards.
+static void flatten(const SceneNode* root, SceneTables &tables, RenderData &out) {
+    constexpr size_t kTasksPerCore = 8;
+    constexpr size_t kItemsPerThread = 4096;   // not worth another thread below this
+
+    FlattenCounts total;
+    countSubtree(root, true, total);
+    out.shapes.resize(total.shapes);
+    out.lights.resize(total.lights);
+    out.instances.resize(total.instances);
+
+    const size_t cores   = std::max(1u, std::thread::hardware_concurrency());
+    const size_t items   = total.shapes + total.lights + total.instances;
+    const size_t threads = std::min(cores, items / kItemsPerThread + 1);
+    if (threads == 1) {
+        FlattenCursor at{out.shapes.data(), out.lights.data(), out.instances.data(), true, &tables};
+        flattenNode(root, glm::mat4(1.f), true, at);
+        return;
+    }
+
+    std::vector<FlattenTask> tasks{{root, glm::mat4(1.f), false, 0, 0, 0}};
+    for (bool split = true; split && tasks.size() < threads * kTasksPerCore; ) {
+        split = false;
+        std::vector<FlattenTask> next;
+        for (const FlattenTask &task : tasks) {
+            if (task.ownOnly || task.node->children.empty() || task.node->templateIndex >= 0) {
+                next.push_back(task);
+                continue;
+            }
+            const glm::mat4 M = nodeCTM(task.node, task.parentCTM);
+            next.push_back({task.node, task.parentCTM, true, 0, 0, 0});
+            for (const SceneNode* child : task.node->children) {
+                next.push_back({child, M, false, 0, 0, 0});
+            }
+            split = true;
+        }
+        tasks.swap(next);
+    }
+
+    // sizes, then offsets
+    std::vector<FlattenCounts> counts(tasks.size());
+    runParallel(tasks.size(), threads, [&](size_t i) {
+        if (tasks[i].ownOnly) {
+            counts[i].shapes = tasks[i].node->primitives.size();
+            counts[i].lights = tasks[i].node->lights.size();
+        } else {
+            countSubtree(tasks[i].node, true, counts[i]);
+        }
+    });
+    FlattenCounts offset;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].shapeAt    = offset.shapes;
+        tasks[i].lightAt    = offset.lights;
+        tasks[i].instanceAt = offset.instances;
+        offset.shapes    += counts[i].shapes;
+        offset.lights    += counts[i].lights;
+        offset.instances += counts[i].instances;
+    }
+
+    std::vector<SceneTables> local(tasks.size());
+    runParallel(tasks.size(), threads, [&](size_t i) {
+        FlattenCursor at{out.shapes.data() + tasks[i].shapeAt,
+                         out.lights.data() + tasks[i].lightAt,
+                         out.instances.data() + tasks[i].instanceAt, true, &local[i]};
+        flattenNode(tasks[i].node, tasks[i].parentCTM, !tasks[i].ownOnly, at);
+    });
+
+    // task-local indices -> shared ones
+    std::vector<std::vector<uint32_t>> materials(tasks.size()), paths(tasks.size());
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        for (const SceneMaterial &m : local[i].materials()) {
+            materials[i].push_back(tables.material(m));
+        }
+        for (const std::string &p : local[i].paths()) {
+            paths[i].push_back(tables.path(p));
+        }
+    }
+    runParallel(tasks.size(), threads, [&](size_t i) {
+        for (size_t s = tasks[i].shapeAt; s < tasks[i].shapeAt + counts[i].shapes; ++s) {
+            out.shapes[s].material = materials[i][out.shapes[s].material];
+            out.shapes[s].meshfile = paths[i][out.shapes[s].meshfile];
+        }
+    });
+}
+
+
+// Same flattening as flatten(), fed by ScenefileReader::streamJSON.
+class FlattenHandler : public SceneStreamHandler {
+public:
+    FlattenHandler(RenderData &out, SceneTables &tables) : m_out(out), m_tables(tables) {}
+
+    void beginGroup(const std::vector<SceneTransformation> &transformations) override {
+        glm::mat4 local(1.f);
+        for (const SceneTransformation &t : transformations) {
+            local = mulMat4(local, toMat(&t));
+        }
+        m_ctms.push_back(mulMat4(m_ctms.back(), local));
+    }
+
+    void endGroup() override {
+        m_ctms.pop_back();
+    }
+
+    void primitive(const ScenePrimitive &primitive) override {
+        RenderShapeData rs{};
+        rs.type     = primitive.type;
+        rs.material = m_tables.material(primitive.material);
+        rs.meshfile = m_tables.path(primitive.meshfile);
+        rs.ctm      = m_ctms.back();
+        m_out.shapes.push_back(rs);
+    }
+
+    void light(const SceneLight &light) override {
+        m_out.lights.push_back(makeLight(&light, m_ctms.back()));
+    }
+
+    void instance(const SceneNode &templateRoot) override {
+        m_out.instances.push_back({uint32_t(templateRoot.templateIndex), m_ctms.back()});
+
+        FlattenCounts counts;
+        countSubtree(&templateRoot, false, counts);
+        if (counts.lights > 0) {
+            const size_t at = m_out.lights.size();
+            m_out.lights.resize(at + counts.lights);
+            SceneLightData *cursor = m_out.lights.data() + at;
+            flattenLights(&templateRoot, m_ctms.back(), cursor);
+        }
+    }
+
+private:
+    RenderData  &m_out;
+    SceneTables &m_tables;
+    std::vector<glm::mat4> m_ctms{glm::mat4(1.f)};
+};
+
+
+static bool readScene(const std::string &filepath, RenderData &out, size_t &graphBytes) {
     ScenefileReader fileReader(filepath);
     if (!fileReader.readJSON()) {
-        std::cerr << "Failed to read scene file: " << filepath << std::endl;
         return false;
     }
 
     // 1) Global + camera data
-    renderData.globalData = fileReader.getGlobalData();
-    renderData.cameraData = fileReader.getCameraData();
+    out.globalData = fileReader.getGlobalData();
+    out.cameraData = fileReader.getCameraData();
 
-    // 2) clear previous shapes/lights
-    renderData.shapes.clear();
-    renderData.lights.clear();
-
-    // 3) traverse scene graph starting at root
+    // 2) flatten scene graph starting at root; template groups once each,
+    // named groups become instances of them
+    SceneTables tables;
+    flattenTemplates(fileReader.getTemplateNodes(), tables, out);
     const SceneNode* root = fileReader.getRootNode();
     if (root != nullptr) {
-        traverse(root, glm::mat4(1.f), renderData);
+        flatten(root, tables, out);
+    }
+    tables.release(out.materials, out.paths);
+
+    graphBytes = fileReader.graphBytes();
+    return true;
+}
+
+
+static bool streamScene(const std::string &filepath, RenderData &out, size_t &graphBytes) {
+    ScenefileReader fileReader(filepath);
+    SceneTables tables;
+    FlattenHandler handler(out, tables);
+    if (!fileReader.streamJSON(handler)) {
+        return false;
     }
 
+    out.globalData = fileReader.getGlobalData();
+    out.cameraData = fileReader.getCameraData();
+    flattenTemplates(fileReader.getTemplateNodes(), tables, out);
+    tables.release(out.materials, out.paths);
+    graphBytes = fileReader.graphBytes();   // template groups only
+    return true;
+}
+
+
+
+bool SceneParser::parse(std::string filepath, RenderData &renderData) {
+    // unchanged since the last parse: take the flattened snapshot
+    const uint64_t sourceHash = SceneCache::sourceHash(filepath);
+    if (sourceHash && SceneCache::load(filepath, sourceHash, renderData)) {
+        std::cout << "[SceneParser] Loaded scene \""
+                  << filepath << "\" from cache\n"
+                  << "  shapes = " << renderData.shapes.size() << "\n"
+                  << "  instances = " << renderData.instances.size()
+                  << " of " << renderData.prototypes.size() << " templates\n"
+                  << "  materials = " << renderData.materials.size() << "\n"
+                  << "  lights = " << renderData.lights.size() << std::endl;
+        return true;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Big (generated) scenes are flattened while they are read, instead of
+    // holding the whole file, its DOM and the node graph at once. A file the
+    // stream can't take is read the usual way, which also reports any real
+    // error in it.
+    RenderData parsed;
+    size_t graphBytes = 0;
+    bool ok = false;
+    std::error_code ec;
+    const uintmax_t fileBytes = std::filesystem::file_size(filepath, ec);
+    if (!ec && fileBytes >= kStreamBytes) {
+        ok = streamScene(filepath, parsed, graphBytes);
+        if (!ok) {
+            std::cout << "[SceneParser] Couldn't stream \"" << filepath << "\", reading it whole" << std::endl;
+            parsed = RenderData();
+        }
+    }
+    if (!ok && !readScene(filepath, parsed, graphBytes)) {
+        std::cerr << "Failed to read scene file: " << filepath << std::endl;
+        return false;
+    }
+    renderData = std::move(parsed);
+
+    const double ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start).count();
+
     // for debug:
     std::cout << "[SceneParser] Parsed scene \""
-              << filepath << "\"\n"
+              << filepath << "\" in " << ms << " ms\n"
               << "  shapes = " << renderData.shapes.size() << "\n"
-              << "  lights = " << renderData.lights.size() << std::endl;
-
+              << "  instances = " << renderData.instances.size()
+              << " of " << renderData.prototypes.size() << " templates\n"
+              << "  materials = " << renderData.materials.size() << "\n"
+              << "  lights = " << renderData.lights.size() << "\n"
+              << "  graph  = " << graphBytes / 1024 << " KB" << std::endl;
+    if (sourceHash) SceneCache::store(filepath, sourceHash, renderData);
     return true;
 }
@@ -1,13 +1,31 @@
 #pragma once
 
 #include "scenedata.h"
+#include <cstdint>
 #include <vector>
 #include <string>
 
-// Struct which contains data for a single primitive, to be used for rendering
+// Struct which contains data for a single primitive, to be used for rendering.
+// Materials and mesh paths are shared through RenderData's tables.
 struct RenderShapeData {
-    ScenePrimitive primitive;
-    glm::mat4 ctm; // the cumulative transformation matrix
+    PrimitiveType type;
+    uint32_t material; // index into RenderData::materials
+    uint32_t meshfile; // index into RenderData::paths ("" unless a mesh)
+    glm::mat4 ctm;     // the cumulative transformation matrix
+};
+
+// A template group, flattened once. Its shapes' CTMs are relative to the
+// frame of the group that names the template; templates named inside it are
+// expanded in place.
+struct RenderPrototype {
+    std::vector<RenderShapeData> shapes;
+};
+
+// One use of a template group: every shape of the prototype, drawn with
+// ctm * shape.ctm.
+struct RenderInstanceData {
+    uint32_t  prototype; // index into RenderData::prototypes
+    glm::mat4 ctm;
 };
 
 // Struct which contains all the data needed to render a scene
@@ -15,8 +33,14 @@ struct RenderData {
     SceneGlobalData globalData;
     SceneCameraData cameraData;
 
-    std::vector<SceneLightData> lights;
-    std::vector<RenderShapeData> shapes;
+    std::vector<SceneLightData> lights;          // template lights included, once per instance
+    std::vector<RenderShapeData> shapes;         // outside any template
+    std::vector<RenderPrototype> prototypes;     // by template group
+    std::vector<RenderInstanceData> instances;
+
+    // each distinct material and path once, for shapes and prototypes alike
+    std::vector<SceneMaterial> materials;
+    std::vector<std::string> paths;
 };
 
 class SceneParser {
@@ -0,0 +1,82 @@
+#include "scenetables.h"
+
+#include <cstring>
+
+#include "mappedfile.h"
+
+namespace {
+
+uint64_t hashFileMap(const SceneFileMap &m, uint64_t h) {
+    const uint32_t used = m.isUsed ? 1 : 0;
+    h = hashBytes(&used, sizeof(used), h);
+    h = hashBytes(&m.repeatU, sizeof(float), h);
+    h = hashBytes(&m.repeatV, sizeof(float), h);
+    return hashBytes(m.filename.data(), m.filename.size(), h);
+}
+
+uint64_t hashMaterial(const SceneMaterial &m) {
+    uint64_t h = 0;
+    for (const SceneColor *c : {&m.cAmbient, &m.cDiffuse, &m.cSpecular, &m.cReflective, &m.cTransparent, &m.cEmissive}) {
+        h = hashBytes(c, sizeof(SceneColor), h);
+    }
+    for (const float *f : {&m.shininess, &m.ior, &m.blend}) {
+        h = hashBytes(f, sizeof(float), h);
+    }
+    h = hashFileMap(m.textureMap, h);
+    return hashFileMap(m.bumpMap, h);
+}
+
+// bitwise, to agree with the hash (0.f vs -0.f, NaNs)
+bool sameBits(const void *a, const void *b, size_t size) {
+    return std::memcmp(a, b, size) == 0;
+}
+
+bool sameFileMap(const SceneFileMap &a, const SceneFileMap &b) {
+    return a.isUsed == b.isUsed && a.filename == b.filename &&
+           sameBits(&a.repeatU, &b.repeatU, sizeof(float)) &&
+           sameBits(&a.repeatV, &b.repeatV, sizeof(float));
+}
+
+bool sameMaterial(const SceneMaterial &a, const SceneMaterial &b) {
+    return sameBits(&a.cAmbient, &b.cAmbient, sizeof(SceneColor)) &&
+           sameBits(&a.cDiffuse, &b.cDiffuse, sizeof(SceneColor)) &&
+           sameBits(&a.cSpecular, &b.cSpecular, sizeof(SceneColor)) &&
+           sameBits(&a.cReflective, &b.cReflective, sizeof(SceneColor)) &&
+           sameBits(&a.cTransparent, &b.cTransparent, sizeof(SceneColor)) &&
+           sameBits(&a.cEmissive, &b.cEmissive, sizeof(SceneColor)) &&
+           sameBits(&a.shininess, &b.shininess, sizeof(float)) &&
+           sameBits(&a.ior, &b.ior, sizeof(float)) &&
+           sameBits(&a.blend, &b.blend, sizeof(float)) &&
+           sameFileMap(a.textureMap, b.textureMap) &&
+           sameFileMap(a.bumpMap, b.bumpMap);
+}
+
+} // namespace
+
+uint32_t SceneTables::material(const SceneMaterial &material) {
+    const uint64_t h = hashMaterial(material);
+    auto [begin, end] = m_materialIndex.equal_range(h);
+    for (auto it = begin; it != end; ++it) {
+        if (sameMaterial(m_materials[it->second], material)) return it->second;
+    }
+
+    const uint32_t index = uint32_t(m_materials.size());
+    m_materials.push_back(material);
+    m_materialIndex.emplace(h, index);
+    return index;
+}
+
+uint32_t SceneTables::path(const std::string &path) {
+    auto [it, added] = m_pathIndex.try_emplace(path, uint32_t(m_paths.size()));
+    if (added) m_paths.push_back(path);
+    return it->second;
+}
+
+void SceneTables::release(std::vector<SceneMaterial> &materials, std::vector<std::string> &paths) {
+    materials = std::move(m_materials);
+    paths     = std::move(m_paths);
+    m_materials.clear();
+    m_paths.clear();
+    m_materialIndex.clear();
+    m_pathIndex.clear();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "scenedata.h"
+
+// Deduplicated materials and file paths for RenderData. Equal values (bit
+// for bit) get the same index; indices are handed out in first-seen order.
+class SceneTables {
+public:
+    uint32_t material(const SceneMaterial &material);
+    uint32_t path(const std::string &path);
+
+    const std::vector<SceneMaterial> &materials() const { return m_materials; }
+    const std::vector<std::string>   &paths()     const { return m_paths; }
+
+    // Hands the tables over and starts empty again.
+    void release(std::vector<SceneMaterial> &materials, std::vector<std::string> &paths);
+
+private:
+    std::vector<SceneMaterial> m_materials;
+    std::vector<std::string>   m_paths;
+
+    std::unordered_multimap<uint64_t, uint32_t> m_materialIndex;   // hash -> index
+    std::unordered_map<std::string, uint32_t>   m_pathIndex;
+};
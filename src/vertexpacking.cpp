@@ -0,0 +1,96 @@
+#include "vertexpacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <glm/gtc/packing.hpp>
+
+#include "chunkmesher.h"
+
+namespace {
+
+uint16_t half(float v) {
+    return glm::packHalf1x16(v);
+}
+
+// x in the low bits, matching GL_INT_2_10_10_10_REV
+uint32_t snorm1010102(float x, float y, float z) {
+    return glm::packSnorm3x10_1x2(glm::vec4(x, y, z, 0.f));
+}
+
+uint8_t unorm8(float v) {
+    return uint8_t(std::lround(std::clamp(v, 0.f, 1.f) * 255.f));
+}
+
+} // namespace
+
+VertexFormat posNormalVertexFormat(VertexPacking packing) {
+    VertexFormat f;
+    if (packing == VertexPacking::Float) {
+        // position (location = 0), normal (location = 1)
+        f.stride  = 6 * sizeof(float);
+        f.attribs = {{0, 3, GL_FLOAT, GL_FALSE, 0},
+                     {1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float)}};
+    } else {
+        f.stride  = sizeof(PackedPosNormal);
+        f.attribs = {{0, 3, GL_HALF_FLOAT,         GL_FALSE, offsetof(PackedPosNormal, pos)},
+                     {1, 4, GL_INT_2_10_10_10_REV, GL_TRUE,  offsetof(PackedPosNormal, normal)}};
+    }
+    return f;
+}
+
+VertexFormat chunkVertexFormat() {
+    // position, normal, block-local position, color (locations 0..3),
+    // AO (9), baked sun + sky visibility (10)
+    VertexFormat f;
+    f.stride  = sizeof(PackedChunkVertex);
+    f.attribs = {{0,  3, GL_HALF_FLOAT,         GL_FALSE, offsetof(PackedChunkVertex, pos)},
+                 {1,  4, GL_INT_2_10_10_10_REV, GL_TRUE,  offsetof(PackedChunkVertex, normal)},
+                 {2,  3, GL_HALF_FLOAT,         GL_FALSE, offsetof(PackedChunkVertex, blockPos)},
+                 {3,  3, GL_UNSIGNED_BYTE,      GL_TRUE,  offsetof(PackedChunkVertex, colorAO)},
+                 {9,  1, GL_UNSIGNED_BYTE,      GL_TRUE,  offsetof(PackedChunkVertex, colorAO) + 3},
+                 {10, 2, GL_UNSIGNED_BYTE,      GL_TRUE,  offsetof(PackedChunkVertex, light)}};
+    return f;
+}
+
+std::vector<PackedPosNormal> packPosNormal(const std::vector<float> &posNormal) {
+    std::vector<PackedPosNormal> out(posNormal.size() / 6);
+    for (size_t i = 0; i < out.size(); ++i) {
+        const float *v = &posNormal[i * 6];
+        out[i].pos[0] = half(v[0]);
+        out[i].pos[1] = half(v[1]);
+        out[i].pos[2] = half(v[2]);
+        out[i].pos[3] = 0;
+        out[i].normal = snorm1010102(v[3], v[4], v[5]);
+    }
+    return out;
+}
+
+std::vector<PackedChunkVertex> packChunkVertices(const std::vector<float> &vertices) {
+    const int n = ChunkMesh::kFloatsPerVertex;
+    std::vector<PackedChunkVertex> out(vertices.size() / n);
+    for (size_t i = 0; i < out.size(); ++i) {
+        // [p.xyz, n.xyz, blockPos.xyz, color.rgb, ao, sun, sky]
+        const float *v = &vertices[i * n];
+        PackedChunkVertex &o = out[i];
+        o.pos[0] = half(v[0]);
+        o.pos[1] = half(v[1]);
+        o.pos[2] = half(v[2]);
+        o.pos[3] = 0;
+        o.normal = snorm1010102(v[3], v[4], v[5]);
+        o.blockPos[0] = half(v[6]);
+        o.blockPos[1] = half(v[7]);
+        o.blockPos[2] = half(v[8]);
+        o.blockPos[3] = 0;
+        o.colorAO[0] = unorm8(v[9]);
+        o.colorAO[1] = unorm8(v[10]);
+        o.colorAO[2] = unorm8(v[11]);
+        o.colorAO[3] = unorm8(v[12]);
+        o.light[0] = unorm8(v[13]);
+        o.light[1] = unorm8(v[14]);
+        o.light[2] = 0;
+        o.light[3] = 0;
+    }
+    return out;
+}
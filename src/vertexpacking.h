@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "meshpool.h"
+
+// How a mesh's vertices are stored on the GPU.
+//   Float  - [pos.xyz, n.xyz] as 6 floats, 24 bytes
+//   Packed - half-float position + GL_INT_2_10_10_10_REV normal, 12 bytes.
+//            Halves are exact for the unit shapes (steps of 1/2048 near 1)
+//            but coarse far from the origin, so large meshes stay Float.
+enum class VertexPacking { Float, Packed };
+
+struct PackedPosNormal {
+    uint16_t pos[4];    // half x, y, z, pad
+    uint32_t normal;    // snorm 10:10:10:2
+};
+static_assert(sizeof(PackedPosNormal) == 12, "PackedPosNormal layout");
+
+// Chunk vertex, 28 bytes instead of 15 floats (60):
+//   pos       half x 3   x/z are cell edges (n + 0.5), exact while |v| < 1024;
+//                        y carries the 1/100 slab heights, and the grid's
+//                        y range [kMinY, kMinY + kHeight] = [-2, 6] keeps the
+//                        half step at 1/256 or finer (error < 1/500). 1/100
+//                        steps are NOT held far from the origin: the step is
+//                        1/32 at |v| >= 32 and 0.5 above 512.
+//   normal    snorm 10:10:10:2
+//   blockPos  half x 3   exactly +-0.5
+//   color     unorm8 rgb, AO in alpha (fetched as attribute 9)
+//   light     unorm8 sun, sky
+struct PackedChunkVertex {
+    uint16_t pos[4];
+    uint32_t normal;
+    uint16_t blockPos[4];
+    uint8_t  colorAO[4];
+    uint8_t  light[4];
+};
+static_assert(sizeof(PackedChunkVertex) == 28, "PackedChunkVertex layout");
+
+VertexFormat posNormalVertexFormat(VertexPacking packing);
+VertexFormat chunkVertexFormat();
+
+// posNormal: 6 floats per vertex as produced by the shape generators
+std::vector<PackedPosNormal> packPosNormal(const std::vector<float> &posNormal);
+
+// vertices: ChunkMesh::kFloatsPerVertex floats per vertex
+std::vector<PackedChunkVertex> packChunkVertices(const std::vector<float> &vertices);
@@ -0,0 +1,233 @@
+#include "voxelworld.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// ================= VoxelChunk =================
+
+VoxelChunk::VoxelChunk() {
+    m_palette.push_back(kAirBlock);
+    m_top.fill(-1);
+}
+
+uint32_t VoxelChunk::readIndex(int i) const {
+    if (m_bitsPerIndex == 0) return 0;
+
+    const int perWord = 64 / m_bitsPerIndex;
+    const uint64_t mask = (uint64_t(1) << m_bitsPerIndex) - 1;
+    const int shift = (i % perWord) * m_bitsPerIndex;
+    return uint32_t((m_bits[i / perWord] >> shift) & mask);
+}
+
+void VoxelChunk::writeIndex(int i, uint32_t v) {
+    const int perWord = 64 / m_bitsPerIndex;
+    const uint64_t mask = (uint64_t(1) << m_bitsPerIndex) - 1;
+    const int shift = (i % perWord) * m_bitsPerIndex;
+    uint64_t &word = m_bits[i / perWord];
+    word = (word & ~(mask << shift)) | (uint64_t(v) << shift);
+}
+
+void VoxelChunk::grow() {
+    std::vector<uint32_t> indices(kVolume);
+    for (int i = 0; i < kVolume; ++i) {
+        indices[i] = readIndex(i);
+    }
+
+    m_bitsPerIndex++;
+    const int perWord = 64 / m_bitsPerIndex;
+    m_bits.assign((kVolume + perWord - 1) / perWord, 0);
+
+    for (int i = 0; i < kVolume; ++i) {
+        if (indices[i]) writeIndex(i, indices[i]);
+    }
+}
+
+BlockId VoxelChunk::get(int lx, int ly, int lz) const {
+    return m_palette[readIndex(voxelIndex(lx, ly, lz))];
+}
+
+void VoxelChunk::set(int lx, int ly, int lz, BlockId id, const std::vector<BlockType> &types) {
+    const int i = voxelIndex(lx, ly, lz);
+    const BlockId old = m_palette[readIndex(i)];
+    if (old == id) return;
+
+    // find or add the palette entry
+    uint32_t local = 0;
+    auto it = std::find(m_palette.begin(), m_palette.end(), id);
+    if (it != m_palette.end()) {
+        local = uint32_t(it - m_palette.begin());
+    } else {
+        local = uint32_t(m_palette.size());
+        m_palette.push_back(id);
+        while (m_palette.size() > (size_t(1) << m_bitsPerIndex)) {
+            grow();
+        }
+    }
+    writeIndex(i, local);
+
+    m_solidCount += (id != kAirBlock) - (old != kAirBlock);
+
+    // refresh the column height
+    int16_t &top = m_top[lz * kSize + lx];
+    top = -1;
+    for (int y = kHeight - 1; y >= 0; --y) {
+        BlockId b = get(lx, y, lz);
+        if (b != kAirBlock) {
+            top = int16_t(y * 100 + types[b].top);
+            break;
+        }
+    }
+}
+
+size_t VoxelChunk::memoryBytes() const {
+    return sizeof(VoxelChunk) +
+           m_palette.capacity() * sizeof(BlockId) +
+           m_bits.capacity() * sizeof(uint64_t);
+}
+
+// ================= VoxelWorld =================
+
+VoxelWorld::VoxelWorld() {
+    clear();
+}
+
+void VoxelWorld::clear() {
+    for (const auto &[key, chunk] : m_chunks) {
+        m_dirty.insert(key);
+    }
+    m_chunks.clear();
+    m_types.clear();
+    m_typeLookup.clear();
+
+    BlockType air;
+    air.color = glm::vec3(0.f);
+    air.top   = 0;
+    m_types.push_back(air);
+}
+
+BlockId VoxelWorld::registerBlock(const glm::vec3 &color, int material, uint8_t bottom, uint8_t top) {
+    auto channel = [](float c) {
+        return uint64_t(std::lround(std::clamp(c, 0.f, 1.f) * 255.f));
+    };
+    uint64_t key = channel(color.r) | (channel(color.g) << 8) | (channel(color.b) << 16) |
+                   (uint64_t(material & 0xff) << 24) |
+                   (uint64_t(bottom) << 32) | (uint64_t(top) << 40);
+
+    auto it = m_typeLookup.find(key);
+    if (it != m_typeLookup.end()) {
+        return it->second;
+    }
+
+    if (m_types.size() > UINT16_MAX) {
+        std::cerr << "[VoxelWorld] too many block types, using air" << std::endl;
+        return kAirBlock;
+    }
+
+    BlockType t;
+    t.color    = glm::vec3(channel(color.r), channel(color.g), channel(color.b)) / 255.f;
+    t.material = material;
+    t.bottom   = bottom;
+    t.top      = top;
+
+    BlockId id = BlockId(m_types.size());
+    m_types.push_back(t);
+    m_typeLookup.emplace(key, id);
+    return id;
+}
+
+const VoxelChunk *VoxelWorld::findChunk(int x, int z) const {
+    auto it = m_chunks.find(chunkKey(floorDiv(x, VoxelChunk::kSize), floorDiv(z, VoxelChunk::kSize)));
+    return it == m_chunks.end() ? nullptr : &it->second;
+}
+
+BlockId VoxelWorld::getBlock(int x, int y, int z) const {
+    int ly = y - kMinY;
+    if (ly < 0 || ly >= VoxelChunk::kHeight) return kAirBlock;
+
+    const VoxelChunk *c = findChunk(x, z);
+    if (!c) return kAirBlock;
+
+    int cx = floorDiv(x, VoxelChunk::kSize);
+    int cz = floorDiv(z, VoxelChunk::kSize);
+    return c->get(x - cx * VoxelChunk::kSize, ly, z - cz * VoxelChunk::kSize);
+}
+
+void VoxelWorld::setBlock(int x, int y, int z, BlockId id) {
+    int ly = y - kMinY;
+    if (ly < 0 || ly >= VoxelChunk::kHeight) {
+        std::cerr << "[VoxelWorld] block at height " << y << " is out of range" << std::endl;
+        return;
+    }
+
+    int cx = floorDiv(x, VoxelChunk::kSize);
+    int cz = floorDiv(z, VoxelChunk::kSize);
+
+    auto it = m_chunks.find(chunkKey(cx, cz));
+    if (it == m_chunks.end()) {
+        if (id == kAirBlock) return;
+        it = m_chunks.emplace(chunkKey(cx, cz), VoxelChunk()).first;
+    }
+    it->second.set(x - cx * VoxelChunk::kSize, ly, z - cz * VoxelChunk::kSize, id, m_types);
+
+    // voxels near a chunk border also change the neighbours' meshes
+    const int r = m_editReach;
+    for (int nz = floorDiv(z - r, VoxelChunk::kSize); nz <= floorDiv(z + r, VoxelChunk::kSize); ++nz) {
+        for (int nx = floorDiv(x - r, VoxelChunk::kSize); nx <= floorDiv(x + r, VoxelChunk::kSize); ++nx) {
+            int64_t key = chunkKey(nx, nz);
+            if (m_chunks.count(key)) m_dirty.insert(key);
+        }
+    }
+}
+
+void VoxelWorld::fillColumn(int x, int z, float y0, float y1, const glm::vec3 &color, int material) {
+    int q0 = int(std::lround(y0 * 100.f));
+    int q1 = int(std::lround(y1 * 100.f));
+
+    for (int level = floorDiv(q0, 100); level * 100 < q1; ++level) {
+        int bottom = std::max(q0 - level * 100, 0);
+        int top    = std::min(q1 - level * 100, 100);
+        if (top <= bottom) continue;
+
+        BlockId old = getBlock(x, level, z);
+        if (old != kAirBlock) {
+            const BlockType &o = m_types[old];
+            if (o.bottom <= bottom && o.top >= top) continue;
+        }
+        setBlock(x, level, z, registerBlock(color, material, uint8_t(bottom), uint8_t(top)));
+    }
+}
+
+void VoxelWorld::clearColumn(int x, int z) {
+    for (int y = kMinY; y < kMinY + VoxelChunk::kHeight; ++y) {
+        setBlock(x, y, z, kAirBlock);
+    }
+}
+
+float VoxelWorld::columnTop(int x, int z) const {
+    const VoxelChunk *c = findChunk(x, z);
+    if (!c) return float(kMinY);
+
+    int top = c->columnTop(x - floorDiv(x, VoxelChunk::kSize) * VoxelChunk::kSize,
+                           z - floorDiv(z, VoxelChunk::kSize) * VoxelChunk::kSize);
+    return (top < 0) ? float(kMinY) : kMinY + top / 100.f;
+}
+
+std::vector<int64_t> VoxelWorld::takeDirtyChunks() {
+    std::vector<int64_t> out(m_dirty.begin(), m_dirty.end());
+    m_dirty.clear();
+    return out;
+}
+
+const VoxelChunk *VoxelWorld::chunk(int64_t key) const {
+    auto it = m_chunks.find(key);
+    return it == m_chunks.end() ? nullptr : &it->second;
+}
+
+size_t VoxelWorld::memoryBytes() const {
+    size_t bytes = m_types.capacity() * sizeof(BlockType);
+    for (const auto &[key, chunk] : m_chunks) {
+        bytes += sizeof(key) + chunk.memoryBytes();
+    }
+    return bytes;
+}
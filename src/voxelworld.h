@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "cubeinstance.h"   // MaterialType
+
+using BlockId = uint16_t;
+constexpr BlockId kAirBlock = 0;
+
+// A block fills the part [bottom, top] (1/100 of a cell) of its voxel, so
+// short walls, path tiles and hills are slabs instead of free-form scales.
+struct BlockType {
+    glm::vec3 color;
+    int       material = MAT_DEFAULT;
+    uint8_t   bottom   = 0;
+    uint8_t   top      = 100;
+
+    bool full() const { return bottom == 0 && top == 100; }
+};
+
+// 16 x 16 x kHeight voxels. Each chunk keeps a palette of the block types it
+// uses and stores voxels as bit-packed palette indices (0 bits while the
+// chunk is all air, 1 bit for air + one type, ...). Indices never straddle a
+// 64-bit word. A per-column heightmap makes top-of-column queries O(1).
+class VoxelChunk {
+public:
+    static constexpr int kSize   = 16;
+    static constexpr int kHeight = 8;
+    static constexpr int kVolume = kSize * kSize * kHeight;
+
+    VoxelChunk();
+
+    BlockId get(int lx, int ly, int lz) const;
+    void    set(int lx, int ly, int lz, BlockId id, const std::vector<BlockType> &types);
+
+    // Top of the highest block in the column in centi-units above the chunk
+    // floor, or -1 when the column is empty.
+    int columnTop(int lx, int lz) const { return m_top[lz * kSize + lx]; }
+
+    bool   empty()       const { return m_solidCount == 0; }
+    size_t memoryBytes() const;
+
+private:
+    static int voxelIndex(int lx, int ly, int lz) { return (ly * kSize + lz) * kSize + lx; }
+
+    uint32_t readIndex(int i) const;
+    void     writeIndex(int i, uint32_t v);
+    void     grow();   // one more bit per index, repacks
+
+    std::vector<BlockId>  m_palette;     // local index -> global id, [0] = air
+    std::vector<uint64_t> m_bits;
+    int                   m_bitsPerIndex = 0;
+
+    std::array<int16_t, kSize * kSize> m_top;
+    int                                m_solidCount = 0;
+};
+
+// Grid-aligned block world. Voxel (x, y, z) is the unit cell centered on
+// integer x/z with its floor at height y; heights go from kMinY to
+// kMinY + VoxelChunk::kHeight.
+class VoxelWorld {
+public:
+    static constexpr int kMinY = -2;
+
+    VoxelWorld();
+
+    BlockId          registerBlock(const glm::vec3 &color, int material, uint8_t bottom = 0, uint8_t top = 100);
+    const BlockType &blockType(BlockId id) const { return m_types[id]; }
+
+    BlockId getBlock(int x, int y, int z) const;
+    void    setBlock(int x, int y, int z, BlockId id);
+
+    // Fills heights [y0, y1] of column (x, z), one slab per voxel. A voxel
+    // whose block already covers the new piece keeps it (walls win over the
+    // path floor laid into them).
+    void fillColumn(int x, int z, float y0, float y1, const glm::vec3 &color, int material);
+    void clearColumn(int x, int z);
+
+    // World height of the column's top surface, or kMinY when empty. O(1).
+    float columnTop(int x, int z) const;
+
+    // Chunks whose mesh is out of date since the last call: every chunk
+    // within editReach voxels of an edit (culling and AO look one voxel
+    // across, baked light further) and chunks that were dropped by clear().
+    std::vector<int64_t> takeDirtyChunks();
+    void setEditReach(int voxels) { m_editReach = voxels; }
+
+    const VoxelChunk *chunk(int64_t key) const;
+
+    static int64_t    chunkKey(int cx, int cz) { return (int64_t(cx) << 32) ^ uint32_t(cz); }
+    static glm::ivec2 chunkCoords(int64_t key) { return glm::ivec2(int(key >> 32), int(int32_t(uint32_t(key)))); }
+
+    void   clear();
+    size_t chunkCount()  const { return m_chunks.size(); }
+    size_t memoryBytes() const;
+
+private:
+    static int floorDiv(int v, int d) { return (v >= 0) ? v / d : -((-v + d - 1) / d); }
+
+    const VoxelChunk *findChunk(int x, int z) const;
+
+    std::unordered_map<int64_t, VoxelChunk> m_chunks;
+    std::unordered_set<int64_t>             m_dirty;
+    int                                     m_editReach = 1;
+
+    std::vector<BlockType>                 m_types;   // [0] = air
+    std::unordered_map<uint64_t, BlockId>  m_typeLookup;
+};